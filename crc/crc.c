@@ -90,4 +90,44 @@ unsigned int calc_crc24(const unsigned char *base, int size)
     crc &= 0x00FFFFFF;
 
     return crc;
-}
\ No newline at end of file
+}
+
+/*
+calculate one byte input value with CRC-16-CCITT(polynomial 0x1021, MSB first), as the CRCSCAN
+    @crc: last crc value
+    @data: data input
+    @returns calculated crc value
+*/
+unsigned short crc16(unsigned short crc, unsigned char data)
+{
+    static const unsigned short crcpoly = 0x1021;
+    int i;
+
+    crc ^= (unsigned short)data << 8;
+    for (i = 0; i < 8; i++) {
+        if (crc & 0x8000)
+            crc = (crc << 1) ^ crcpoly;
+        else
+            crc <<= 1;
+    }
+
+    return crc;
+}
+
+/*
+Calculate buffer with CRC-16-CCITT, initial value 0xFFFF. Appending the result high byte first
+    makes the crc of the whole buffer zero, which is what the CRCSCAN checks
+    @base: buffer input
+    @size: data size
+    @returns calculated crc value
+*/
+unsigned short calc_crc16(const unsigned char *base, int size)
+{
+    unsigned short crc = 0xFFFF;
+    int i;
+
+    for (i = 0; i < size; i++)
+        crc = crc16(crc, base[i]);
+
+    return crc;
+}
@@ -1,2 +1,4 @@
 unsigned char calc_crc8(const unsigned char *base, int size);
-unsigned int calc_crc24(const unsigned char *base, int size);
\ No newline at end of file
+unsigned int calc_crc24(const unsigned char *base, int size);
+unsigned short crc16(unsigned short crc, unsigned char data);
+unsigned short calc_crc16(const unsigned char *base, int size);
\ No newline at end of file
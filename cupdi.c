@@ -54,15 +54,24 @@ This is C version of UPDI interface achievement, referred to the Python version
  */
 
 #include <stdio.h>
+#include <errno.h>
 #include <time.h>
+#include <sys/stat.h>
 #include <os/platform.h>
 #include <argparse/argparse.h>
 #include <device/device.h>
+#include <updi/stats.h>
+#include <updi/link.h>
 #include <updi/nvm.h>
+#include <updi/trace.h>
+#include <updi/transport.h>
+#include <sim/loopback.h>
 #include <ihex/ihex.h>
 #include <string/split.h>
 #include <file/fop.h>
 #include <crc/crc.h>
+#include <pagemap/pagemap.h>
+#include <pagecache/pagecache.h>
 #include <infoblock/ib.h>
 #include "cupdi.h"
 
@@ -76,6 +85,13 @@ This is C version of UPDI interface achievement, referred to the Python version
 #define SAVE_FILE_EXTENSION_NAME "save"
 #define DUMP_FILE_EXTENSION_NAME "dump"
 
+/* Link timing calibration file, relative to $HOME, one line for each port and baudrate */
+#define TIMING_FILE_DIR ".cupdi"
+#define TIMING_FILE_NAME "timing"
+
+/* Flash page cache files, in the timing file directory, one file for each chip serial number */
+#define PAGECACHE_DIR_NAME "pages"
+
 static const char *const usage[] = {
     "Simple command line interface for UPDI programming:",
     "cupdi [options] [[--] args]",
@@ -88,6 +104,31 @@ static const char *const usage[] = {
 enum { FLAG_UNLOCK, FLAG_ERASE, FLAG_PROG, FLAG_UPDATE, FLAG_CHECK, FLAG_COMPARE, FLAG_VERIFY, FLAG_SAVE, FLAG_DUMP, FLAG_INFO};
 enum { PACK_BUILD, PACK_SHOW};
 
+/*
+    Wall-clock time of each phase, and the running phase(NUM_STATS_PHASES if none)
+*/
+static ULONGLONG stats_phase_us[NUM_STATS_PHASES];
+static int stats_cur_phase = NUM_STATS_PHASES;
+
+/*
+    Account the time to the running phase, and start the next one
+    @next: next phase, NUM_STATS_PHASES if none
+    @return the phase left, to come back to it
+*/
+static int stats_phase(int next)
+{
+    static ULONGLONG start;
+    ULONGLONG now = clock_us();
+    int phase = stats_cur_phase;
+
+    if (phase < NUM_STATS_PHASES)
+        stats_phase_us[phase] += now - start;
+    start = now;
+    stats_cur_phase = next;
+
+    return phase;
+}
+
 int main(int argc, const char *argv[])
 {
     char *dev_name = NULL;
@@ -98,6 +139,8 @@ int main(int argc, const char *argv[])
     char *read = NULL;
     char *write = NULL;
     char *dbgview = NULL;
+    char *trace = NULL;
+    char *stats = NULL;
     int flag = 0;
     bool unlock = false;
     int verbose = 1;
@@ -105,18 +148,27 @@ int main(int argc, const char *argv[])
     bool disable = false;
     bool test = false;
     bool version = false;
+    bool calibrate = false;
+    bool fast = false;
+    bool crc = false;
+    bool diff = false;
+    bool page_erase = false;
+    bool cache = false;
+    bool unlocked = false;
     int pack = 0;
     //char *pack_version = NULL;
 
     const device_info_t * dev;
     void *nvm_ptr;
+    upd_stats_t *st;
+    link_timing_t timing;
     int result;
 
     struct argparse_option options[] = {
         OPT_HELP(),
         OPT_GROUP("Basic options"),
         OPT_STRING('d', "device", &dev_name, "Target device"),
-        OPT_STRING('c', "comport", &comport, "Com port to use (Windows: COMx | *nix: /dev/ttyX)"),
+        OPT_STRING('c', "comport", &comport, "Com port to use (Windows: COMx | *nix: /dev/ttyX | loop:[device] | replay:[trace file] | fd:[n])"),
         OPT_INTEGER('b', "baudrate", &baudrate, "Baud rate, default=115200"),
         OPT_STRING('f', "file", &file, "Intel HEX file to flash"),
         OPT_BIT('u', "unlock", &flag, "Perform a chip unlock (implied with --unlock)", NULL, (1 << FLAG_UNLOCK), 0),
@@ -137,7 +189,15 @@ int main(int argc, const char *argv[])
         OPT_BOOLEAN('-', "reset", &reset, "UPDI reset device"),
         OPT_BOOLEAN('-', "disable", &disable, "UPDI disable"),
         OPT_BOOLEAN('t', "test", &test, "Test UPDI device"),
+        OPT_STRING('-', "stats", &stats, "Print the performance counters and the time of each phase at exit: text|json"),
+        OPT_STRING('-', "trace", &trace, "Record the wire traffic to a binary trace file (see upditrace)"),
         OPT_BOOLEAN('-', "version", &version, "Show version"),
+        OPT_BOOLEAN('-', "fast", &fast, "Attach to a target left enabled by the last --fast session without BREAK and key, and keep the UPDI enabled in programming mode at exit"),
+        OPT_BOOLEAN('-', "crc", &crc, "Program the CRCSCAN checksum to the last 2 bytes of flash with --program, and check flash with the on-chip CRCSCAN instead of reading it back with --check/--verify"),
+        OPT_BOOLEAN('-', "diff", &diff, "Program without chip erase, only the flash pages differing from the file are rewritten"),
+        OPT_BOOLEAN('-', "page-erase", &page_erase, "Program without chip erase, only the flash pages covered by the file are erased and written"),
+        OPT_BOOLEAN('-', "cache", &cache, "With --program, keep the hashes of the flash pages written in ~/" TIMING_FILE_DIR "/" PAGECACHE_DIR_NAME " by chip serial number, --diff then skips the unchanged pages without reading them back. The other writes of the chip drop it"),
+        OPT_BOOLEAN('-', "calibrate", &calibrate, "Calibrate the shortest reliable UPDI guard time of the port, saved in ~/" TIMING_FILE_DIR "/" TIMING_FILE_NAME),
         OPT_BIT('-', "pack-build", &pack, "Pack info block to Intel HEX file, (macro FIRMWARE_VERSION at 'touch.h')save with extension'.ihex'", NULL, (1 << PACK_BUILD), 0),
         OPT_BIT('-', "pack-info", &pack, "Shwo packed file(ihex) info", NULL, (1 << PACK_SHOW), 0),
         //OPT_STRING('-', "pack2", &build_version, "Pack info block to Intel HEX file by given 4 bytes CVS code(Big Endian), save with extension'.ihex'"),
@@ -214,13 +274,50 @@ int main(int argc, const char *argv[])
         return ERROR_PTR;
     }
 
-    nvm_ptr = updi_nvm_init(comport, baudrate, (void *)dev);
+    // The simulated target of the 'loop:' port
+    transport_register(&transport_loopback);
+
+    if (trace) {
+        result = trace_start(trace);
+        if (result) {
+            DBG_INFO(UPDI_DEBUG, "Start trace '%s' failed %d", trace, result);
+            return -3;
+        }
+    }
+
+    stats_phase(STATS_PHASE_ATTACH);
+    nvm_ptr = updi_nvm_init(comport, baudrate, (void *)dev, fast);
     if (!nvm_ptr) {
         DBG_INFO(UPDI_DEBUG, "Nvm initialize failed");
         result = -3;
         goto out;
     }
 
+    //link timing of the port
+    if (calibrate) {
+        result = nvm_calibrate(nvm_ptr, &timing);
+        if (result) {
+            DBG_INFO(UPDI_DEBUG, "Link calibration failed %d", result);
+            result = -18;
+            goto out;
+        }
+
+        DBG_INFO(UPDI_DEBUG, "Link calibrated: guard time %d cycles, inter-byte delay %d, transfer delay %d ms",
+            128 >> timing.gtval, timing.ibdly, timing.phy_ibdly);
+
+        result = updi_save_timing(comport, baudrate, &timing);
+        if (result)
+            DBG_INFO(UPDI_DEBUG, "Save link timing failed %d", result);
+    }
+    else if (!updi_load_timing(comport, baudrate, &timing)) {
+        result = nvm_set_timing(nvm_ptr, &timing);
+        if (result) {
+            DBG_INFO(UPDI_DEBUG, "Set link timing failed %d", result);
+            result = -18;
+            goto out;
+        }
+    }
+
     //check device id
     result = nvm_get_device_info(nvm_ptr);
     if (result) {
@@ -231,6 +328,7 @@ int main(int argc, const char *argv[])
 
     //unlock
     if (write || fuses || flag) {
+        stats_phase(STATS_PHASE_UNLOCK);
         result = nvm_enter_progmode(nvm_ptr);
         if (result) {
             DBG_INFO(UPDI_DEBUG, "Device is locked(%d). Performing unlock with chip erase.", result);
@@ -240,6 +338,7 @@ int main(int argc, const char *argv[])
                 result = -5;
                 goto out;
             }
+            unlocked = true;
         }
 
         result = nvm_get_device_info(nvm_ptr);
@@ -250,8 +349,20 @@ int main(int argc, const char *argv[])
         }
     }
 
+    //page cache, dropped before the flash is changed out of the cached programming
+    if (unlocked || write || fuses || TEST_BIT(flag, FLAG_ERASE) || (file && TEST_BIT(flag, FLAG_UPDATE))
+        || (file && TEST_BIT(flag, FLAG_PROG) && !cache)) {
+        result = updi_pagecache_drop(nvm_ptr);
+        if (result) {
+            DBG_INFO(UPDI_DEBUG, "updi_pagecache_drop failed %d", result);
+            result = -19;
+            goto out;
+        }
+    }
+
     //erase
     if (TEST_BIT(flag, FLAG_ERASE)) {
+        stats_phase(STATS_PHASE_ERASE);
         result = updi_erase(nvm_ptr);
         if (result) {
             DBG_INFO(UPDI_DEBUG, "NVM chip erase failed %d", result);
@@ -262,6 +373,7 @@ int main(int argc, const char *argv[])
 
     //program and dump
     if (file) {
+        stats_phase(STATS_PHASE_PROGRAM);
         if (TEST_BIT(flag, FLAG_UPDATE)) {
             result = updi_update(nvm_ptr, file);
             if (result) {
@@ -272,7 +384,7 @@ int main(int argc, const char *argv[])
         }
 
         if (TEST_BIT(flag, FLAG_PROG)) {
-            result = updi_program(nvm_ptr, file);
+            result = updi_program(nvm_ptr, file, diff ? PROG_DIFF : (page_erase ? PROG_PAGE_ERASE : PROG_CHIP_ERASE), crc, cache);
             if (result) {
                 DBG_INFO(UPDI_DEBUG, "updi_program failed %d", result);
                 result = -9;
@@ -281,6 +393,7 @@ int main(int argc, const char *argv[])
         }
 
         if (TEST_BIT(flag, FLAG_COMPARE) || TEST_BIT(flag, FLAG_VERIFY)) {
+            stats_phase(STATS_PHASE_VERIFY);
             result = updi_compare(nvm_ptr, file);
             if (result) {
                 DBG_INFO(UPDI_DEBUG, "updi_verifiy_infoblock failed %d", result);
@@ -289,6 +402,8 @@ int main(int argc, const char *argv[])
             }
         }
 
+        stats_phase(NUM_STATS_PHASES);
+
         if (TEST_BIT(flag, FLAG_SAVE)) {
             result = updi_save(nvm_ptr, file);
             if (result) {
@@ -320,14 +435,20 @@ int main(int argc, const char *argv[])
 
     //check firwware content
     if (TEST_BIT(flag, FLAG_CHECK) || TEST_BIT(flag, FLAG_VERIFY)) {
-        result = updi_verifiy_infoblock(nvm_ptr);
+        stats_phase(STATS_PHASE_VERIFY);
+        if (crc)
+            result = updi_crc_check(nvm_ptr);
+        else
+            result = updi_verifiy_infoblock(nvm_ptr);
         if (result) {
-            DBG_INFO(UPDI_DEBUG, "updi_verifiy_infoblock failed %d", result);
+            DBG_INFO(UPDI_DEBUG, "%s failed %d", crc ? "updi_crc_check" : "updi_verifiy_infoblock", result);
             result = -11;
             goto out;
         }
     }
 
+    stats_phase(NUM_STATS_PHASES);
+
     //read
     if (read) {
         result = updi_read(nvm_ptr, read);
@@ -388,12 +509,136 @@ int main(int argc, const char *argv[])
     }
 
  out:
-    nvm_leave_progmode(nvm_ptr);
+    stats_phase(NUM_STATS_PHASES);
+    //keep the session for the next fast attach
+    if (!fast)
+        nvm_leave_progmode(nvm_ptr);
+
+    st = nvm_get_stats(nvm_ptr);
+    if (stats && st) {
+        memcpy(st->phase_us, stats_phase_us, sizeof(st->phase_us));
+        stats_print(st, !strcmp(stats, "json"));
+    }
+
     updi_nvm_deinit(nvm_ptr);
+    trace_stop();
 
     return result;
 }
 
+/*
+    Get path of the link timing file
+    @path: output buffer
+    @size: buffer size
+    @dir: only the directory
+    @return 0 successful, other value failed
+*/
+static int updi_timing_path(char *path, int size, bool dir)
+{
+    const char *home = getenv("HOME");
+    int len;
+
+    if (!home)
+        return -1;
+
+    if (dir)
+        len = snprintf(path, size, "%s/%s", home, TIMING_FILE_DIR);
+    else
+        len = snprintf(path, size, "%s/%s/%s", home, TIMING_FILE_DIR, TIMING_FILE_NAME);
+
+    return (len > 0 && len < size) ? 0 : -2;
+}
+
+/*
+    Load link timing of the port from the timing file
+    Each line is '<port> <baudrate> <gtval> <ibdly> <phy ibdly>'
+    @port: com port
+    @baud: baudrate
+    @tm: output timing
+    @return 0 if found, other value failed
+*/
+int updi_load_timing(const char *port, int baud, link_timing_t *tm)
+{
+    char path[256], line[512], name[256];
+    unsigned int gtval, ibdly;
+    int rate, phy_ibdly;
+    FILE *fp;
+    int result = -2;
+
+    if (updi_timing_path(path, sizeof(path), false))
+        return -1;
+
+    fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "%255s %d %u %u %d", name, &rate, &gtval, &ibdly, &phy_ibdly) != 5)
+            continue;
+
+        if (!strcmp(name, port) && rate == baud) {
+            tm->gtval = (u8)gtval;
+            tm->ibdly = !!ibdly;
+            tm->phy_ibdly = phy_ibdly;
+            result = 0;
+        }
+    }
+
+    fclose(fp);
+
+    if (!result)
+        DBG_INFO(UPDI_DEBUG, "Link timing of %s loaded from %s", port, path);
+
+    return result;
+}
+
+/*
+    Save link timing of the port to the timing file, the old line of the port is replaced
+    @port: com port
+    @baud: baudrate
+    @tm: timing
+    @return 0 successful, other value failed
+*/
+int updi_save_timing(const char *port, int baud, const link_timing_t *tm)
+{
+    char path[256], tmp[272], line[512], name[256];
+    FILE *fp, *out;
+    int rate;
+
+    if (updi_timing_path(path, sizeof(path), true))
+        return -1;
+
+    mkdir(path, 0755);
+
+    if (updi_timing_path(path, sizeof(path), false))
+        return -1;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    out = fopen(tmp, "w");
+    if (!out)
+        return -2;
+
+    fp = fopen(path, "r");
+    if (fp) {
+        while (fgets(line, sizeof(line), fp)) {
+            if (sscanf(line, "%255s %d", name, &rate) == 2 && !strcmp(name, port) && rate == baud)
+                continue;
+            fputs(line, out);
+        }
+        fclose(fp);
+    }
+
+    fprintf(out, "%s %d %u %u %d\n", port, baud, tm->gtval, tm->ibdly, tm->phy_ibdly);
+    fclose(out);
+
+    if (rename(tmp, path))
+        return -3;
+
+    DBG_INFO(UPDI_DEBUG, "Link timing of %s saved to %s", port, path);
+
+    return 0;
+}
+
 /*
     Erase the chip
     @nvm_ptr: updi_nvm_init() device handle
@@ -409,9 +654,31 @@ int updi_erase(void *nvm_ptr)
         return -2;
     }
 
+    // The erase time is accounted to the erase phase, not to the next operation
+    result = nvm_wait_ready(nvm_ptr);
+    if (result) {
+        DBG_INFO(UPDI_DEBUG, "nvm_wait_ready failed %d", result);
+        return -3;
+    }
+
     return 0;
 }
 
+/*
+    Segment id of a NVM block in the hex data. The segment id only covers the first 1MB, the blocks
+        mapped above(the flash of the 24bit address devices) are kept without segment at their full
+        address. Programming also accepts such flash at its offset in the block, as the compilers output it
+    @block: NVM block info
+    @return segment id
+*/
+static ihex_segment_t nvm_block_sid(const nvm_info_t *block)
+{
+    if (ADDR_TO_SEGMENTID(block->nvm_start) != (ihex_segment_t)ADDR_TO_SEGMENTID(block->nvm_start))
+        return DEFAULT_SID_WITHOUT_SEGMENT_RECORD;
+
+    return ADDR_TO_SEGMENTID(block->nvm_start);
+}
+
 /*
     Print segment info in hex data
     @dev: device info structure, get by get_chip_info()
@@ -432,7 +699,7 @@ int dev_hex_show(const device_info_t * dev, int type, hex_data_t *dhex)
         return -2;
     }
 
-    sid = ADDR_TO_SEGMENTID(iblock.nvm_start);
+    sid = nvm_block_sid(&iblock);
     for (i = 0; i < ARRAY_SIZE(dhex->segment); i++) {
         seg = &dhex->segment[i];
         if (seg->sid == sid) {
@@ -513,7 +780,7 @@ int _get_infoblock_from_hex_info(nvm_info_t *block, hex_data_t *dhex, informatio
     int start, size, off;
     int result;
 
-    sid = ADDR_TO_SEGMENTID(block->nvm_start);
+    sid = nvm_block_sid(block);
     seg = get_segment_by_id(dhex, sid);
     if (seg) {
         start = seg->addr_from;
@@ -614,7 +881,7 @@ int save_content_to_segment(void *nvm_ptr, int type, hex_data_t *dhex, ihex_addr
         return -3;
     }
 
-    sid = ADDR_TO_SEGMENTID(iblock.nvm_start);
+    sid = nvm_block_sid(&iblock);
     seg = set_segment_data_by_id_addr(dhex, sid, off, size, buf, SEG_ALLOC_MEMORY);
     if (!seg) {
         DBG_INFO(UPDI_DEBUG, "set_segment_data_by_id_addr failed %d", result);
@@ -802,21 +1069,560 @@ out:
     return result;
 }
 
+/*
+    UPDI check flash with the CRCSCAN of the chip, the checksum is stored in the last 2 bytes of flash by updi_program()
+    @nvm_ptr: NVM object pointer, acquired from updi_nvm_init()
+    @return 0 mean pass, other value failed
+*/
+int updi_crc_check(void *nvm_ptr)
+{
+    int result;
+
+    result = nvm_crc_check(nvm_ptr);
+    if (result) {
+        DBG_INFO(UPDI_DEBUG, "nvm_crc_check %s %d", result > 0 ? "mismatch" : "failed", result);
+        return -2;
+    }
+
+    DBG_INFO(UPDI_DEBUG, "Pass");
+
+    return 0;
+}
+
+/*
+    UPDI place the CRCSCAN checksum to the last 2 bytes of the flash image, the CRC-16 CCITT of the whole flash
+        with the checksum appended big endian is zero. Skipped if the hex data has already placed the last 2 bytes
+    @pm: flash page map
+    @returns 0 - success, other value failed code
+*/
+static int updi_pagemap_add_crc(pagemap_t *pm)
+{
+    u8 cs[2];
+    u16 crc;
+    int result;
+
+    if (pm->mask[pm->size - 2] || pm->mask[pm->size - 1]) {
+        DBG_INFO(UPDI_DEBUG, "Last 2 bytes of flash placed by hex file, CRC not programmed");
+        return 0;
+    }
+
+    crc = calc_crc16(pm->data, pm->size - 2);
+    cs[0] = (u8)(crc >> 8);
+    cs[1] = (u8)crc;
+
+    result = pagemap_add(pm, pm->start + pm->size - 2, cs, sizeof(cs));
+    if (result) {
+        DBG_INFO(UPDI_DEBUG, "pagemap_add crc failed %d", result);
+        return -2;
+    }
+
+    DBG_INFO(UPDI_DEBUG, "Flash CRC %04x programmed", crc);
+
+    return 0;
+}
+
+/*
+    UPDI write the pages of a page map to the erased flash, with one page command for each page.
+        The padding is written as is and the blank pages(all 0xFF, such as the fill records of the hex tools) are skipped
+    @nvm_ptr: updi_nvm_init() device handle
+    @pm: flash page map
+    @returns 0 - success, other value failed code
+*/
+static int updi_write_pagemap(void *nvm_ptr, pagemap_t *pm)
+{
+    u32 address;
+    int page, pages = 0, blanks = 0, result = 0;
+
+    for (page = pagemap_next(pm, 0); page >= 0; page = pagemap_next(pm, page + 1)) {
+        address = pagemap_page_address(pm, page);
+
+        if (pagemap_page_blank(pm, page)) {
+            blanks++;
+            continue;
+        }
+
+        result = nvm_write_flash(nvm_ptr, address, pagemap_page_data(pm, page), pm->pagesize);
+        if (result) {
+            DBG_INFO(UPDI_DEBUG, "nvm_write_flash page %x failed %d", address, result);
+            result = -4;
+            break;
+        }
+        pages++;
+    }
+
+    DBG_INFO(UPDI_DEBUG, "Flash %d pages written, %d blank pages skipped", pages, blanks);
+
+    return result;
+}
+
+/*
+    UPDI read back the flash under a page map, the padding of the pages takes the current content,
+        so a page not fully set by the image keeps the rest of its data
+    @nvm_ptr: updi_nvm_init() device handle
+    @pm: flash page map
+    @all: read the whole flash, otherwise from the first to the last page with data
+    @first: output first page read
+    @returns the flash content read from @first page, NULL if failed, free() by the caller
+*/
+static u8 *updi_readback_pagemap(void *nvm_ptr, pagemap_t *pm, bool all, int *first)
+{
+    u8 *buf;
+    int page, last, len, result;
+
+    *first = all ? 0 : pagemap_next(pm, 0);
+    if (*first < 0)
+        *first = last = 0;
+    else if (all)
+        last = pm->pages - 1;
+    else
+        for (page = last = *first; page >= 0; page = pagemap_next(pm, page + 1))
+            last = page;
+
+    len = (last - *first + 1) * pm->pagesize;
+    buf = malloc(len);
+    if (!buf) {
+        DBG_INFO(UPDI_DEBUG, "malloc readback buffer %d failed", len);
+        return NULL;
+    }
+
+    // One bulk read of the span
+    result = nvm_read_flash(nvm_ptr, pagemap_page_address(pm, *first), buf, len);
+    if (result) {
+        DBG_INFO(UPDI_DEBUG, "nvm_read_flash %d bytes failed %d", len, result);
+        free(buf);
+        return NULL;
+    }
+
+    for (page = *first; page <= last; page++)
+        pagemap_merge(pm, page, buf + (page - *first) * pm->pagesize);
+
+    return buf;
+}
+
+/*
+    Get path of the flash page cache file of the chip, named by its serial number, nothing is created
+    @nvm_ptr: updi_nvm_init() device handle, the device info read in Unlocked Mode
+    @path: output buffer
+    @size: buffer size
+    @return 0 successful, -1 serial number not read, -2 no home directory, other value failed
+*/
+static int updi_pagecache_path(void *nvm_ptr, char *path, int size)
+{
+    u8 sernum[16];
+    int i, n, len;
+
+    n = nvm_get_serial(nvm_ptr, sernum, sizeof(sernum));
+    if (n <= 0) {
+        DBG_INFO(UPDI_DEBUG, "nvm_get_serial failed %d", n);
+        return -1;
+    }
+
+    if (updi_timing_path(path, size, true))
+        return -2;
+
+    len = strlen(path);
+    len += snprintf(path + len, size - len, "/%s/", PAGECACHE_DIR_NAME);
+    if (len >= size)
+        return -3;
+
+    for (i = 0; i < n && len < size; i++)
+        len += snprintf(path + len, size - len, "%02x", sernum[i]);
+
+    return len < size ? 0 : -3;
+}
+
+/*
+    UPDI drop the flash page cache of the chip, before the flash is changed without updating the cache
+    @nvm_ptr: updi_nvm_init() device handle, the device info read in Unlocked Mode
+    @return 0 successful, other value failed
+*/
+int updi_pagecache_drop(void *nvm_ptr)
+{
+    char path[256];
+    int result;
+
+    // Without home directory no cache is kept, the chip not identified may have one
+    result = updi_pagecache_path(nvm_ptr, path, sizeof(path));
+    if (result == -2)
+        return 0;
+    if (result) {
+        DBG_INFO(UPDI_DEBUG, "updi_pagecache_path failed %d", result);
+        return -2;
+    }
+
+    if (remove(path) && errno != ENOENT) {
+        DBG_INFO(UPDI_DEBUG, "Remove page cache %s failed %d", path, errno);
+        return -3;
+    }
+
+    return 0;
+}
+
+/*
+    UPDI consistency probe of the flash page cache, a hash of the first flash page, the fuses and
+        the infoblock in eeprom, changed by the chip erase and the programming of the other tools
+    @nvm_ptr: updi_nvm_init() device handle
+    @probe: output hash
+    @return 0 successful, other value failed
+*/
+static int updi_pagecache_probe(void *nvm_ptr, unsigned long long *probe)
+{
+    nvm_info_t iflash, ifuse;
+    information_header_t header;
+    unsigned long long hash = PAGECACHE_HASH_INIT;
+    u8 *buf;
+    int len, result;
+
+    if (nvm_get_block_info(nvm_ptr, NVM_FLASH, &iflash) || nvm_get_block_info(nvm_ptr, NVM_FUSES, &ifuse)) {
+        DBG_INFO(UPDI_DEBUG, "nvm_get_block_info failed");
+        return -2;
+    }
+
+    len = max(iflash.nvm_pagesize, ifuse.nvm_size);
+    len = max(len, ib_max_block_size());
+    buf = malloc(len);
+    if (!buf) {
+        DBG_INFO(UPDI_DEBUG, "malloc probe buffer %d failed", len);
+        return -3;
+    }
+
+    result = nvm_read_flash(nvm_ptr, iflash.nvm_start, buf, iflash.nvm_pagesize);
+    if (result) {
+        DBG_INFO(UPDI_DEBUG, "nvm_read_flash failed %d", result);
+        result = -4;
+        goto out;
+    }
+    hash = pagecache_hash(hash, buf, iflash.nvm_pagesize);
+
+    result = nvm_read_fuse(nvm_ptr, ifuse.nvm_start, buf, ifuse.nvm_size);
+    if (result) {
+        DBG_INFO(UPDI_DEBUG, "nvm_read_fuse failed %d", result);
+        result = -5;
+        goto out;
+    }
+    hash = pagecache_hash(hash, buf, ifuse.nvm_size);
+
+    // The infoblock carries the firmware crc, only its header if there isn't a valid one
+    result = nvm_read_eeprom(nvm_ptr, INFO_BLOCK_ADDRESS_IN_EEPROM, (u8 *)&header, sizeof(header));
+    if (result) {
+        DBG_INFO(UPDI_DEBUG, "nvm_read_eeprom failed %d", result);
+        result = -6;
+        goto out;
+    }
+    hash = pagecache_hash(hash, (u8 *)&header, sizeof(header));
+
+    len = header.data.size;
+    if (len > (int)sizeof(header) && len <= ib_max_block_size()) {
+        result = nvm_read_eeprom(nvm_ptr, INFO_BLOCK_ADDRESS_IN_EEPROM, buf, len);
+        if (result) {
+            DBG_INFO(UPDI_DEBUG, "nvm_read_eeprom %d bytes failed %d", len, result);
+            result = -6;
+            goto out;
+        }
+        hash = pagecache_hash(hash, buf, len);
+    }
+
+    *probe = hash;
+
+out:
+    free(buf);
+    return result;
+}
+
+/*
+    UPDI load the flash page cache of the chip
+    @nvm_ptr: updi_nvm_init() device handle
+    @pm: flash page map, for the flash geometry
+    @valid: output whether the cache describes the flash, its probe matched
+    @return page cache, all blank if not valid, NULL if failed
+*/
+static pagecache_t *updi_pagecache_load(void *nvm_ptr, const pagemap_t *pm, bool *valid)
+{
+    pagecache_t *pc;
+    char path[256];
+    unsigned long long probe;
+    int result;
+
+    *valid = false;
+
+    if (updi_pagecache_path(nvm_ptr, path, sizeof(path))) {
+        DBG_INFO(UPDI_DEBUG, "updi_pagecache_path failed");
+        return NULL;
+    }
+
+    pc = pagecache_create(pm->start, pm->pages, pm->pagesize);
+    if (!pc) {
+        DBG_INFO(UPDI_DEBUG, "pagecache_create failed");
+        return NULL;
+    }
+
+    result = pagecache_load(pc, path);
+    if (result) {
+        DBG_INFO(UPDI_DEBUG, "No page cache of the chip in %s(%d)", path, result);
+        pagecache_clear(pc);
+        return pc;
+    }
+
+    // The cache is dropped before the flash changes, a failed session leaves none
+    remove(path);
+
+    result = updi_pagecache_probe(nvm_ptr, &probe);
+    if (result) {
+        DBG_INFO(UPDI_DEBUG, "updi_pagecache_probe failed %d", result);
+        pagecache_clear(pc);
+        return pc;
+    }
+
+    if (probe != pc->probe) {
+        DBG_INFO(UPDI_DEBUG, "Page cache %s outdated, probe %llx(%llx)", path, probe, pc->probe);
+        pagecache_clear(pc);
+        return pc;
+    }
+
+    DBG_INFO(UPDI_DEBUG, "Page cache loaded from %s", path);
+    *valid = true;
+
+    return pc;
+}
+
+/*
+    UPDI save the flash page cache of the chip, with the probe of the chip as programmed
+    @nvm_ptr: updi_nvm_init() device handle
+    @pc: page cache
+    @return 0 successful, other value failed
+*/
+static int updi_pagecache_save(void *nvm_ptr, pagecache_t *pc)
+{
+    char path[256];
+    int len, result;
+
+    // The directories are only created for a cache to be kept
+    if (updi_timing_path(path, sizeof(path), true))
+        return -2;
+    mkdir(path, 0755);
+
+    len = strlen(path);
+    snprintf(path + len, sizeof(path) - len, "/%s", PAGECACHE_DIR_NAME);
+    mkdir(path, 0755);
+
+    if (updi_pagecache_path(nvm_ptr, path, sizeof(path)))
+        return -2;
+
+    result = updi_pagecache_probe(nvm_ptr, &pc->probe);
+    if (result) {
+        DBG_INFO(UPDI_DEBUG, "updi_pagecache_probe failed %d", result);
+        return -3;
+    }
+
+    result = pagecache_save(pc, path);
+    if (result) {
+        DBG_INFO(UPDI_DEBUG, "pagecache_save %s failed %d", path, result);
+        return -4;
+    }
+
+    DBG_INFO(UPDI_DEBUG, "Page cache saved to %s", path);
+
+    return 0;
+}
+
+/*
+    UPDI write the pages of a page map to the flash not erased, only the pages differing from the target
+        are erased and written
+    @nvm_ptr: updi_nvm_init() device handle
+    @pm: flash page map
+    @crc: place the CRCSCAN checksum, the whole flash is read back for it
+    @pc: page cache updated with the pages written, NULL if not used
+    @cached: @pc describes the flash, the pages are compared with it instead of read back. Only
+        the partial pages changed are read back, for their padding
+    @returns 0 - success, other value failed code
+*/
+static int updi_write_pagemap_diff(void *nvm_ptr, pagemap_t *pm, bool crc, pagecache_t *pc, bool cached)
+{
+    u8 *buf, *data, *old;
+    u32 address;
+    int first = 0, page, pages = 0, skips = 0, result = 0;
+
+    if (cached) {
+        buf = malloc(pm->pagesize);
+        if (!buf) {
+            DBG_INFO(UPDI_DEBUG, "malloc page buffer %d failed", pm->pagesize);
+            return -2;
+        }
+    }
+    else {
+        // The whole flash is read for the cache
+        buf = updi_readback_pagemap(nvm_ptr, pm, crc || pc, &first);
+        if (!buf) {
+            DBG_INFO(UPDI_DEBUG, "updi_readback_pagemap failed");
+            return -2;
+        }
+
+        if (pc) {
+            for (page = 0; page < pm->pages; page++)
+                pagecache_set(pc, page, buf + page * pm->pagesize);
+        }
+    }
+
+    if (crc) {
+        result = updi_pagemap_add_crc(pm);
+        if (result) {
+            DBG_INFO(UPDI_DEBUG, "updi_pagemap_add_crc failed %d", result);
+            result = -3;
+            goto out;
+        }
+    }
+
+    for (page = pagemap_next(pm, 0); page >= 0; page = pagemap_next(pm, page + 1)) {
+        address = pagemap_page_address(pm, page);
+        data = pagemap_page_data(pm, page);
+
+        if (cached && pagecache_same(pc, page, data)) {
+            skips++;
+            continue;
+        }
+
+        old = NULL;
+        if (!cached)
+            old = buf + (page - first) * pm->pagesize;
+        else if (!pagemap_page_full(pm, page)) {
+            result = nvm_read_flash(nvm_ptr, address, buf, pm->pagesize);
+            if (result) {
+                DBG_INFO(UPDI_DEBUG, "nvm_read_flash page %x failed %d", address, result);
+                result = -3;
+                goto out;
+            }
+            pagemap_merge(pm, page, buf);
+            old = buf;
+        }
+
+        if (old && !memcmp(data, old, pm->pagesize)) {
+            if (pc)
+                pagecache_set(pc, page, data);
+            skips++;
+            continue;
+        }
+
+        result = nvm_erase_write_flash(nvm_ptr, address, data, pm->pagesize);
+        if (result) {
+            DBG_INFO(UPDI_DEBUG, "nvm_erase_write_flash page %x failed %d", address, result);
+            result = -4;
+            goto out;
+        }
+        if (pc)
+            pagecache_set(pc, page, data);
+        pages++;
+    }
+
+    DBG_INFO(UPDI_DEBUG, "Flash %d pages written, %d unchanged pages skipped", pages, skips);
+
+out:
+    free(buf);
+    return result;
+}
+
+/*
+    UPDI write the pages of a page map to the flash not erased, each page is erased by itself, the flash
+        out of the pages is kept. The pages all blank are only erased, the padding of the partial pages is read back
+    @nvm_ptr: updi_nvm_init() device handle
+    @pm: flash page map
+    @crc: place the CRCSCAN checksum, the whole flash is read back for it
+    @pc: page cache updated with the pages written, NULL if not used
+    @returns 0 - success, other value failed code
+*/
+static int updi_write_pagemap_erase(void *nvm_ptr, pagemap_t *pm, bool crc, pagecache_t *pc)
+{
+    u8 *buf;
+    u32 address;
+    int first, page, phase, pages = 0, erases = 0, result = 0;
+
+    if (crc) {
+        buf = updi_readback_pagemap(nvm_ptr, pm, true, &first);
+        if (!buf) {
+            DBG_INFO(UPDI_DEBUG, "updi_readback_pagemap failed");
+            return -2;
+        }
+
+        result = updi_pagemap_add_crc(pm);
+        if (result) {
+            DBG_INFO(UPDI_DEBUG, "updi_pagemap_add_crc failed %d", result);
+            result = -3;
+            goto out;
+        }
+    }
+    else {
+        buf = malloc(pm->pagesize);
+        if (!buf) {
+            DBG_INFO(UPDI_DEBUG, "malloc page buffer %d failed", pm->pagesize);
+            return -2;
+        }
+    }
+
+    for (page = pagemap_next(pm, 0); page >= 0; page = pagemap_next(pm, page + 1)) {
+        address = pagemap_page_address(pm, page);
+
+        if (!crc && !pagemap_page_full(pm, page)) {
+            result = nvm_read_flash(nvm_ptr, address, buf, pm->pagesize);
+            if (result) {
+                DBG_INFO(UPDI_DEBUG, "nvm_read_flash page %x failed %d", address, result);
+                result = -3;
+                goto out;
+            }
+            pagemap_merge(pm, page, buf);
+        }
+
+        if (pagemap_page_blank(pm, page)) {
+            phase = stats_phase(STATS_PHASE_ERASE);
+            result = nvm_erase_flash(nvm_ptr, address, pm->pagesize);
+            if (!result)
+                result = nvm_wait_ready(nvm_ptr);
+            stats_phase(phase);
+            erases++;
+        }
+        else {
+            result = nvm_erase_write_flash(nvm_ptr, address, pagemap_page_data(pm, page), pm->pagesize);
+            pages++;
+        }
+        if (result) {
+            DBG_INFO(UPDI_DEBUG, "Flash page %x erase/write failed %d", address, result);
+            result = -4;
+            goto out;
+        }
+
+        if (pc)
+            pagecache_set(pc, page, pagemap_page_data(pm, page));
+    }
+
+    DBG_INFO(UPDI_DEBUG, "Flash %d pages written, %d blank pages erased", pages, erases);
+
+out:
+    free(buf);
+    return result;
+}
+
 /*
     UPDI Program flash
     This flowchart is: load firmware file->erase chip->program firmware
+    The flash segments are merged into whole pages first, each page is written once
     @nvm_ptr: updi_nvm_init() device handle
     @file: hex/ihex file path
+    @mode: PROG_MODE_T. Without chip erase, the flash out of the pages of the file is kept,
+        such as the calibration data or a bootloader
+    @crc: program the CRCSCAN checksum to the end of flash
+    @cache: keep the flash page cache of the chip, PROG_DIFF compares the pages with it if still valid
     @returns 0 - success, other value failed code
 */
-int updi_program(void *nvm_ptr, const char *file)
+int updi_program(void *nvm_ptr, const char *file, /*PROG_MODE_T*/int mode, bool crc, bool cache)
 {
     hex_data_t *dhex = NULL;
+    pagemap_t *pm = NULL;
+    pagecache_t *pc = NULL;
+    bool cached = false;
     segment_buffer_t *seg;
     ihex_segment_t sid;
     nvm_info_t iflash;
-    char * vcs_file = NULL;
-    int i, result = 0;
+    bool placed[ARRAY_SIZE(dhex->segment)];
+    u32 address;
+    int i, phase, result = 0;
 
     result = nvm_get_block_info(nvm_ptr, NVM_FLASH, &iflash);
     if (result) {
@@ -829,20 +1635,98 @@ int updi_program(void *nvm_ptr, const char *file)
         DBG_INFO(UPDI_DEBUG, "get_hex_info_from_file failed %d");
         return -3;
     }
-    sid = ADDR_TO_SEGMENTID(iflash.nvm_start);
+    sid = nvm_block_sid(&iflash);
     set_default_segment_id(dhex, sid);
 
-    result = nvm_chip_erase(nvm_ptr);
-    if (result) {
-        DBG_INFO(UPDI_DEBUG, "nvm_chip_erase failed %d", result);
-        result = -4;
+    pm = pagemap_create(iflash.nvm_start, iflash.nvm_size, iflash.nvm_pagesize);
+    if (!pm) {
+        DBG_INFO(UPDI_DEBUG, "pagemap_create failed");
+        result = -3;
         goto out;
     }
 
+    if (cache) {
+        pc = updi_pagecache_load(nvm_ptr, pm, &cached);
+        if (!pc)
+            DBG_INFO(UPDI_DEBUG, "updi_pagecache_load failed, programming without page cache");
+
+        // Only the pages of the file are known after a page erase programming, a cache not valid is dropped
+        if (pc && mode == PROG_PAGE_ERASE && !cached) {
+            pagecache_destroy(pc);
+            pc = NULL;
+        }
+    }
+
+    if (mode == PROG_CHIP_ERASE) {
+        phase = stats_phase(STATS_PHASE_ERASE);
+        result = updi_erase(nvm_ptr);
+        stats_phase(phase);
+        if (result) {
+            DBG_INFO(UPDI_DEBUG, "updi_erase failed %d", result);
+            result = -4;
+            goto out;
+        }
+    }
+
+    // Flash segments to the page map, the others are written directly after the flash
     for (i = 0; i < ARRAY_SIZE(dhex->segment); i++) {
         seg = &dhex->segment[i];
+        placed[i] = false;
         if (seg->data) {
-            result = nvm_write_auto(nvm_ptr, SEGMENTID_TO_ADDR(seg->sid) + seg->addr_from, seg->data, seg->len);
+            // Flash out of the segment range is placed at its offset, see nvm_block_sid()
+            address = SEGMENTID_TO_ADDR(seg->sid) + seg->addr_from;
+            if (seg->sid == sid && sid == DEFAULT_SID_WITHOUT_SEGMENT_RECORD && address < iflash.nvm_size)
+                address += iflash.nvm_start;
+            placed[i] = !pagemap_add(pm, address, (u8 *)seg->data, seg->len);
+        }
+    }
+
+    if (mode == PROG_DIFF) {
+        // The CRCSCAN checksum covers the whole flash, read back anyway
+        result = updi_write_pagemap_diff(nvm_ptr, pm, crc, pc, cached && !crc);
+        if (result) {
+            DBG_INFO(UPDI_DEBUG, "updi_write_pagemap_diff failed %d", result);
+            result = -5;
+            goto out;
+        }
+    }
+    else if (mode == PROG_PAGE_ERASE) {
+        result = updi_write_pagemap_erase(nvm_ptr, pm, crc, pc);
+        if (result) {
+            DBG_INFO(UPDI_DEBUG, "updi_write_pagemap_erase failed %d", result);
+            result = -5;
+            goto out;
+        }
+    }
+    else {
+        if (crc) {
+            result = updi_pagemap_add_crc(pm);
+            if (result) {
+                DBG_INFO(UPDI_DEBUG, "updi_pagemap_add_crc failed %d", result);
+                result = -6;
+                goto out;
+            }
+        }
+
+        result = updi_write_pagemap(nvm_ptr, pm);
+        if (result) {
+            DBG_INFO(UPDI_DEBUG, "updi_write_pagemap failed %d", result);
+            result = -5;
+            goto out;
+        }
+
+        if (pc) {
+            pagecache_clear(pc);
+            for (i = pagemap_next(pm, 0); i >= 0; i = pagemap_next(pm, i + 1))
+                pagecache_set(pc, i, pagemap_page_data(pm, i));
+        }
+    }
+
+    for (i = 0; i < ARRAY_SIZE(dhex->segment); i++) {
+        seg = &dhex->segment[i];
+        if (seg->data && !placed[i]) {
+            address = SEGMENTID_TO_ADDR(seg->sid) + seg->addr_from;
+            result = nvm_write_auto(nvm_ptr, address, seg->data, seg->len);
             if (result) {
                 DBG_INFO(UPDI_DEBUG, "nvm_write_auto %d failed %d", i, result);
                 result = -5;
@@ -851,9 +1735,21 @@ int updi_program(void *nvm_ptr, const char *file)
         }
     }
 
+    if (pc) {
+        result = updi_pagecache_save(nvm_ptr, pc);
+        if (result) {
+            DBG_INFO(UPDI_DEBUG, "updi_pagecache_save failed %d", result);
+            result = 0;
+        }
+    }
+
     DBG_INFO(UPDI_DEBUG, "Program finished");
 
 out:
+    if (pc)
+        pagecache_destroy(pc);
+    if (pm)
+        pagemap_destroy(pm);
     if (dhex)
         release_dhex(dhex);
     return result;
@@ -932,7 +1828,7 @@ int compare_nvm_fuses(void *nvm_ptr, hex_data_t *dhex)
         return -3;
     }
 
-    sid = ADDR_TO_SEGMENTID(iblock.nvm_start);
+    sid = nvm_block_sid(&iblock);
     for (i = 0; i < ARRAY_SIZE(dhex->segment); i++) {
         seg = &dhex->segment[i];
         if (seg->sid == sid) {
@@ -1008,7 +1904,7 @@ int updi_update(void *nvm_ptr, const char *file)
 
     result = updi_compare(nvm_ptr, file);
     if (result) {
-        result = updi_program(nvm_ptr, file);
+        result = updi_program(nvm_ptr, file, PROG_CHIP_ERASE, false, false);
         if (result) {
             DBG_INFO(UPDI_DEBUG, "updi_program failed %d", result);
             result = -2;
@@ -1177,8 +2073,8 @@ int updi_dump(void *nvm_ptr, const char *file)
             break;
         }
 
-        sid = ADDR_TO_SEGMENTID(iblock.nvm_start);
-        seg = set_segment_data_by_id_addr(&dhex_info, sid, 0, iblock.nvm_size, buf, SEG_ALLOC_MEMORY);
+        sid = nvm_block_sid(&iblock);
+        seg = set_segment_data_by_id_addr(&dhex_info, sid, iblock.nvm_start - SEGMENTID_TO_ADDR(sid), iblock.nvm_size, buf, SEG_ALLOC_MEMORY);
         if (!seg) {
             DBG_INFO(UPDI_DEBUG, "set_segment_data_by_id_addr type %d failed %d", i, result);
             result = -5;
@@ -1246,7 +2142,7 @@ segment_buffer_t * load_flash_segment_from_file(const device_info_t * dev, const
         goto out;
     }
 
-    sid = ADDR_TO_SEGMENTID(iblock.nvm_start);
+    sid = nvm_block_sid(&iblock);
     seg = get_segment_by_id_addr(dhex, sid, 0);
     if (!seg) {
         seg = get_segment_by_id_addr(dhex, 0, 0);
@@ -1325,7 +2221,7 @@ segment_buffer_t * load_version_segment_from_file(const device_info_t * dev, con
         goto out;
     }
 
-    sid = ADDR_TO_SEGMENTID(iblock.nvm_start);
+    sid = nvm_block_sid(&iblock);
     unload_segment_by_sid(dhex, sid);
     seg = set_segment_data_by_id_addr(dhex, sid, INFO_BLOCK_ADDRESS_IN_EEPROM, size, (char *)info_container.head, SEG_ALLOC_MEMORY);
     if (!seg) {
@@ -1389,7 +2285,7 @@ int load_fuse_content_from_file(const device_info_t * dev, const char * file, he
         goto out;
     }
 
-    sid = ADDR_TO_SEGMENTID(iblock.nvm_start);
+    sid = nvm_block_sid(&iblock);
     unload_segment_by_sid(dhex, sid);
 
     for (i = 0; i < result; i++) {
@@ -1523,7 +2419,7 @@ int dev_vcs_hex_file_show_info(const device_info_t * dev, const char *file)
         goto out;
     }
 
-    sid = ADDR_TO_SEGMENTID(iblock.nvm_start);
+    sid = nvm_block_sid(&iblock);
     seg = get_segment_by_id(&dhex_info, sid);
     if (!seg) {
         DBG_INFO(UPDI_DEBUG, "dev_get_nvm_info failed %d", result);
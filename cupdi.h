@@ -2,9 +2,11 @@
 #define __CUPDI_H
 
 int updi_erase(void *nvm_ptr);
-int updi_program(void *nvm_ptr, const char *file);
+int updi_program(void *nvm_ptr, const char *file, /*PROG_MODE_T*/int mode, bool crc, bool cache);
+int updi_pagecache_drop(void *nvm_ptr);
 int updi_compare(void *nvm_ptr, const char *file);
 int updi_verifiy_infoblock(void *nvm_ptr);
+int updi_crc_check(void *nvm_ptr);
 int updi_update(void *nvm_ptr, const char *file);
 int updi_save(void *nvm_ptr, const char *file);
 int updi_dump(void *nvm_ptr, const char *file);
@@ -15,10 +17,20 @@ int updi_show_infoblock(void *nvm_ptr);
 int updi_verifiy_infoblock(void *nvm_ptr);
 int updi_reset(void *nvm_ptr);
 int updi_debugview(void *nvm_ptr, char *cmd);
+int updi_load_timing(const char *port, int baud, link_timing_t *tm);
+int updi_save_timing(const char *port, int baud, const link_timing_t *tm);
 
 int dev_pack_to_vcs_hex_file(const device_info_t * dev, const char *file);
 int dev_vcs_hex_file_show_info(const device_info_t * dev, const char *file);
 
+/*
+Flash programming mode of updi_program()
+    @PROG_CHIP_ERASE: chip erase, then the pages of the file are written
+    @PROG_PAGE_ERASE: only the pages of the file are erased and written, the rest of flash is kept
+    @PROG_DIFF: only the pages differing from the file are erased and written
+*/
+typedef enum { PROG_CHIP_ERASE, PROG_PAGE_ERASE, PROG_DIFF } PROG_MODE_T;
+
 /*
 InfoBlock:  This is firmware infomation this store in eeprom, each time firmware updated, the infoblock is created
 size:	INFO_BLOCK_SIZE(16 bytes)
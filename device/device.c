@@ -9,25 +9,40 @@
 */
 
 
-/* dev_name | {flash_start | flash_size | flash_pagesize} | {syscfg_address | nvmctrl_address | sigrow_address } | {fuses} | {userrow} | {eeprom} */
+/* dev_name | {flash_start | flash_size | flash_pagesize} | {syscfg_address | nvmctrl_address | sigrow_address | crcscan_address } | {fuses} | {userrow} | {eeprom} | flags */
 const chip_info_t device_tiny_321x = {
     //  tiny1617/tiny1616
-    "tiny321x",{ 0x8000, 32 * 1024, 64 },{ 0x0F00, 0x1000, 0x1100 },{ 0x1280, 11, 1 },{ 0x1300, 32, 32 },{ 0x1400, 128, 32}
+    "tiny321x",{ 0x8000, 32 * 1024, 64 },{ 0x0F00, 0x1000, 0x1100, 0x0120 },{ 0x1280, 11, 1 },{ 0x1300, 32, 32 },{ 0x1400, 128, 32}
 };
 
 const chip_info_t device_tiny_161x = {
     //  tiny1617/tiny1616
-    "tiny161x",{ 0x8000, 16 * 1024, 64 },{ 0x0F00, 0x1000, 0x1100 },{ 0x1280, 11, 1 },{ 0x1300, 32, 32 },{ 0x1400, 128, 32 }
+    "tiny161x",{ 0x8000, 16 * 1024, 64 },{ 0x0F00, 0x1000, 0x1100, 0x0120 },{ 0x1280, 11, 1 },{ 0x1300, 32, 32 },{ 0x1400, 128, 32 }
 };
 
 const chip_info_t device_tiny_81x = {
     //  tiny817/tiny816/tiny814
-    "tiny81x", {0x8000, 8 * 1024, 64}, {0x0F00, 0x1000, 0x1100 },{ 0x1280, 11, 1 },{ 0x1300, 32, 32 },{ 0x1400, 128, 32 }
+    "tiny81x", {0x8000, 8 * 1024, 64}, { 0x0F00, 0x1000, 0x1100, 0x0120 },{ 0x1280, 11, 1 },{ 0x1300, 32, 32 },{ 0x1400, 128, 32 }
 };
 
 const chip_info_t device_tiny_41x = {
     //  tiny417
-    "tiny41x", {0x8000, 4 * 1024, 64}, {0x0F00, 0x1000, 0x1100 },{ 0x1280, 11, 1 },{ 0x1300, 32, 32 },{ 0x1400, 128, 32 }
+    "tiny41x", {0x8000, 4 * 1024, 64}, { 0x0F00, 0x1000, 0x1100, 0x0120 },{ 0x1280, 11, 1 },{ 0x1300, 32, 32 },{ 0x1400, 128, 32 }
+};
+
+const chip_info_t device_avr_128dx = {
+    //  avr128da/avr128db
+    "avr128dx", {0x800000, 128 * 1024, 512}, { 0x0F00, 0x1000, 0x1100, 0x0120 },{ 0x1050, 16, 1 },{ 0x1080, 32, 32 },{ 0x1400, 512, 1 }, DEV_FLAG_ADDRESS_24 | DEV_FLAG_NVMCTRL_V2
+};
+
+const chip_info_t device_avr_64dx = {
+    //  avr64da/avr64db
+    "avr64dx", {0x800000, 64 * 1024, 512}, { 0x0F00, 0x1000, 0x1100, 0x0120 },{ 0x1050, 16, 1 },{ 0x1080, 32, 32 },{ 0x1400, 512, 1 }, DEV_FLAG_ADDRESS_24 | DEV_FLAG_NVMCTRL_V2
+};
+
+const chip_info_t device_avr_32dx = {
+    //  avr32da/avr32db
+    "avr32dx", {0x800000, 32 * 1024, 512}, { 0x0F00, 0x1000, 0x1100, 0x0120 },{ 0x1050, 16, 1 },{ 0x1080, 32, 32 },{ 0x1400, 512, 1 }, DEV_FLAG_ADDRESS_24 | DEV_FLAG_NVMCTRL_V2
 };
 
 static const device_info_t g_device_list[] = {
@@ -39,6 +54,28 @@ static const device_info_t g_device_list[] = {
     { "tiny816", &device_tiny_81x },
     { "tiny817", &device_tiny_81x },
     { "tiny417", &device_tiny_41x },
+    { "avr128da28", &device_avr_128dx },
+    { "avr128da32", &device_avr_128dx },
+    { "avr128da48", &device_avr_128dx },
+    { "avr128da64", &device_avr_128dx },
+    { "avr128db28", &device_avr_128dx },
+    { "avr128db32", &device_avr_128dx },
+    { "avr128db48", &device_avr_128dx },
+    { "avr128db64", &device_avr_128dx },
+    { "avr64da28", &device_avr_64dx },
+    { "avr64da32", &device_avr_64dx },
+    { "avr64da48", &device_avr_64dx },
+    { "avr64da64", &device_avr_64dx },
+    { "avr64db28", &device_avr_64dx },
+    { "avr64db32", &device_avr_64dx },
+    { "avr64db48", &device_avr_64dx },
+    { "avr64db64", &device_avr_64dx },
+    { "avr32da28", &device_avr_32dx },
+    { "avr32da32", &device_avr_32dx },
+    { "avr32da48", &device_avr_32dx },
+    { "avr32db28", &device_avr_32dx },
+    { "avr32db32", &device_avr_32dx },
+    { "avr32db48", &device_avr_32dx },
 };
 
 const device_info_t * get_chip_info(const char *dev_name) 
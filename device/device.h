@@ -2,17 +2,26 @@
 #define __UDPI_DEVICE
 
 typedef struct _nvm_info{
-    unsigned short nvm_start;
-    unsigned short nvm_size;
-    unsigned short nvm_pagesize;
+    unsigned int nvm_start;
+    unsigned int nvm_size;
+    unsigned int nvm_pagesize;
 }nvm_info_t;
 
 typedef struct _reg_info {
     unsigned short syscfg_address;
     unsigned short nvmctrl_address;
     unsigned short sigrow_address;
+    unsigned short crcscan_address;
 }reg_info_t;
 
+/*
+    Device capability flags
+    @DEV_FLAG_ADDRESS_24: flash mapped above 64KB, needs the 24bit UPDI addressing
+    @DEV_FLAG_NVMCTRL_V2: NVMCTRL version 2(AVR DA/DB), commands kept in CTRLA and no page buffer
+*/
+#define DEV_FLAG_ADDRESS_24 (1 << 0)
+#define DEV_FLAG_NVMCTRL_V2 (1 << 1)
+
 typedef struct _chip_info {
     const char *dev_name;
     nvm_info_t flash;
@@ -20,6 +29,7 @@ typedef struct _chip_info {
     nvm_info_t fuse;
     nvm_info_t userrow;
     nvm_info_t eeprom;
+    unsigned int flags;
 }chip_info_t;
 
 typedef struct _device_info {
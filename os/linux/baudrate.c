@@ -0,0 +1,123 @@
+/*
+    Custom baudrate of the serial port
+
+    The standard termios only knows the Bxxx constants, the rates which are not in the
+    speed table (250000, 800000...) are set with struct termios2 and BOTHER, the driver
+    then picks the nearest divisor it could generate.
+    <asm/termbits.h> conflicts with <termios.h>, so this file is kept apart from serial.c.
+*/
+
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h>
+#include "../platform.h"
+#include "baudrate.h"
+
+/*
+    Apply an arbitrary baudrate, the other line settings are kept
+    @fd: tty file descriptor
+    @baudrate: baudrate to set
+    @return 0 successful, other value if failed
+*/
+int SetCustomBaudRate(int fd, DWORD baudrate)
+{
+    struct termios2 tio;
+
+    if (ioctl(fd, TCGETS2, &tio) < 0)
+        return -2;
+
+    tio.c_cflag &= ~CBAUD;
+    tio.c_cflag |= BOTHER;
+    tio.c_ospeed = baudrate;
+    tio.c_cflag &= ~(CBAUD << IBSHIFT);
+    tio.c_cflag |= BOTHER << IBSHIFT;
+    tio.c_ispeed = baudrate;
+
+    if (ioctl(fd, TCSETS2, &tio) < 0)
+        return -3;
+
+    return 0;
+}
+
+/*
+    Get the baudrate applied by the driver, which may differ from the requested one
+    @fd: tty file descriptor
+    @return output baudrate, 0 if failed
+*/
+DWORD GetActualBaudRate(int fd)
+{
+    struct termios2 tio;
+
+    if (ioctl(fd, TCGETS2, &tio) < 0)
+        return 0;
+
+    return tio.c_ospeed;
+}
+
+/*
+    Read the line settings of the port into a cache
+    @fd: tty file descriptor
+    @return cache, NULL if failed
+*/
+void *GetLineCache(int fd)
+{
+    struct termios2 *tio;
+
+    tio = (struct termios2 *)malloc(sizeof(*tio));
+    if (!tio)
+        return NULL;
+
+    if (ioctl(fd, TCGETS2, tio) < 0) {
+        free(tio);
+        return NULL;
+    }
+
+    return tio;
+}
+
+/*
+    Patch the cached line settings with the baudrate and the frame, then apply them
+    @fd: tty file descriptor
+    @cache: cache from GetLineCache()
+    @speed: Bxxx constant of the baudrate, 0 if not in the speed table(BOTHER is used)
+    @baudrate: baudrate to set
+    @frame: CSIZE/CSTOPB/PARENB/PARODD flags
+    @actual: output baudrate applied by the driver
+    @return 0 successful, other value if failed(errno is kept)
+*/
+int SetLineCache(int fd, void *cache, unsigned int speed, DWORD baudrate, unsigned int frame, DWORD *actual)
+{
+    struct termios2 *tio = (struct termios2 *)cache;
+
+    if (!tio)
+        return -1;
+
+    if (!speed)
+        speed = BOTHER;
+
+    tio->c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT) | CSIZE | CSTOPB | PARENB | PARODD);
+    tio->c_cflag |= speed | (speed << IBSHIFT) | (frame & (CSIZE | CSTOPB | PARENB | PARODD));
+    tio->c_ispeed = baudrate;
+    tio->c_ospeed = baudrate;
+
+    if (ioctl(fd, TCSETS2, tio) < 0)
+        return -2;
+
+    /* Read back the rate rounded by the driver, the cache follows the port */
+    if (ioctl(fd, TCGETS2, tio) < 0)
+        return -3;
+
+    if (actual)
+        *actual = tio->c_ospeed;
+
+    return 0;
+}
+
+/*
+    Release the cache
+*/
+void FreeLineCache(void *cache)
+{
+    if (cache)
+        free(cache);
+}
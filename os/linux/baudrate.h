@@ -0,0 +1,24 @@
+#ifndef __LINUX_BAUDRATE_H
+#define __LINUX_BAUDRATE_H
+
+/**
+ * Apply an arbitrary baudrate with termios2/BOTHER
+ * @implementation baudrate.c
+ */
+int SetCustomBaudRate(int fd, DWORD baudrate);
+
+/**
+ * Get the baudrate applied by the driver
+ * @implementation baudrate.c
+ */
+DWORD GetActualBaudRate(int fd);
+
+/**
+ * Cache of the line settings, patched and applied with a single TCSETS2
+ * @implementation baudrate.c
+ */
+void *GetLineCache(int fd);
+int SetLineCache(int fd, void *cache, unsigned int speed, DWORD baudrate, unsigned int frame, DWORD *actual);
+void FreeLineCache(void *cache);
+
+#endif
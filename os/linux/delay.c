@@ -1,7 +1,25 @@
 #include <unistd.h>
+#include <time.h>
 
 //delay millisecond here
 void msleep(int ms)
 {
     usleep(ms * 1000);
-}
\ No newline at end of file
+}
+
+//delay microsecond here, for waits shorter than the msleep() granularity
+void udelay(int us)
+{
+    if (us > 0)
+        usleep(us);
+}
+
+//monotonic clock in microsecond, for deadline and elapsed time
+unsigned long long clock_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
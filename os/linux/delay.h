@@ -2,5 +2,7 @@
 #define __LINUX_TIME_H
 
 void msleep(int ms);
+void udelay(int us);
+ULONGLONG clock_us(void);
 
 #endif
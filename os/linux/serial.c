@@ -10,8 +10,10 @@
  * This file contains the function implementations for serial port
  * communication.
  */
+#define _GNU_SOURCE //ppoll()
 #include "serial.h"
 #include "error.h"
+#include "baudrate.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -20,16 +22,46 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/sysmacros.h>
 #include <string.h>
+#include <poll.h>
+#include <libgen.h>
+#include <limits.h>
+#include <linux/serial.h>
 
+/*
+    SERCOM level memory struct
+    @mgwd: magicword
+    @fd: tty file descriptor
+    @baudrate: current baudrate, used for the receive deadline
+    @frame_bits: bits on the wire of each byte(start + data + parity + stop)
+    @foreign: the fd is supplied by the caller, not closed by ClosePort()
+    @pty: whether the port is a pseudo terminal
+    @hw_break: whether the driver could hold the line in BREAK condition
+    @serinfo_saved/serinfo: original serial flags, restored at close
+    @latency_timer/latency_path: original latency timer of the USB adapter and its sysfs path, restored at close
+    @line: cached line settings of a tty, NULL if not configured or not a tty
+*/
 typedef struct _upd_sercom {
 #define UPD_SERCOM_MAGIC_WORD 0xA5A5//'user'
     unsigned int mgwd;
     int fd;
+    DWORD baudrate;
+    int frame_bits;
+    bool foreign;
+    bool pty;
+    bool hw_break;
+    bool serinfo_saved;
+    struct serial_struct serinfo;
+    int latency_timer;
+    char latency_path[PATH_MAX];
+    void *line;
 }upd_sercom_t;
 
 #define VALID_SER(_ser) ((_ser) && (((upd_sercom_t *)(_ser))->mgwd == UPD_SERCOM_MAGIC_WORD) && ((upd_sercom_t *)(_ser))->fd)
 #define FD(_ser) ((int)(_ser)->fd)
+#define FRAME_BITS(_st) (1 + (_st)->byteSize + ((_st)->parity != NOPARITY ? 1 : 0) + ((_st)->stopBits == TWOSTOPBITS ? 2 : 1))
 #ifdef __APPLE__
 static speed_t speed_arr[] = {B0, B50, B75, B110, B134, B150, B200, B300, B600, B1200, B1800,
                               B2400, B4800, B9600, B19200, B38400, B57600, B115200, B230400,
@@ -49,7 +81,16 @@ static int name_arr[] = {0, 50, 75, 110, 134, 150, 200, 300, 600, 1200, 1800,
                         460800, 500000, 576000, 921600, 1000000};
 #endif
 
-#define RECEIVE_DELAY_EACH_TIME 5 //ms. Test 9600 baudrate is enough for the delay time
+#define RECEIVE_TIMEOUT_MARGIN 100 //ms. Added to the wire time of each receive, covers adapter latency and target response
+#define SEND_DRAIN_TIMEOUT 1000 //ms. Wait of a send for room in a non-blocking descriptor
+#define BREAK_HOLD_TIME 25 //ms. Line low time of each BREAK, above the 24.6ms required at the slowest UPDI clock
+#define BREAK_GAP_TIME 1 //ms. Line idle time after each BREAK
+#define USB_LATENCY_TIMER 1 //ms. Latency timer of USB adapter, default 16ms of FTDI dominates the small transfers
+#define ECHO_LATENCY_WARNING 4000 //us. Echo round trip above this is reported at open
+#define UNIX98_PTY_SLAVE_MAJOR_FIRST 136
+#define UNIX98_PTY_SLAVE_MAJOR_LAST 143
+
+static int ConfigurePort(upd_sercom_t *ser, const SER_PORT_STATE_T *st);
 
 static speed_t GetBaudRate(int baudrate)
 {
@@ -64,6 +105,110 @@ static speed_t GetBaudRate(int baudrate)
     return B0;
 }
 
+/*
+    Read an integer from a sysfs file
+    @return value, negative if failed
+*/
+static int ReadSysfsInt(const char *path)
+{
+    FILE *fp;
+    int val = -1;
+
+    fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+
+    if (fscanf(fp, "%d", &val) != 1)
+        val = -1;
+    fclose(fp);
+
+    return val;
+}
+
+/*
+    Write an integer to a sysfs file
+    @return 0 successful, other value if failed
+*/
+static int WriteSysfsInt(const char *path, int val)
+{
+    FILE *fp;
+    int result;
+
+    fp = fopen(path, "w");
+    if (!fp)
+        return -1;
+
+    result = fprintf(fp, "%d", val) > 0 ? 0 : -2;
+    if (fclose(fp))
+        result = -3;
+
+    return result;
+}
+
+/*
+    Tune the port for small round trips: ASYNC_LOW_LATENCY, and the latency timer of the
+    USB adapter where the driver exposes it (FTDI) and the sysfs file is writable.
+    The original settings are saved for RestoreLowLatency()
+*/
+static void SetLowLatency(upd_sercom_t *ser, const char *port)
+{
+    struct serial_struct serinfo;
+    char path[PATH_MAX], link[PATH_MAX], *name;
+    const char *driver = "unknown";
+    ssize_t len;
+    int latency;
+
+    if (ioctl(FD(ser), TIOCGSERIAL, &serinfo) == 0) {
+        memcpy(&ser->serinfo, &serinfo, sizeof(serinfo));
+        ser->serinfo_saved = true;
+
+        serinfo.flags |= ASYNC_LOW_LATENCY;
+        if (ioctl(FD(ser), TIOCSSERIAL, &serinfo) < 0)
+            DBG_INFO(SER_DEBUG, "<SER> Set ASYNC_LOW_LATENCY failed (%s)", strerror(errno));
+    }
+
+    /* /dev/ttyUSB0 -> /sys/class/tty/ttyUSB0/device */
+    if (!realpath(port, path))
+        return;
+    name = basename(path);
+
+    snprintf(link, sizeof(link), "/sys/class/tty/%s/device/driver", name);
+    len = readlink(link, path, sizeof(path) - 1);
+    if (len > 0) {
+        path[len] = '\0';
+        driver = basename(path);
+    }
+
+    snprintf(ser->latency_path, sizeof(ser->latency_path), "/sys/class/tty/%s/device/latency_timer", name);
+    latency = ReadSysfsInt(ser->latency_path);
+    if (latency > USB_LATENCY_TIMER) {
+        if (WriteSysfsInt(ser->latency_path, USB_LATENCY_TIMER) == 0) {
+            ser->latency_timer = latency;
+        }
+        else {
+            _loginfo_i("Latency timer of %s (%s) is %d ms, not permitted to change %s", name, driver, latency, ser->latency_path);
+        }
+    }
+
+    DBG_INFO(SER_DEBUG, "<SER> %s driver %s, latency timer %d", name, driver, latency);
+}
+
+/*
+    Restore the settings changed by SetLowLatency()
+*/
+static void RestoreLowLatency(upd_sercom_t *ser)
+{
+    if (ser->serinfo_saved) {
+        ioctl(FD(ser), TIOCSSERIAL, &ser->serinfo);
+        ser->serinfo_saved = false;
+    }
+
+    if (ser->latency_timer > 0) {
+        WriteSysfsInt(ser->latency_path, ser->latency_timer);
+        ser->latency_timer = 0;
+    }
+}
+
 /**
  * Initialises a serial port handle for reading and writing
  *
@@ -78,6 +223,7 @@ static speed_t GetBaudRate(int baudrate)
 
 HANDLE OpenPort(const void *port, const SER_PORT_STATE_T *st) {
     upd_sercom_t *ser;
+    struct stat sb;
     int fd = 0;
 
     /* open tty device */
@@ -93,10 +239,18 @@ HANDLE OpenPort(const void *port, const SER_PORT_STATE_T *st) {
         return 0;
     }
 
+    memset(ser, 0, sizeof(*ser));
     ser->mgwd = UPD_SERCOM_MAGIC_WORD;
     ser->fd = fd;
 
-    if (SetPortState(ser, st) != 0) {
+    /* A pseudo terminal (the UPDI simulator) accepts TIOCSBRK but can't carry the BREAK condition */
+    ser->pty = !fstat(fd, &sb) && S_ISCHR(sb.st_mode) &&
+        major(sb.st_rdev) >= UNIX98_PTY_SLAVE_MAJOR_FIRST && major(sb.st_rdev) <= UNIX98_PTY_SLAVE_MAJOR_LAST;
+    ser->hw_break = !ser->pty;
+
+    SetLowLatency(ser, port);
+
+    if (ConfigurePort(ser, st) != 0) {
         ClosePort(ser);
         ser = NULL;
     }
@@ -105,103 +259,154 @@ HANDLE OpenPort(const void *port, const SER_PORT_STATE_T *st) {
 }
 
 /**
-* Set a serial port state
-*
-* @param char *ser  The port handle.
-* @param DWORD baudRate The bautrate to commulication
-* @param BYTE byteSize The data size
-* @param BYTE stopBits The number of stop bits ONESTOPBIT|ONE5STOPBITS|TWOSTOPBITS
-* @param BYTE parity The partity checksum  NOPARITY|ODDPARITY|EVENPARITY
-* @returns 0 - success, other value failed code
-*/
-int SetPortState(void *ptr_ser, const SER_PORT_STATE_T *st) {
-    upd_sercom_t *ser = (upd_sercom_t *)ptr_ser;
-    struct termios tio;
-    int status;
-    int fd = FD(ser);
+ * Initialises a serial port handle on a file descriptor supplied by an embedding
+ * application. It could be a tty, or a socket/pipe which loops the sent data back like
+ * the UPDI wire does, only the line timing is kept for a descriptor which isn't a tty.
+ *
+ * @param int fd  The file descriptor, it's not closed by ClosePort().
+ * @param SER_PORT_STATE_T *st The line settings
+ * @returns HANDLE fd   The handle, NULL if failed
+ */
+HANDLE OpenPortFd(int fd, const SER_PORT_STATE_T *st) {
+    upd_sercom_t *ser;
 
-    if (!VALID_SER(ser))
-        return ERROR_PTR;
+    if (fd <= 0)
+        return NULL;
 
-    if (!isatty(fd)) {
-        printf("Not a tty device\n");
-#ifdef __APPLE__
-        printf("Make sure to use /dev/cu.* device instead of /dev/tty.*\n");
-#endif
-        return -2;
-    }
+    ser = (upd_sercom_t *)malloc(sizeof(*ser));
+    if (!ser)
+        return NULL;
 
-    /* Lock device file */
-    status = flock(fd, LOCK_EX | LOCK_NB);
-    if ((status == -1) && (errno == EWOULDBLOCK))
-    {
-        printf("Device file is locked by another process\n");
-        return -3;
-    }
+    memset(ser, 0, sizeof(*ser));
+    ser->mgwd = UPD_SERCOM_MAGIC_WORD;
+    ser->fd = fd;
+    ser->foreign = true;
+    ser->hw_break = isatty(fd);
 
-    memset(&tio, 0, sizeof(tio));
-    status = cfsetispeed(&tio, GetBaudRate(st->baudRate));  // Set input speed
-    if (status == -1) {
-        printf("Could not configure input speed (%s)s\n", strerror(errno));
-        return -4;
-    }
-    status = cfsetospeed(&tio, GetBaudRate(st->baudRate));  // Set output speed
-    if (status == -1) {
-        printf("Could not configure output speed (%s)s\n", strerror(errno));
-        return -5;
+    if ((ser->hw_break ? ConfigurePort(ser, st) : SetPortState(ser, st)) != 0) {
+        ClosePort(ser);
+        ser = NULL;
     }
 
+    return (HANDLE)ser;
+}
+
+/*
+    Get the termios frame flags of the line settings
+    @st: line settings
+    @cflag: output CSIZE/CSTOPB/PARENB/PARODD flags
+    @return 0 successful, other value if invalid
+*/
+static int GetFrameFlags(const SER_PORT_STATE_T *st, tcflag_t *cflag)
+{
+    tcflag_t flag = 0;
+
     /* Set databits */
-    tio.c_cflag &= ~CSIZE;
     switch (st->byteSize) {
         case 5:
-            tio.c_cflag |= CS5;
+            flag |= CS5;
             break;
         case 6:
-            tio.c_cflag |= CS6;
+            flag |= CS6;
             break;
         case 7:
-            tio.c_cflag |= CS7;
+            flag |= CS7;
             break;
         case 8:
-            tio.c_cflag |= CS8;
+            flag |= CS8;
             break;
         default:
             printf("Invalid data bitss\n");
-            return -6;
+            return -1;
     }
 
     /* Set stopbits */
     switch (st->stopBits) {
         case ONESTOPBIT:
-            tio.c_cflag &= ~CSTOPB;
             break;
         case TWOSTOPBITS:
-            tio.c_cflag |= CSTOPB;
+            flag |= CSTOPB;
             break;
         default:
             printf("Invalid stop bitss\n");
-            return -7;
+            return -2;
     }
 
     /* Set parity */
     switch (st->parity) {
         case NOPARITY:
-            tio.c_cflag &= ~PARENB;
             break;
         case ODDPARITY:
-            tio.c_cflag |= PARENB;
-            tio.c_cflag |= PARODD;
+            flag |= PARENB | PARODD;
             break;
         case EVENPARITY:
-            tio.c_cflag |= PARENB;
-            tio.c_cflag &= ~PARODD;
+            flag |= PARENB;
             break;
         default:
             printf("Invalid paritys\n");
-            return -8;
+            return -3;
+    }
+
+    *cflag = flag;
+
+    return 0;
+}
+
+/**
+* Configure a serial port at open: check and lock the tty, build the termios from scratch,
+* flush, and cache the line settings for the later SetPortState() calls
+*
+* @param char *ser  The port handle.
+* @param SER_PORT_STATE_T *st The line settings
+* @returns 0 - success, other value failed code
+*/
+static int ConfigurePort(upd_sercom_t *ser, const SER_PORT_STATE_T *st) {
+    struct termios tio;
+    speed_t speed;
+    tcflag_t frame;
+    DWORD actual;
+    int status;
+    int fd = FD(ser);
+
+    if (!isatty(fd)) {
+        printf("Not a tty device\n");
+#ifdef __APPLE__
+        printf("Make sure to use /dev/cu.* device instead of /dev/tty.*\n");
+#endif
+        return -2;
+    }
+
+    /* Lock device file */
+    status = flock(fd, LOCK_EX | LOCK_NB);
+    if ((status == -1) && (errno == EWOULDBLOCK))
+    {
+        printf("Device file is locked by another process\n");
+        return -3;
     }
 
+    /* Baudrate not in the speed table is applied with termios2 after the other settings */
+    speed = GetBaudRate(st->baudRate);
+    if (speed == B0 && st->baudRate)
+        speed = B38400;
+
+    memset(&tio, 0, sizeof(tio));
+    status = cfsetispeed(&tio, speed);  // Set input speed
+    if (status == -1) {
+        printf("Could not configure input speed (%s)s\n", strerror(errno));
+        return -4;
+    }
+    status = cfsetospeed(&tio, speed);  // Set output speed
+    if (status == -1) {
+        printf("Could not configure output speed (%s)s\n", strerror(errno));
+        return -5;
+    }
+
+    /* Set databits, stopbits and parity */
+    if (GetFrameFlags(st, &frame))
+        return -6;
+    tio.c_cflag &= ~(CSIZE | CSTOPB | PARENB | PARODD);
+    tio.c_cflag |= frame;
+
     /* Set flow control -- none */   
 #if defined(_BSD_SOURCE) || defined(_SVID_SOURCE)
     tio.c_cflag &= ~CRTSCTS;
@@ -216,10 +421,10 @@ int SetPortState(void *ptr_ser, const SER_PORT_STATE_T *st) {
     //tio.c_oflag = 0;
     //tio.c_lflag = 0;
     tio.c_oflag &= ~OPOST; /*Output*/
-    tio.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);  /* Non Cannonical mode   
+    tio.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);  /* Non Cannonical mode */
 
-    /* Control characters */
-    tio.c_cc[VTIME] = 5; // Inter-character timer unused 1/10s
+    /* Control characters: read() never blocks, the receive timeout is handled by poll() in ReadData() */
+    tio.c_cc[VTIME] = 0; // Inter-character timer unused 1/10s
     tio.c_cc[VMIN]  = 0; // If set, blocking read until 1 character received
 
     /* Flush stale I/O data (if any) */
@@ -227,18 +432,120 @@ int SetPortState(void *ptr_ser, const SER_PORT_STATE_T *st) {
 
     /* Activate new port settings */
     status = tcsetattr(fd, TCSANOW, &tio);
+    if (status == -1 && errno == EINVAL && ser->pty) {
+        /* A pty drops the parity setting, and the kernel reports EINVAL when nothing else changed */
+        status = 0;
+    }
     if (status == -1)
     {
         printf("Could not apply port settings (%s)s\n", strerror(errno));
         return -9;
     }
 
+    /* Custom baudrate */
+    if (GetBaudRate(st->baudRate) == B0 && st->baudRate) {
+        status = SetCustomBaudRate(fd, st->baudRate);
+        if (status) {
+            printf("Could not configure custom baudrate %lu (%s)\n", st->baudRate, strerror(errno));
+            return -10;
+        }
+    }
+
     /* Flush stale I/O data (if any) */
     tcflush(fd, TCIOFLUSH);
 
+    /* Cache the line settings, patched by the later changes */
+    ser->line = GetLineCache(fd);
+    if (!ser->line) {
+        printf("Could not cache port settings (%s)\n", strerror(errno));
+        return -11;
+    }
+
+    /* The driver rounds the rate to the divisor it could generate */
+    actual = GetActualBaudRate(fd);
+    if (!actual)
+        actual = st->baudRate;
+    if (actual != st->baudRate)
+        DBG_INFO(SER_DEBUG, "<SER> Baudrate %lu requested, %lu applied", st->baudRate, actual);
+
+    ser->baudrate = actual;
+    ser->frame_bits = FRAME_BITS(st);
+
+    return 0;
+}
+
+/**
+* Set a serial port state
+* The port is configured at open, here the cached line settings are patched with the
+* baudrate and frame, and applied with a single TCSETS2: no lock, no flush
+*
+* @param char *ser  The port handle.
+* @param DWORD baudRate The bautrate to commulication
+* @param BYTE byteSize The data size
+* @param BYTE stopBits The number of stop bits ONESTOPBIT|ONE5STOPBITS|TWOSTOPBITS
+* @param BYTE parity The partity checksum  NOPARITY|ODDPARITY|EVENPARITY
+* @returns 0 - success, other value failed code
+*/
+int SetPortState(void *ptr_ser, const SER_PORT_STATE_T *st) {
+    upd_sercom_t *ser = (upd_sercom_t *)ptr_ser;
+    tcflag_t frame;
+    DWORD actual;
+    int status;
+
+    if (!VALID_SER(ser))
+        return ERROR_PTR;
+
+    /* Not a tty, only the timing is kept */
+    if (!ser->line) {
+        if (ser->foreign) {
+            ser->baudrate = st->baudRate;
+            ser->frame_bits = FRAME_BITS(st);
+            return 0;
+        }
+        return -2;
+    }
+
+    if (GetFrameFlags(st, &frame))
+        return -3;
+
+    actual = 0;
+    status = SetLineCache(FD(ser), ser->line, GetBaudRate(st->baudRate), st->baudRate, frame, &actual);
+    if (status && errno == EINVAL && ser->pty) {
+        /* Same as ConfigurePort(), the parity of a pty can't be set */
+        status = 0;
+    }
+    if (status) {
+        printf("Could not apply port settings %lu (%s)\n", st->baudRate, strerror(errno));
+        return -4;
+    }
+
+    if (!actual)
+        actual = st->baudRate;
+    if (actual != st->baudRate)
+        DBG_INFO(SER_DEBUG, "<SER> Baudrate %lu requested, %lu applied", st->baudRate, actual);
+
+    ser->baudrate = actual;
+    ser->frame_bits = FRAME_BITS(st);
+
     return 0;
 }
 
+/**
+* Get the baudrate applied by the driver at the last SetPortState()
+*
+* @param char *ser  The port handle.
+* @returns baudrate, 0 if failed
+*/
+DWORD GetPortBaudRate(void *ptr_ser)
+{
+    upd_sercom_t *ser = (upd_sercom_t *)ptr_ser;
+
+    if (!VALID_SER(ser))
+        return 0;
+
+    return ser->baudrate;
+}
+
 int FlushPort(void *ptr_ser) 
 {
     upd_sercom_t *ser = (upd_sercom_t *)ptr_ser;
@@ -251,6 +558,87 @@ int FlushPort(void *ptr_ser)
     return 0;
 }
 
+/**
+ * Sends BREAK conditions by holding the line low with TIOCSBRK/TIOCCBRK.
+ * The received data of the BREAK (0x00 with framing error) is dropped.
+ *
+ * @param HANDLE fd The handle to the serial port.
+ * @param int count The number of BREAK to send.
+ *
+ * @returns 0 if successful, negative value if the driver can't generate BREAK,
+ *          the caller should fall back to a slow zero frame then.
+ */
+int SendBreak(void *ptr_ser, int count) {
+    upd_sercom_t *ser = (upd_sercom_t *)ptr_ser;
+    int i;
+
+    if (!VALID_SER(ser))
+        return ERROR_PTR;
+
+    if (!ser->hw_break)
+        return -2;
+
+    /* Wait the pending output on the wire before the line is pulled low */
+    tcdrain(FD(ser));
+
+    for (i = 0; i < count; i++) {
+        if (ioctl(FD(ser), TIOCSBRK) < 0) {
+            DBG_INFO(SER_DEBUG, "<SER> TIOCSBRK failed (%s)", strerror(errno));
+            ser->hw_break = false;
+            return -3;
+        }
+
+        msleep(BREAK_HOLD_TIME);
+
+        if (ioctl(FD(ser), TIOCCBRK) < 0) {
+            DBG_INFO(SER_DEBUG, "<SER> TIOCCBRK failed (%s)", strerror(errno));
+            ser->hw_break = false;
+            return -4;
+        }
+
+        msleep(BREAK_GAP_TIME);
+    }
+
+    tcflush(FD(ser), TCIFLUSH);
+
+    return 0;
+}
+
+/**
+ * Measures the echo round trip of the port, the line must loop the TX back to RX
+ * (which is the case of the single wire UPDI), a warning is reported if it's slow.
+ *
+ * @param HANDLE fd The handle to the serial port.
+ * @param BYTE val The byte to send, it should be ignored by the receiver.
+ *
+ * @returns round trip in us, negative value if failed
+ */
+int MeasureEchoLatency(void *ptr_ser, BYTE val) {
+    upd_sercom_t *ser = (upd_sercom_t *)ptr_ser;
+    ULONGLONG start;
+    BYTE echo;
+    int elapsed;
+
+    if (!VALID_SER(ser))
+        return ERROR_PTR;
+
+    start = clock_us();
+    if (SendData(ser, &val, 1))
+        return -2;
+
+    if (ReadData(ser, &echo, 1) != 1 || echo != val) {
+        FlushPort(ser);
+        return -3;
+    }
+
+    elapsed = (int)(clock_us() - start);
+    DBG_INFO(SER_DEBUG, "<SER> Echo round trip %d us", elapsed);
+    if (elapsed > ECHO_LATENCY_WARNING)
+        _loginfo_i("Echo round trip of the port is %d.%d ms, check the latency timer of the USB adapter", elapsed / 1000, (elapsed % 1000) / 100);
+
+    return elapsed;
+}
+
 /**
  * Sends data out the serial port pointed to by the handle fd.
  *
@@ -258,19 +646,41 @@ int FlushPort(void *ptr_ser)
  * @param LPVOID tx The data to be transmitted.
  * @param DWORD len The length of the data.
  *
- * @returns 0 if successful, greater than 0 otherwise.
+ * @returns 0 if all the data is written, negative value mean error code
  */
 int SendData(void *ptr_ser, const LPVOID tx, DWORD len) {
     upd_sercom_t *ser = (upd_sercom_t *)ptr_ser;
-    DWORD written = 0;
-    
+    struct pollfd pfd;
+    ssize_t written;
+    DWORD offset = 0;
+    int status;
+
     if (!VALID_SER(ser))
         return ERROR_PTR;
 
-    /* Write to the port handle */
-    written = write(FD(ser), tx, len);
-    if (written < 0) {
-        return -2;
+    pfd.fd = FD(ser);
+    pfd.events = POLLOUT;
+
+    /* Write to the port handle, until all is written: a short write sends the rest again */
+    while (offset < len) {
+        written = write(FD(ser), (const BYTE *)tx + offset, len - offset);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+
+            if (errno != EAGAIN)
+                return -2;
+
+            /* Non-blocking descriptor(such as the fd: port) full, wait until it drains */
+            status = poll(&pfd, 1, SEND_DRAIN_TIMEOUT);
+            if (status < 0 && errno != EINTR)
+                return -2;
+            if (status == 0)
+                return -3;
+            continue;
+        }
+
+        offset += written;
     }
 
     return 0;
@@ -286,41 +696,54 @@ int SendData(void *ptr_ser, const LPVOID tx, DWORD len) {
  */
 int ReadData(void *ptr_ser, LPVOID rx, DWORD len) {
     upd_sercom_t *ser = (upd_sercom_t *)ptr_ser;
+    struct pollfd pfd;
+    struct timespec ts;
+    ULONGLONG now, deadline;
     int reading = 0;
     int offset = 0;
-/*    WORD fs_sel;
-    fd_set fs_read;
-    struct timeval time;
+    int status;
 
-    FD_ZERO(&fs_read);
-    FD_SET(FD(ser), &fs_read);
+    if (!VALID_SER(ser))
+        return ERROR_PTR;
 
-    time.tv_sec = 0;
-    time.tv_usec = 10000;
+    /* Deadline of the whole transfer: wire time of the expected bytes plus a fixed margin */
+    deadline = clock_us() + (ULONGLONG)RECEIVE_TIMEOUT_MARGIN * 1000;
+    if (ser->baudrate)
+        deadline += ((ULONGLONG)len * ser->frame_bits * 1000000 + ser->baudrate - 1) / ser->baudrate;
 
-    fs_sel = select(FD(ser) + 1, &fs_read, NULL, NULL, &time);
-    if (fs_sel) {
-        reading = read(FD(ser), rx, len);
-        if (reading < 0) {
+    pfd.fd = FD(ser);
+    pfd.events = POLLIN;
+
+    while (offset < len) {
+        now = clock_us();
+        if (now >= deadline)
+            break;
+
+        ts.tv_sec = (deadline - now) / 1000000;
+        ts.tv_nsec = ((deadline - now) % 1000000) * 1000;
+
+        status = ppoll(&pfd, 1, &ts, NULL);
+        if (status < 0) {
+            if (errno == EINTR)
+                continue;
             return -2;
         }
 
-        return reading;
-    } else {
-        return -3;
-    }
-*/    
+        if (status == 0)
+            break;  //timeout
 
-    do {
-      reading = read(FD(ser), rx + offset, len - offset);
-      if (reading <= 0)
-          break;
+        if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+            return -3;
 
-      offset += reading;
-      if (offset < len)
-        msleep(RECEIVE_DELAY_EACH_TIME);
-        
-    }while(offset < len);
+        reading = read(FD(ser), (BYTE *)rx + offset, len - offset);
+        if (reading < 0) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            return -2;
+        }
+
+        offset += reading;
+    }
 
     return offset;
 }
@@ -337,8 +760,11 @@ void ClosePort(void *ptr_ser) {
         return;
 
     if (ser->fd) {
+        RestoreLowLatency(ser);
+        FreeLineCache(ser->line);
         flock(FD(ser), LOCK_UN);
-        close(FD(ser));
+        if (!ser->foreign)
+            close(FD(ser));
         free(ser);
     }
 }
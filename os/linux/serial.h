@@ -41,18 +41,42 @@ typedef struct __SER_PORT_STATE{
  */
 HANDLE OpenPort(const void *port, const SER_PORT_STATE_T *state);
 
+/**
+ * Initialises a serial port handle on a file descriptor of the caller
+ * @implementation serial.c
+ */
+HANDLE OpenPortFd(int fd, const SER_PORT_STATE_T *state);
+
 /**
 * configure a serial port 
 * @implementation serial.c
 */
 int SetPortState(void *ptr_ser, const SER_PORT_STATE_T *state);
 
+/**
+* get the effective baudrate of the serial port
+* @implementation serial.c
+*/
+DWORD GetPortBaudRate(void *ptr_ser);
+
 /**
 * clear the serial port
 * @implementation serial.c
 */
 int FlushPort(void *ptr_ser);
 
+/**
+ * Sends BREAK conditions out the serial port.
+ * @implementation serial.c
+ */
+int SendBreak(void *ptr_ser, int count);
+
+/**
+ * Measures the echo round trip of the serial port.
+ * @implementation serial.c
+ */
+int MeasureEchoLatency(void *ptr_ser, BYTE val);
+
 /**
  * Sends data out the serial port pointed to by the handle fd.
  * @implementation serial.c
@@ -0,0 +1,213 @@
+/*
+    Host-side cache of the flash pages written to a chip
+
+    The cache file holds the flash geometry, the probe and one line for each page not blank:
+        cache <start> <pagesize> <pages>
+        probe <hash>
+        <page> <hash>
+    The hash is the 64bit FNV-1a
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pagecache.h"
+
+#define PAGECACHE_HASH_PRIME 0x100000001b3ULL
+#define PAGECACHE_PAD 0xFF
+
+/*
+    Create an empty page cache of the flash, all pages blank
+    @start: flash start address
+    @pages: number of pages
+    @pagesize: page size
+    @return page cache, NULL if failed
+*/
+pagecache_t *pagecache_create(unsigned int start, int pages, int pagesize)
+{
+    pagecache_t *pc;
+    unsigned char *blank;
+
+    if (pagesize <= 0 || pages <= 0)
+        return NULL;
+
+    pc = (pagecache_t *)malloc(sizeof(*pc));
+    if (!pc)
+        return NULL;
+
+    pc->start = start;
+    pc->pagesize = pagesize;
+    pc->pages = pages;
+    pc->probe = 0;
+    pc->hash = (unsigned long long *)malloc((size_t)pages * sizeof(*pc->hash));
+    blank = (unsigned char *)malloc(pagesize);
+    if (!pc->hash || !blank) {
+        free(blank);
+        pagecache_destroy(pc);
+        return NULL;
+    }
+
+    memset(blank, PAGECACHE_PAD, pagesize);
+    pc->blank = pagecache_hash(PAGECACHE_HASH_INIT, blank, pagesize);
+    free(blank);
+
+    pagecache_clear(pc);
+
+    return pc;
+}
+
+/*
+    Destroy the page cache
+    @pc: page cache, acquired from pagecache_create()
+*/
+void pagecache_destroy(pagecache_t *pc)
+{
+    if (!pc)
+        return;
+
+    free(pc->hash);
+    free(pc);
+}
+
+/*
+    Hash data, chained from a previous hash
+    @hash: previous hash, PAGECACHE_HASH_INIT to start
+    @data: data
+    @len: data length
+    @return hash
+*/
+unsigned long long pagecache_hash(unsigned long long hash, const unsigned char *data, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= PAGECACHE_HASH_PRIME;
+    }
+
+    return hash;
+}
+
+/*
+    Mark all pages blank
+    @pc: page cache
+*/
+void pagecache_clear(pagecache_t *pc)
+{
+    int i;
+
+    for (i = 0; i < pc->pages; i++)
+        pc->hash[i] = pc->blank;
+}
+
+/*
+    Set the content of a page
+    @pc: page cache
+    @page: page index
+    @data: page content, pagesize bytes
+    @return 0 successful, other value failed
+*/
+int pagecache_set(pagecache_t *pc, int page, const unsigned char *data)
+{
+    if (page < 0 || page >= pc->pages)
+        return -1;
+
+    pc->hash[page] = pagecache_hash(PAGECACHE_HASH_INIT, data, pc->pagesize);
+
+    return 0;
+}
+
+/*
+    Check whether a page holds the data
+    @pc: page cache
+    @page: page index
+    @data: page content, pagesize bytes
+    @return non-zero if the same
+*/
+int pagecache_same(const pagecache_t *pc, int page, const unsigned char *data)
+{
+    if (page < 0 || page >= pc->pages)
+        return 0;
+
+    return pc->hash[page] == pagecache_hash(PAGECACHE_HASH_INIT, data, pc->pagesize);
+}
+
+/*
+    Load the page cache from file
+    @pc: page cache, its flash geometry must match the file
+    @path: file path
+    @return 0 successful, other value failed
+*/
+int pagecache_load(pagecache_t *pc, const char *path)
+{
+    char line[128];
+    unsigned int start;
+    unsigned long long hash;
+    int pagesize, pages, page;
+    FILE *fp;
+    int result = 0;
+
+    fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+
+    if (!fgets(line, sizeof(line), fp) || sscanf(line, "cache %x %d %d", &start, &pagesize, &pages) != 3
+        || start != pc->start || pagesize != pc->pagesize || pages != pc->pages) {
+        result = -2;
+        goto out;
+    }
+
+    if (!fgets(line, sizeof(line), fp) || sscanf(line, "probe %llx", &pc->probe) != 1) {
+        result = -3;
+        goto out;
+    }
+
+    pagecache_clear(pc);
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "%d %llx", &page, &hash) != 2 || page < 0 || page >= pc->pages) {
+            result = -4;
+            break;
+        }
+        pc->hash[page] = hash;
+    }
+
+out:
+    fclose(fp);
+    return result;
+}
+
+/*
+    Save the page cache to file, replaced at once
+    @pc: page cache
+    @path: file path
+    @return 0 successful, other value failed
+*/
+int pagecache_save(const pagecache_t *pc, const char *path)
+{
+    char tmp[272];
+    FILE *out;
+    int i, len;
+
+    len = snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    if (len <= 0 || len >= (int)sizeof(tmp))
+        return -1;
+
+    out = fopen(tmp, "w");
+    if (!out)
+        return -2;
+
+    fprintf(out, "cache %x %d %d\n", pc->start, pc->pagesize, pc->pages);
+    fprintf(out, "probe %llx\n", pc->probe);
+    for (i = 0; i < pc->pages; i++) {
+        if (pc->hash[i] != pc->blank)
+            fprintf(out, "%d %llx\n", i, pc->hash[i]);
+    }
+
+    if (fclose(out))
+        return -3;
+
+    if (rename(tmp, path))
+        return -4;
+
+    return 0;
+}
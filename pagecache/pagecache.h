@@ -0,0 +1,36 @@
+#ifndef __PAGECACHE_H
+#define __PAGECACHE_H
+
+/*
+    Page cache: the hash of each flash page last written to a chip, kept on the host by chip serial number,
+        so the unchanged pages are skipped without reading the flash back.
+    The pages not listed are blank. The cache only stands while the probe, a hash of some cheap
+        reads of the chip taken after the last write, is still the same
+    @start: flash start address
+    @pagesize: page size
+    @pages: number of pages of the flash
+    @probe: hash of the consistency probe
+    @blank: hash of a blank page
+    @hash: hash of each page
+*/
+typedef struct _pagecache {
+    unsigned int start;
+    int pagesize;
+    int pages;
+    unsigned long long probe;
+    unsigned long long blank;
+    unsigned long long *hash;
+}pagecache_t;
+
+#define PAGECACHE_HASH_INIT 0xcbf29ce484222325ULL
+
+pagecache_t *pagecache_create(unsigned int start, int pages, int pagesize);
+void pagecache_destroy(pagecache_t *pc);
+unsigned long long pagecache_hash(unsigned long long hash, const unsigned char *data, int len);
+void pagecache_clear(pagecache_t *pc);
+int pagecache_set(pagecache_t *pc, int page, const unsigned char *data);
+int pagecache_same(const pagecache_t *pc, int page, const unsigned char *data);
+int pagecache_load(pagecache_t *pc, const char *path);
+int pagecache_save(const pagecache_t *pc, const char *path);
+
+#endif
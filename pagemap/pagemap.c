@@ -0,0 +1,173 @@
+/*
+    Page map of a NVM block image
+
+    The segments of a hex file are merged into page-aligned pages, in address order, so an image is
+    programmed with one page command for each page it touches, whatever the layout of its segments
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "pagemap.h"
+
+/*
+    Create an empty page map of a NVM block
+    @start: block start address
+    @size: block size
+    @pagesize: page size
+    @return page map, NULL if failed
+*/
+pagemap_t *pagemap_create(unsigned int start, unsigned int size, int pagesize)
+{
+    pagemap_t *pm;
+
+    if (pagesize <= 0 || !size)
+        return NULL;
+
+    pm = (pagemap_t *)malloc(sizeof(*pm));
+    if (!pm)
+        return NULL;
+
+    pm->start = start;
+    pm->size = size;
+    pm->pagesize = pagesize;
+    pm->pages = (int)((size + pagesize - 1) / pagesize);
+    pm->data = (unsigned char *)malloc((size_t)pm->pages * pagesize);
+    pm->mask = (unsigned char *)calloc((size_t)pm->pages, pagesize);
+    pm->used = (unsigned short *)calloc((size_t)pm->pages, sizeof(*pm->used));
+    if (!pm->data || !pm->mask || !pm->used) {
+        pagemap_destroy(pm);
+        return NULL;
+    }
+
+    memset(pm->data, PAGEMAP_PAD, (size_t)pm->pages * pagesize);
+
+    return pm;
+}
+
+/*
+    Destroy the page map
+    @pm: page map, acquired from pagemap_create()
+*/
+void pagemap_destroy(pagemap_t *pm)
+{
+    if (!pm)
+        return;
+
+    free(pm->data);
+    free(pm->mask);
+    free(pm->used);
+    free(pm);
+}
+
+/*
+    Add data to the page map, the later data overwrites the earlier one at the same address
+    @pm: page map
+    @address: data address, must be in the block
+    @data: data buffer
+    @len: data length
+    @return 0 successful, other value if out of the block
+*/
+int pagemap_add(pagemap_t *pm, unsigned int address, const unsigned char *data, int len)
+{
+    unsigned int off;
+    int i;
+
+    if (!pm || !data || len < 0)
+        return -1;
+
+    if (address < pm->start || address - pm->start + len > pm->size)
+        return -2;
+
+    off = address - pm->start;
+    for (i = 0; i < len; i++, off++) {
+        if (!pm->mask[off]) {
+            pm->mask[off] = 1;
+            pm->used[off / pm->pagesize]++;
+        }
+        pm->data[off] = data[i];
+    }
+
+    return 0;
+}
+
+/*
+    Get the next page with data
+    @pm: page map
+    @page: page index to search from
+    @return page index, -1 if no more
+*/
+int pagemap_next(const pagemap_t *pm, int page)
+{
+    for (; page < pm->pages; page++) {
+        if (pm->used[page])
+            return page;
+    }
+
+    return -1;
+}
+
+/*
+    Number of bytes set by the image in the page
+*/
+int pagemap_page_used(const pagemap_t *pm, int page)
+{
+    return pm->used[page];
+}
+
+/*
+    Whether the page is fully set by the image, without padding
+*/
+int pagemap_page_full(const pagemap_t *pm, int page)
+{
+    return pm->used[page] == pm->pagesize;
+}
+
+/*
+    Whether the page data is all PAGEMAP_PAD, the content of an erased page
+*/
+int pagemap_page_blank(const pagemap_t *pm, int page)
+{
+    const unsigned char *data = pagemap_page_data(pm, page);
+
+    // Each byte equals the next one, compared by the vectorized memcmp()
+    return data[0] == PAGEMAP_PAD && !memcmp(data, data + 1, pm->pagesize - 1);
+}
+
+/*
+    Start address of the page
+*/
+unsigned int pagemap_page_address(const pagemap_t *pm, int page)
+{
+    return pm->start + (unsigned int)page * pm->pagesize;
+}
+
+/*
+    Data of the page, pagesize bytes
+*/
+unsigned char *pagemap_page_data(const pagemap_t *pm, int page)
+{
+    return pm->data + (size_t)page * pm->pagesize;
+}
+
+/*
+    Fill the padding of the page with the current content of the NVM, for read-modify-write of a page not erased
+    @pm: page map
+    @page: page index
+    @data: current page content, pagesize bytes
+    @return number of bytes merged
+*/
+int pagemap_merge(pagemap_t *pm, int page, const unsigned char *data)
+{
+    unsigned char *dst = pagemap_page_data(pm, page);
+    const unsigned char *mask = pm->mask + (size_t)page * pm->pagesize;
+    int i, n = 0;
+
+    for (i = 0; i < pm->pagesize; i++) {
+        if (!mask[i]) {
+            dst[i] = data[i];
+            n++;
+        }
+    }
+
+    return n;
+}
@@ -0,0 +1,38 @@
+#ifndef __PAGEMAP_H
+#define __PAGEMAP_H
+
+/*
+    Page map: an image of a NVM block split into page-aligned pages, for writing each page with one page command.
+    The bytes not set by the image are padded with PAGEMAP_PAD
+    @start: block start address
+    @size: block size
+    @pagesize: page size
+    @pages: number of pages of the block
+    @data: image, padded
+    @mask: non-zero for each byte set by the image
+    @used: number of bytes set by the image in each page
+*/
+typedef struct _pagemap {
+    unsigned int start;
+    unsigned int size;
+    int pagesize;
+    int pages;
+    unsigned char *data;
+    unsigned char *mask;
+    unsigned short *used;
+}pagemap_t;
+
+#define PAGEMAP_PAD 0xFF
+
+pagemap_t *pagemap_create(unsigned int start, unsigned int size, int pagesize);
+void pagemap_destroy(pagemap_t *pm);
+int pagemap_add(pagemap_t *pm, unsigned int address, const unsigned char *data, int len);
+int pagemap_next(const pagemap_t *pm, int page);
+int pagemap_page_used(const pagemap_t *pm, int page);
+int pagemap_page_full(const pagemap_t *pm, int page);
+int pagemap_page_blank(const pagemap_t *pm, int page);
+unsigned int pagemap_page_address(const pagemap_t *pm, int page);
+unsigned char *pagemap_page_data(const pagemap_t *pm, int page);
+int pagemap_merge(pagemap_t *pm, int page, const unsigned char *data);
+
+#endif
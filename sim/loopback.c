@@ -0,0 +1,188 @@
+/*
+    Loopback transport backend
+
+    The PHY layer is connected to an in-process simulated target ('loop:<device>'), the echo
+    and the responses are queued in memory, so the host side cost of the UPDI stack could be
+    profiled without any I/O.
+*/
+
+#include "os/platform.h"
+#include "device/device.h"
+#include "updi/transport.h"
+#include "target.h"
+#include "loopback.h"
+
+#define LOOPBACK_QUEUE_SIZE 4096
+#define LOOPBACK_BREAK_BAUDRATE 600
+
+/*
+    Loopback object
+    @mgwd: magicword
+    @tgt: simulated target
+    @baudrate: current baudrate, a zero frame at low baudrate is taken as BREAK
+    @queue/head/tail: echo and response waiting to be received by the host
+    @resp: response buffer of the target
+*/
+typedef struct _upd_loopback {
+#define UPD_LOOPBACK_MAGIC_WORD 0x8787 //'ulpb'
+    unsigned int mgwd;
+    void *tgt;
+    DWORD baudrate;
+    u8 queue[LOOPBACK_QUEUE_SIZE];
+    int head;
+    int tail;
+    u8 resp[SIM_MAX_RESPONSE_SIZE];
+}upd_loopback_t;
+
+#define VALID_LOOPBACK(_lb) ((_lb) && ((_lb)->mgwd == UPD_LOOPBACK_MAGIC_WORD))
+
+static void loopback_push(upd_loopback_t *lb, const u8 *data, int len)
+{
+    if (lb->head == lb->tail)
+        lb->head = lb->tail = 0;
+
+    len = min(len, LOOPBACK_QUEUE_SIZE - lb->tail);
+    memcpy(lb->queue + lb->tail, data, len);
+    lb->tail += len;
+}
+
+static void *loopback_open(const char *port, const SER_PORT_STATE_T *st)
+{
+    const device_info_t *dev;
+    upd_loopback_t *lb;
+
+    dev = get_chip_info(port);
+    if (!dev) {
+        DBG_INFO(PHY_DEBUG, "<TP> Loopback: device '%s' not support", port);
+        return NULL;
+    }
+
+    lb = (upd_loopback_t *)malloc(sizeof(*lb));
+    if (!lb)
+        return NULL;
+
+    memset(lb, 0, sizeof(*lb));
+    lb->tgt = sim_target_init(dev, 0);
+    if (!lb->tgt) {
+        free(lb);
+        return NULL;
+    }
+
+    lb->mgwd = UPD_LOOPBACK_MAGIC_WORD;
+    lb->baudrate = st->baudRate;
+
+    return lb;
+}
+
+static int loopback_set_state(void *handle, const SER_PORT_STATE_T *st)
+{
+    upd_loopback_t *lb = (upd_loopback_t *)handle;
+
+    if (!VALID_LOOPBACK(lb))
+        return ERROR_PTR;
+
+    lb->baudrate = st->baudRate;
+
+    return 0;
+}
+
+static int loopback_flush(void *handle)
+{
+    upd_loopback_t *lb = (upd_loopback_t *)handle;
+
+    if (!VALID_LOOPBACK(lb))
+        return ERROR_PTR;
+
+    lb->head = lb->tail = 0;
+
+    return 0;
+}
+
+static int loopback_send(void *handle, const u8 *data, int len)
+{
+    upd_loopback_t *lb = (upd_loopback_t *)handle;
+    int i, n;
+
+    if (!VALID_LOOPBACK(lb))
+        return ERROR_PTR;
+
+    for (i = 0; i < len; i++) {
+        //Local echo of the single wire
+        loopback_push(lb, &data[i], 1);
+
+        if (lb->baudrate <= LOOPBACK_BREAK_BAUDRATE) {
+            sim_target_break(lb->tgt);
+            continue;
+        }
+
+        n = sim_target_receive(lb->tgt, data[i], 0, lb->resp, sizeof(lb->resp));
+        if (n > 0)
+            loopback_push(lb, lb->resp, n);
+    }
+
+    return 0;
+}
+
+static int loopback_receive(void *handle, u8 *data, int len)
+{
+    upd_loopback_t *lb = (upd_loopback_t *)handle;
+    int n;
+
+    if (!VALID_LOOPBACK(lb))
+        return ERROR_PTR;
+
+    n = min(len, lb->tail - lb->head);
+    memcpy(data, lb->queue + lb->head, n);
+    lb->head += n;
+
+    return n;
+}
+
+static int loopback_send_break(void *handle, int count)
+{
+    upd_loopback_t *lb = (upd_loopback_t *)handle;
+
+    if (!VALID_LOOPBACK(lb))
+        return ERROR_PTR;
+
+    while (count--)
+        sim_target_break(lb->tgt);
+
+    return 0;
+}
+
+static DWORD loopback_get_baudrate(void *handle)
+{
+    upd_loopback_t *lb = (upd_loopback_t *)handle;
+
+    if (!VALID_LOOPBACK(lb))
+        return 0;
+
+    return lb->baudrate;
+}
+
+static void loopback_close(void *handle)
+{
+    upd_loopback_t *lb = (upd_loopback_t *)handle;
+
+    if (!VALID_LOOPBACK(lb))
+        return;
+
+    sim_target_deinit(lb->tgt);
+    lb->mgwd = 0;
+    free(lb);
+}
+
+const upd_transport_t transport_loopback = {
+    "loopback",
+    "loop:",
+    loopback_open,
+    loopback_set_state,
+    loopback_flush,
+    loopback_send,
+    loopback_receive,
+    loopback_send_break,
+    loopback_get_baudrate,
+    NULL,
+    loopback_close,
+};
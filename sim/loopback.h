@@ -0,0 +1,9 @@
+#ifndef __SIM_LOOPBACK_H
+#define __SIM_LOOPBACK_H
+
+/*
+    Loopback transport backend, 'loop:<device>', registered by the application with transport_register()
+*/
+extern const upd_transport_t transport_loopback;
+
+#endif
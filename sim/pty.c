@@ -0,0 +1,59 @@
+/*
+    Pseudo terminal helper of the simulator
+
+    The baudrate of the slave side (set by the host) is read from the master with TCGETS2,
+    so custom (BOTHER) baud rates are reported as the numeric value. A pty doesn't keep the
+    parity setting, the frame size is fixed by the caller.
+    This file doesn't include <termios.h>, it conflicts with <asm/termbits.h>.
+*/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h>
+
+/*
+    Get baudrate of the pty, set by the host on the slave side
+    @fd: pty master or slave fd
+    @return baudrate, 0 if failed
+*/
+unsigned int sim_pty_baudrate(int fd)
+{
+    struct termios2 tio;
+
+    if (ioctl(fd, TCGETS2, &tio) < 0)
+        return 0;
+
+    return tio.c_ospeed;
+}
+
+/*
+    Open a pty pair
+    @slave_name: output buffer of the slave path
+    @size: size of the buffer
+    @slave: output slave fd, kept open by the simulator so the master never sees a hangup
+    @return master fd, negative if failed
+*/
+int sim_pty_open(char *slave_name, int size, int *slave)
+{
+    int master;
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0)
+        return -1;
+
+    if (grantpt(master) || unlockpt(master) || ptsname_r(master, slave_name, size))
+        goto failed;
+
+    *slave = open(slave_name, O_RDWR | O_NOCTTY);
+    if (*slave < 0)
+        goto failed;
+
+    return master;
+
+failed:
+    close(master);
+    return -2;
+}
@@ -0,0 +1,7 @@
+#ifndef __SIM_PTY_H
+#define __SIM_PTY_H
+
+int sim_pty_open(char *slave_name, int size, int *slave);
+unsigned int sim_pty_baudrate(int fd);
+
+#endif
@@ -0,0 +1,1105 @@
+/*
+    UPDI target simulator
+
+    This emulates the UPDI interface of a tinyAVR 0/1 series device byte by byte, so the host
+    stack could be exercised without real silicon. The memory layout is taken from the device.c
+    tables, the instruction set and the NVMCTRL behaviour follow the tinyAVR 0/1 datasheet:
+
+        SYNC, LDS/STS, LD/ST with pointer (and pointer post-increment), REPEAT, LDCS/STCS,
+        KEY (NVMProg/NVMErase) and SIB, ACK response signature (and RSD), reset request,
+        NVMCTRL page buffer, page write/erase, chip erase, eeprom erase and fuse write,
+        CRCSCAN of the whole flash (also reported by ASI_CRC_STATUS).
+
+    The caller is responsible for the local echo of the single-wire bus and the UART timing,
+    the target only returns the bytes it drives on the bus for each received byte.
+*/
+
+#include "os/platform.h"
+#include "device/device.h"
+#include "updi/constants.h"
+#include "crc/crc.h"
+#include "target.h"
+
+/*
+    Decoder state
+*/
+enum { ST_IDLE, ST_OPCODE, ST_ARGS, ST_DATA, ST_KEY };
+
+/*
+    Memory regions in data space
+*/
+enum { REGION_RAM, REGION_FLASH, REGION_EEPROM, REGION_USERROW, REGION_FUSE, REGION_SIGROW, REGION_NVMCTRL, REGION_CRCSCAN };
+
+/*
+    NVM controller busy time of each command(us), typical values of tinyAVR 0/1 datasheet
+*/
+static const int nvm_command_time[] = {
+    0,      /* NOP */
+    2000,   /* WRITE_PAGE */
+    2000,   /* ERASE_PAGE */
+    4000,   /* ERASE_WRITE_PAGE */
+    0,      /* PAGE_BUFFER_CLR */
+    4000,   /* CHIP_ERASE */
+    4000,   /* ERASE_EEPROM */
+    4000,   /* WRITE_FUSE */
+};
+
+/*
+    NVMCTRL v2 busy time(us) of a flash word write, a flash page erase, an EEPROM byte erase-write
+    and a chip erase, typical values of AVR DA datasheet
+*/
+#define SIM_V2_FLASH_WRITE_TIME 70
+#define SIM_V2_PAGE_ERASE_TIME 10000
+#define SIM_V2_EEPROM_WRITE_TIME 11000
+#define SIM_V2_CHIP_ERASE_TIME 70000
+
+/*
+    CRCSCAN time(us) of the flash, about one byte each cycle at the default 3.33MHz clock
+*/
+#define SIM_CRCSCAN_TIME(_size) ((_size) * 3 / 10)
+
+#define SIM_SIGROW_SIZE 0x80
+#define SIM_CRCSCAN_SIZE 0x04
+#define SIM_NVMCTRL_SIZE 0x10
+#define SIM_RAM_SIZE 0x10000
+
+#define SIM_FUSE_LOCKBIT 10
+#define SIM_FUSE_LOCKBIT_UNLOCKED 0xC5
+#define SIM_FUSE_SYSCFG0 5
+#define SIM_FUSE_SYSCFG0_EESAVE 0
+
+/*
+    TARGET level memory struct
+    @mgwd: magicword
+    @dev: point chip dev object
+    @flags: SIM_FLAG_xxx
+    @now: time of the byte being processed(us)
+    @flash/eeprom/userrow/fuse/sigrow/ram: memories
+    @pbuf/pmask/paddr/pregion: NVM page buffer, loaded byte mask, last loaded address and region
+    @nvmreg: NVMCTRL registers
+    @busy_until: NVM busy end time
+    @crcreg/crc_until: CRCSCAN registers and scan end time
+    @cs: UPDI control and status registers
+    @key_status: ASI_KEY_STATUS
+    @progmode/locked/in_reset/disabled: ASI status
+    @state/opcode/arg/nargs/got: instruction decoder
+    @repeat/units: repeat counter and remaining transfer units for ST
+    @ptr: UPDI pointer register
+    @key/keylen: key receiving buffer
+*/
+typedef struct _upd_target {
+#define UPD_TARGET_MAGIC_WORD 0xF0F0 //'utgt'
+    unsigned int mgwd;
+    const device_info_t *dev;
+    int flags;
+    unsigned long long now;
+
+    u8 *flash;
+    u8 *eeprom;
+    u8 *userrow;
+    u8 *fuse;
+    u8 sigrow[SIM_SIGROW_SIZE];
+    u8 *ram;
+
+    u8 *pbuf;
+    u8 *pmask;
+    u32 paddr;
+    int pregion;
+
+    u8 nvmreg[SIM_NVMCTRL_SIZE];
+    unsigned long long busy_until;
+
+    u8 crcreg[SIM_CRCSCAN_SIZE];
+    unsigned long long crc_until;
+
+    u8 cs[16];
+    u8 key_status;
+    bool progmode;
+    bool locked;
+    bool in_reset;
+    bool disabled;
+
+    int state;
+    u8 opcode;
+    u8 arg[4];
+    int nargs;
+    int got;
+    int repeat;
+    int units;
+    u32 ptr;
+
+    u8 key[32];
+    int keylen;
+}upd_target_t;
+
+#define VALID_TARGET(_tgt) ((_tgt) && ((_tgt)->mgwd == UPD_TARGET_MAGIC_WORD))
+#define TGT_MAP(_tgt) ((_tgt)->dev->mmap)
+
+/*
+    Device signature, by device name
+*/
+static const struct {
+    const char *name;
+    u8 id[3];
+} sim_signatures[] = {
+    { "tiny3216",{ 0x1E, 0x95, 0x21 } },
+    { "tiny3217",{ 0x1E, 0x95, 0x22 } },
+    { "tiny1616",{ 0x1E, 0x94, 0x21 } },
+    { "tiny1617",{ 0x1E, 0x94, 0x20 } },
+    { "tiny814",{ 0x1E, 0x93, 0x22 } },
+    { "tiny816",{ 0x1E, 0x93, 0x21 } },
+    { "tiny817",{ 0x1E, 0x93, 0x20 } },
+    { "tiny417",{ 0x1E, 0x92, 0x20 } },
+    { "avr128da28",{ 0x1E, 0x97, 0x0A } },
+    { "avr128da32",{ 0x1E, 0x97, 0x09 } },
+    { "avr128da48",{ 0x1E, 0x97, 0x08 } },
+    { "avr128da64",{ 0x1E, 0x97, 0x07 } },
+    { "avr128db28",{ 0x1E, 0x97, 0x0E } },
+    { "avr128db32",{ 0x1E, 0x97, 0x0D } },
+    { "avr128db48",{ 0x1E, 0x97, 0x0C } },
+    { "avr128db64",{ 0x1E, 0x97, 0x0B } },
+    { "avr64da28",{ 0x1E, 0x96, 0x15 } },
+    { "avr64da32",{ 0x1E, 0x96, 0x14 } },
+    { "avr64da48",{ 0x1E, 0x96, 0x13 } },
+    { "avr64da64",{ 0x1E, 0x96, 0x12 } },
+    { "avr64db28",{ 0x1E, 0x96, 0x19 } },
+    { "avr64db32",{ 0x1E, 0x96, 0x18 } },
+    { "avr64db48",{ 0x1E, 0x96, 0x17 } },
+    { "avr64db64",{ 0x1E, 0x96, 0x16 } },
+    { "avr32da28",{ 0x1E, 0x95, 0x34 } },
+    { "avr32da32",{ 0x1E, 0x95, 0x33 } },
+    { "avr32da48",{ 0x1E, 0x95, 0x32 } },
+    { "avr32db28",{ 0x1E, 0x95, 0x37 } },
+    { "avr32db32",{ 0x1E, 0x95, 0x36 } },
+    { "avr32db48",{ 0x1E, 0x95, 0x35 } },
+};
+
+static const char sim_sib[] = "tinyAVR P:0D:1-3M2 (01.59B14.0)";
+static const char sim_sib_v2[] = "    AVR P:2D:1-3M2 (A3.KV00S.0)";
+
+#define SIM_NVM_V2(_tgt) (!!(TGT_MAP(_tgt)->flags & DEV_FLAG_NVMCTRL_V2))
+
+static void _sim_reset_cs(upd_target_t *tgt);
+
+/*
+    TARGET object init
+    @dev: point chip dev object(device_info_t)
+    @flags: SIM_FLAG_xxx
+    @return TARGET ptr, NULL if failed
+*/
+void *sim_target_init(const void *dev_ptr, int flags)
+{
+    const device_info_t *dev = (const device_info_t *)dev_ptr;
+    upd_target_t *tgt;
+    const chip_info_t *map;
+    int i;
+
+    if (!dev)
+        return NULL;
+
+    map = dev->mmap;
+
+    tgt = (upd_target_t *)malloc(sizeof(*tgt));
+    if (!tgt)
+        return NULL;
+
+    memset(tgt, 0, sizeof(*tgt));
+    tgt->mgwd = UPD_TARGET_MAGIC_WORD;
+    tgt->dev = dev;
+    tgt->flags = flags;
+
+    tgt->flash = malloc(map->flash.nvm_size);
+    tgt->eeprom = malloc(map->eeprom.nvm_size);
+    tgt->userrow = malloc(map->userrow.nvm_size);
+    tgt->fuse = malloc(map->fuse.nvm_size);
+    tgt->ram = malloc(SIM_RAM_SIZE);
+    tgt->pbuf = malloc(map->flash.nvm_pagesize);
+    tgt->pmask = malloc(map->flash.nvm_pagesize);
+    if (!tgt->flash || !tgt->eeprom || !tgt->userrow || !tgt->fuse || !tgt->ram || !tgt->pbuf || !tgt->pmask) {
+        sim_target_deinit(tgt);
+        return NULL;
+    }
+
+    memset(tgt->flash, 0xFF, map->flash.nvm_size);
+    memset(tgt->eeprom, 0xFF, map->eeprom.nvm_size);
+    memset(tgt->userrow, 0xFF, map->userrow.nvm_size);
+    memset(tgt->fuse, 0x00, map->fuse.nvm_size);
+    memset(tgt->ram, 0x00, SIM_RAM_SIZE);
+    memset(tgt->pbuf, 0xFF, map->flash.nvm_pagesize);
+    memset(tgt->pmask, 0, map->flash.nvm_pagesize);
+
+    //Signature and a fixed serial number
+    memset(tgt->sigrow, 0xFF, sizeof(tgt->sigrow));
+    for (i = 0; i < ARRAY_SIZE(sim_signatures); i++) {
+        if (!strcmp(sim_signatures[i].name, dev->name)) {
+            memcpy(tgt->sigrow, sim_signatures[i].id, sizeof(sim_signatures[i].id));
+            break;
+        }
+    }
+    if (SIM_NVM_V2(tgt)) {
+        for (i = 0; i < 16; i++)
+            tgt->sigrow[0x10 + i] = (u8)(0x30 + i);
+    }
+    else {
+        for (i = 0; i < 10; i++)
+            tgt->sigrow[3 + i] = (u8)(0x30 + i);
+    }
+
+    if (map->fuse.nvm_size > SIM_FUSE_LOCKBIT) {
+        tgt->fuse[SIM_FUSE_LOCKBIT] = (flags & SIM_FLAG_LOCKED) ? 0x00 : SIM_FUSE_LOCKBIT_UNLOCKED;
+    }
+    tgt->locked = !!(flags & SIM_FLAG_LOCKED);
+
+    _sim_reset_cs(tgt);
+    tgt->state = ST_IDLE;
+
+    return tgt;
+}
+
+/*
+    TARGET object destroy
+    @tgt_ptr: TARGET object pointer, acquired from sim_target_init()
+*/
+void sim_target_deinit(void *tgt_ptr)
+{
+    upd_target_t *tgt = (upd_target_t *)tgt_ptr;
+
+    if (!VALID_TARGET(tgt))
+        return;
+
+    if (tgt->flash)
+        free(tgt->flash);
+    if (tgt->eeprom)
+        free(tgt->eeprom);
+    if (tgt->userrow)
+        free(tgt->userrow);
+    if (tgt->fuse)
+        free(tgt->fuse);
+    if (tgt->ram)
+        free(tgt->ram);
+    if (tgt->pbuf)
+        free(tgt->pbuf);
+    if (tgt->pmask)
+        free(tgt->pmask);
+
+    tgt->mgwd = 0;
+    free(tgt);
+}
+
+/*
+    Reset UPDI physical layer configuration (CTRLA/CTRLB) and the decoder
+*/
+static void _sim_reset_cs(upd_target_t *tgt)
+{
+    tgt->cs[UPDI_CS_STATUSA] = 0x10;    //UPDI revision 1
+    tgt->cs[UPDI_CS_STATUSB] = 0;
+    tgt->cs[UPDI_CS_CTRLA] = 0;
+    tgt->cs[UPDI_CS_CTRLB] = 0;
+    if (!tgt->cs[UPDI_ASI_CTRLA])
+        tgt->cs[UPDI_ASI_CTRLA] = UPDI_ASI_CTRLA_CLKSEL_4M;
+
+    tgt->repeat = 0;
+    tgt->state = ST_IDLE;
+}
+
+/*
+    TARGET received a BREAK condition: the decoder is reset, and a disabled UPDI is re-enabled
+    @tgt_ptr: TARGET object pointer, acquired from sim_target_init()
+*/
+void sim_target_break(void *tgt_ptr)
+{
+    upd_target_t *tgt = (upd_target_t *)tgt_ptr;
+
+    if (!VALID_TARGET(tgt))
+        return;
+
+    if (tgt->disabled) {
+        tgt->disabled = false;
+        tgt->key_status = 0;
+        tgt->progmode = false;
+        tgt->cs[UPDI_ASI_CTRLA] = UPDI_ASI_CTRLA_CLKSEL_4M;
+    }
+
+    _sim_reset_cs(tgt);
+}
+
+/*
+    TARGET guard time inserted before each response
+    @tgt_ptr: TARGET object pointer, acquired from sim_target_init()
+    @return guard time in UPDI bit periods
+*/
+int sim_target_guard_bits(void *tgt_ptr)
+{
+    upd_target_t *tgt = (upd_target_t *)tgt_ptr;
+    int gtval;
+
+    if (!VALID_TARGET(tgt))
+        return 0;
+
+    gtval = tgt->cs[UPDI_CS_CTRLA] & 0x7;
+    if (gtval == 7)
+        gtval = 6;
+
+    return 128 >> gtval;
+}
+
+/*
+    TARGET whether the decoder is waiting for a SYNC
+    @tgt_ptr: TARGET object pointer, acquired from sim_target_init()
+*/
+bool sim_target_idle(void *tgt_ptr)
+{
+    upd_target_t *tgt = (upd_target_t *)tgt_ptr;
+
+    return VALID_TARGET(tgt) && tgt->state == ST_IDLE;
+}
+
+/*
+    Get memory region of a data space address
+    @off: output offset in the region
+    @return REGION_xxx
+*/
+static int _sim_region(upd_target_t *tgt, u32 address, u32 *off)
+{
+    const chip_info_t *map = TGT_MAP(tgt);
+    const struct {
+        int region;
+        u32 start;
+        u32 size;
+    } regions[] = {
+        { REGION_FLASH, map->flash.nvm_start, map->flash.nvm_size },
+        { REGION_EEPROM, map->eeprom.nvm_start, map->eeprom.nvm_size },
+        { REGION_USERROW, map->userrow.nvm_start, map->userrow.nvm_size },
+        { REGION_FUSE, map->fuse.nvm_start, map->fuse.nvm_size },
+        { REGION_SIGROW, map->reg.sigrow_address, SIM_SIGROW_SIZE },
+        { REGION_NVMCTRL, map->reg.nvmctrl_address, SIM_NVMCTRL_SIZE },
+        { REGION_CRCSCAN, map->reg.crcscan_address, SIM_CRCSCAN_SIZE },
+    };
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(regions); i++) {
+        if (address >= regions[i].start && address < regions[i].start + regions[i].size) {
+            *off = address - regions[i].start;
+            return regions[i].region;
+        }
+    }
+
+    *off = address;
+    return REGION_RAM;
+}
+
+/*
+    Get NVM memory buffer of a region
+*/
+static u8 *_sim_region_mem(upd_target_t *tgt, int region, u32 *size, u32 *pagesize)
+{
+    const chip_info_t *map = TGT_MAP(tgt);
+
+    switch (region) {
+    case REGION_FLASH:
+        *size = map->flash.nvm_size;
+        *pagesize = map->flash.nvm_pagesize;
+        return tgt->flash;
+    case REGION_EEPROM:
+        *size = map->eeprom.nvm_size;
+        *pagesize = map->eeprom.nvm_pagesize;
+        return tgt->eeprom;
+    case REGION_USERROW:
+        *size = map->userrow.nvm_size;
+        *pagesize = map->userrow.nvm_pagesize;
+        return tgt->userrow;
+    default:
+        return NULL;
+    }
+}
+
+/*
+    NVM controller status register
+*/
+static u8 _sim_nvm_status(upd_target_t *tgt)
+{
+    u8 status = tgt->nvmreg[UPDI_NVMCTRL_STATUS] & (SIM_NVM_V2(tgt) ? UPDI_V2_NVM_STATUS_ERROR_MASK : (1 << UPDI_NVM_STATUS_WRITE_ERROR));
+
+    if (tgt->now < tgt->busy_until)
+        status |= (1 << UPDI_NVM_STATUS_FLASH_BUSY) | (1 << UPDI_NVM_STATUS_EEPROM_BUSY);
+
+    return status;
+}
+
+/*
+    CRCSCAN STATUS register
+*/
+static u8 _sim_crcscan_status(upd_target_t *tgt)
+{
+    if (tgt->now < tgt->crc_until)
+        return (1 << UPDI_CRCSCAN_STATUS_BUSY);
+
+    return tgt->crcreg[UPDI_CRCSCAN_STATUS];
+}
+
+/*
+    CRCSCAN CTRLA write: reset clears the registers, enable scans the whole flash, the CRC-16 residue
+    of the flash with its checksum in the last 2 bytes is zero
+*/
+static void _sim_crcscan_ctrla(upd_target_t *tgt, u8 val)
+{
+    const chip_info_t *map = TGT_MAP(tgt);
+
+    if (val & (1 << UPDI_CRCSCAN_CTRLA_RESET)) {
+        memset(tgt->crcreg, 0, sizeof(tgt->crcreg));
+        tgt->crc_until = 0;
+        return;
+    }
+
+    tgt->crcreg[UPDI_CRCSCAN_CTRLA] = val;
+    if (!(val & (1 << UPDI_CRCSCAN_CTRLA_ENABLE)) || tgt->crcreg[UPDI_CRCSCAN_CTRLB] != UPDI_CRCSCAN_CTRLB_SRC_FLASH)
+        return;
+
+    tgt->crcreg[UPDI_CRCSCAN_STATUS] = calc_crc16(tgt->flash, map->flash.nvm_size) ? 0 : (1 << UPDI_CRCSCAN_STATUS_OK);
+    if (tgt->flags & SIM_FLAG_TIMING)
+        tgt->crc_until = tgt->now + SIM_CRCSCAN_TIME(map->flash.nvm_size);
+}
+
+/*
+    Clear NVM page buffer
+*/
+static void _sim_page_buffer_clear(upd_target_t *tgt)
+{
+    int pagesize = TGT_MAP(tgt)->flash.nvm_pagesize;
+
+    memset(tgt->pbuf, 0xFF, pagesize);
+    memset(tgt->pmask, 0, pagesize);
+    tgt->pregion = REGION_RAM;
+}
+
+/*
+    Commit NVM page buffer to the page last loaded
+    @erase: erase page before write
+    @write: write page buffer
+*/
+static void _sim_page_commit(upd_target_t *tgt, bool erase, bool write)
+{
+    u32 size, pagesize, off, base;
+    u8 *mem;
+    int i;
+
+    mem = _sim_region_mem(tgt, tgt->pregion, &size, &pagesize);
+    if (!mem)
+        return;
+
+    _sim_region(tgt, tgt->paddr, &off);
+    base = off - (off % pagesize);
+
+    for (i = 0; i < (int)pagesize && base + i < size; i++) {
+        /* EEPROM and user row are erased/written by byte, only loaded bytes are affected */
+        if (tgt->pregion != REGION_FLASH && !tgt->pmask[i])
+            continue;
+
+        if (erase)
+            mem[base + i] = 0xFF;
+
+        if (write)
+            mem[base + i] &= tgt->pbuf[i];
+    }
+
+    DBG_INFO(NVM_DEBUG, "<SIM> Page %s%s of region %d at %x", erase ? "erase" : "", write ? "write" : "", tgt->pregion, base);
+
+    _sim_page_buffer_clear(tgt);
+}
+
+/*
+    Set NVM controller v2 command, kept in CTRLA until the next command; only the chip erase
+        is executed at once, the write commands act on the following data writes
+*/
+static void _sim_nvm_command_v2(upd_target_t *tgt, u8 command)
+{
+    const chip_info_t *map = TGT_MAP(tgt);
+
+    if (_sim_nvm_status(tgt) & ((1 << UPDI_NVM_STATUS_FLASH_BUSY) | (1 << UPDI_NVM_STATUS_EEPROM_BUSY))) {
+        //Command issued while busy is not accepted
+        tgt->nvmreg[UPDI_NVMCTRL_STATUS] |= UPDI_V2_NVM_STATUS_ERROR_MASK & (1 << 4);
+        return;
+    }
+
+    tgt->nvmreg[UPDI_NVMCTRL_STATUS] &= ~UPDI_V2_NVM_STATUS_ERROR_MASK;
+    tgt->nvmreg[UPDI_NVMCTRL_CTRLA] = command;
+
+    if (command == UPDI_V2_NVMCTRL_CTRLA_CHIP_ERASE) {
+        memset(tgt->flash, 0xFF, map->flash.nvm_size);
+        if (!(map->fuse.nvm_size > SIM_FUSE_SYSCFG0 && (tgt->fuse[SIM_FUSE_SYSCFG0] & (1 << SIM_FUSE_SYSCFG0_EESAVE))))
+            memset(tgt->eeprom, 0xFF, map->eeprom.nvm_size);
+        if (tgt->flags & SIM_FLAG_TIMING)
+            tgt->busy_until = tgt->now + SIM_V2_CHIP_ERASE_TIME;
+    }
+}
+
+/*
+    Write one byte to a NVM region with the NVM controller v2, by the command set in CTRLA
+*/
+static void _sim_nvm_write_v2(upd_target_t *tgt, int region, u32 off, u8 val)
+{
+    u32 size, pagesize, base;
+    u8 *mem;
+    int busy = 0;
+
+    switch (region) {
+    case REGION_FLASH:
+        mem = tgt->flash;
+        break;
+    case REGION_EEPROM:
+        mem = tgt->eeprom;
+        break;
+    case REGION_USERROW:
+        mem = tgt->userrow;
+        break;
+    case REGION_FUSE:
+        mem = tgt->fuse;
+        break;
+    default:
+        return;
+    }
+
+    switch (tgt->nvmreg[UPDI_NVMCTRL_CTRLA]) {
+    case UPDI_V2_NVMCTRL_CTRLA_FLASH_WRITE:
+        if (region != REGION_FLASH)
+            return;
+        mem[off] &= val;
+        busy = SIM_V2_FLASH_WRITE_TIME;
+        break;
+    case UPDI_V2_NVMCTRL_CTRLA_FLASH_PAGE_ERASE:
+        if (region != REGION_FLASH)
+            return;
+        _sim_region_mem(tgt, region, &size, &pagesize);
+        base = off - (off % pagesize);
+        memset(mem + base, 0xFF, pagesize);
+        busy = SIM_V2_PAGE_ERASE_TIME;
+        DBG_INFO(NVM_DEBUG, "<SIM> Flash page erase at %x", base);
+        break;
+    case UPDI_V2_NVMCTRL_CTRLA_EEPROM_ERASE_WRITE:
+        if (region == REGION_FLASH)
+            return;
+        mem[off] = val;
+        busy = SIM_V2_EEPROM_WRITE_TIME;
+        DBG_INFO(NVM_DEBUG, "<SIM> Erase/write cycle of region %d at %x", region, off);
+        break;
+    default:
+        //Write without a valid command
+        tgt->nvmreg[UPDI_NVMCTRL_STATUS] |= UPDI_V2_NVM_STATUS_ERROR_MASK & (2 << 4);
+        return;
+    }
+
+    if (tgt->flags & SIM_FLAG_TIMING)
+        tgt->busy_until = tgt->now + busy;
+}
+
+/*
+    Execute NVM controller command
+*/
+static void _sim_nvm_command(upd_target_t *tgt, u8 command)
+{
+    const chip_info_t *map = TGT_MAP(tgt);
+    u32 address;
+
+    if (tgt->locked)
+        return;
+
+    if (SIM_NVM_V2(tgt)) {
+        _sim_nvm_command_v2(tgt, command);
+        return;
+    }
+
+    if (_sim_nvm_status(tgt) & ((1 << UPDI_NVM_STATUS_FLASH_BUSY) | (1 << UPDI_NVM_STATUS_EEPROM_BUSY))) {
+        //Command issued while busy is not accepted
+        tgt->nvmreg[UPDI_NVMCTRL_STATUS] |= (1 << UPDI_NVM_STATUS_WRITE_ERROR);
+        return;
+    }
+
+    tgt->nvmreg[UPDI_NVMCTRL_STATUS] &= ~(1 << UPDI_NVM_STATUS_WRITE_ERROR);
+
+    switch (command) {
+    case UPDI_NVMCTRL_CTRLA_WRITE_PAGE:
+        _sim_page_commit(tgt, false, true);
+        break;
+    case UPDI_NVMCTRL_CTRLA_ERASE_PAGE:
+        _sim_page_commit(tgt, true, false);
+        break;
+    case UPDI_NVMCTRL_CTRLA_ERASE_WRITE_PAGE:
+        _sim_page_commit(tgt, true, true);
+        break;
+    case UPDI_NVMCTRL_CTRLA_PAGE_BUFFER_CLR:
+        _sim_page_buffer_clear(tgt);
+        break;
+    case UPDI_NVMCTRL_CTRLA_CHIP_ERASE:
+        memset(tgt->flash, 0xFF, map->flash.nvm_size);
+        if (!(map->fuse.nvm_size > SIM_FUSE_SYSCFG0 && (tgt->fuse[SIM_FUSE_SYSCFG0] & (1 << SIM_FUSE_SYSCFG0_EESAVE))))
+            memset(tgt->eeprom, 0xFF, map->eeprom.nvm_size);
+        break;
+    case UPDI_NVMCTRL_CTRLA_ERASE_EEPROM:
+        memset(tgt->eeprom, 0xFF, map->eeprom.nvm_size);
+        break;
+    case UPDI_NVMCTRL_CTRLA_WRITE_FUSE:
+        address = tgt->nvmreg[UPDI_NVMCTRL_ADDRL] | (tgt->nvmreg[UPDI_NVMCTRL_ADDRH] << 8);
+        if (address >= map->fuse.nvm_start && address < map->fuse.nvm_start + map->fuse.nvm_size)
+            tgt->fuse[address - map->fuse.nvm_start] = tgt->nvmreg[UPDI_NVMCTRL_DATAL];
+        break;
+    default:
+        break;
+    }
+
+    if ((tgt->flags & SIM_FLAG_TIMING) && command < ARRAY_SIZE(nvm_command_time))
+        tgt->busy_until = tgt->now + nvm_command_time[command];
+}
+
+/*
+    Read one byte from data space
+*/
+static u8 _sim_read(upd_target_t *tgt, u32 address)
+{
+    u32 off;
+    int region;
+
+    region = _sim_region(tgt, address, &off);
+
+    //Locked device: only the UPDI CS space is accessible
+    if (tgt->locked)
+        return 0;
+
+    switch (region) {
+    case REGION_FLASH:
+        return tgt->flash[off];
+    case REGION_EEPROM:
+        return tgt->eeprom[off];
+    case REGION_USERROW:
+        return tgt->userrow[off];
+    case REGION_FUSE:
+        return tgt->fuse[off];
+    case REGION_SIGROW:
+        return tgt->sigrow[off];
+    case REGION_NVMCTRL:
+        if (off == UPDI_NVMCTRL_STATUS)
+            return _sim_nvm_status(tgt);
+        return tgt->nvmreg[off];
+    case REGION_CRCSCAN:
+        if (off == UPDI_CRCSCAN_STATUS)
+            return _sim_crcscan_status(tgt);
+        return tgt->crcreg[off];
+    default:
+        if (off < SIM_RAM_SIZE)
+            return tgt->ram[off];
+        return 0xFF;
+    }
+}
+
+/*
+    Write one byte to data space
+*/
+static void _sim_write(upd_target_t *tgt, u32 address, u8 val)
+{
+    u32 off, size, pagesize;
+    int region;
+
+    if (tgt->locked)
+        return;
+
+    region = _sim_region(tgt, address, &off);
+    if (SIM_NVM_V2(tgt) && region >= REGION_FLASH && region <= REGION_FUSE) {
+        _sim_nvm_write_v2(tgt, region, off, val);
+        return;
+    }
+
+    switch (region) {
+    case REGION_FLASH:
+    case REGION_EEPROM:
+    case REGION_USERROW:
+        //Load page buffer
+        _sim_region_mem(tgt, region, &size, &pagesize);
+        tgt->pbuf[off % pagesize] &= val;
+        tgt->pmask[off % pagesize] = 1;
+        tgt->paddr = address;
+        tgt->pregion = region;
+        tgt->nvmreg[UPDI_NVMCTRL_ADDRL] = address & 0xFF;
+        tgt->nvmreg[UPDI_NVMCTRL_ADDRH] = (address >> 8) & 0xFF;
+        break;
+    case REGION_NVMCTRL:
+        if (off == UPDI_NVMCTRL_CTRLA)
+            _sim_nvm_command(tgt, val);
+        else if (off != UPDI_NVMCTRL_STATUS)
+            tgt->nvmreg[off] = val;
+        break;
+    case REGION_CRCSCAN:
+        if (off == UPDI_CRCSCAN_CTRLA)
+            _sim_crcscan_ctrla(tgt, val);
+        else if (off == UPDI_CRCSCAN_CTRLB)
+            tgt->crcreg[off] = val;
+        break;
+    case REGION_FUSE:
+    case REGION_SIGROW:
+        break;
+    default:
+        if (off < SIM_RAM_SIZE)
+            tgt->ram[off] = val;
+        break;
+    }
+}
+
+/*
+    Apply a system reset with the keys received
+*/
+static void _sim_system_reset(upd_target_t *tgt)
+{
+    const chip_info_t *map = TGT_MAP(tgt);
+
+    if (tgt->key_status & (1 << UPDI_ASI_KEY_STATUS_CHIPERASE)) {
+        memset(tgt->flash, 0xFF, map->flash.nvm_size);
+        if (!(map->fuse.nvm_size > SIM_FUSE_SYSCFG0 && (tgt->fuse[SIM_FUSE_SYSCFG0] & (1 << SIM_FUSE_SYSCFG0_EESAVE))))
+            memset(tgt->eeprom, 0xFF, map->eeprom.nvm_size);
+        if (map->fuse.nvm_size > SIM_FUSE_LOCKBIT)
+            tgt->fuse[SIM_FUSE_LOCKBIT] = SIM_FUSE_LOCKBIT_UNLOCKED;
+        tgt->locked = false;
+        tgt->key_status &= ~(1 << UPDI_ASI_KEY_STATUS_CHIPERASE);
+    }
+    else if (map->fuse.nvm_size > SIM_FUSE_LOCKBIT) {
+        tgt->locked = tgt->fuse[SIM_FUSE_LOCKBIT] != SIM_FUSE_LOCKBIT_UNLOCKED;
+    }
+
+    if (tgt->key_status & (1 << UPDI_ASI_KEY_STATUS_NVMPROG)) {
+        tgt->progmode = !tgt->locked;
+        tgt->key_status &= ~(1 << UPDI_ASI_KEY_STATUS_NVMPROG);
+    }
+    else {
+        tgt->progmode = false;
+    }
+
+    _sim_page_buffer_clear(tgt);
+    tgt->busy_until = 0;
+    memset(tgt->crcreg, 0, sizeof(tgt->crcreg));
+    tgt->crc_until = 0;
+}
+
+/*
+    Load control/status register
+*/
+static u8 _sim_ldcs(upd_target_t *tgt, u8 address)
+{
+    u8 val;
+
+    switch (address) {
+    case UPDI_ASI_KEY_STATUS:
+        return tgt->key_status;
+    case UPDI_ASI_SYS_STATUS:
+        val = 0;
+        if (tgt->locked)
+            val |= (1 << UPDI_ASI_SYS_STATUS_LOCKSTATUS);
+        if (tgt->progmode)
+            val |= (1 << UPDI_ASI_SYS_STATUS_NVMPROG);
+        if (tgt->in_reset)
+            val |= (1 << UPDI_ASI_SYS_STATUS_RSTSYS);
+        return val;
+    case UPDI_ASI_CRC_STATUS:
+        if (!(tgt->crcreg[UPDI_CRCSCAN_CTRLA] & (1 << UPDI_CRCSCAN_CTRLA_ENABLE)))
+            return UPDI_ASI_CRC_STATUS_NOT_ENABLED;
+        val = _sim_crcscan_status(tgt);
+        if (val & (1 << UPDI_CRCSCAN_STATUS_BUSY))
+            return UPDI_ASI_CRC_STATUS_BUSY;
+        return (val & (1 << UPDI_CRCSCAN_STATUS_OK)) ? UPDI_ASI_CRC_STATUS_OK : UPDI_ASI_CRC_STATUS_FAILED;
+    default:
+        return tgt->cs[address & 0xF];
+    }
+}
+
+/*
+    Store control/status register
+*/
+static void _sim_stcs(upd_target_t *tgt, u8 address, u8 val)
+{
+    switch (address) {
+    case UPDI_ASI_RESET_REQ:
+        if (val == UPDI_RESET_REQ_VALUE) {
+            tgt->in_reset = true;
+            _sim_system_reset(tgt);
+        }
+        else {
+            tgt->in_reset = false;
+        }
+        break;
+    case UPDI_CS_CTRLB:
+        tgt->cs[address] = val;
+        if (val & (1 << UPDI_CTRLB_UPDIDIS_BIT))
+            tgt->disabled = true;
+        break;
+    case UPDI_CS_STATUSA:
+    case UPDI_CS_STATUSB:
+    case UPDI_ASI_KEY_STATUS:
+    case UPDI_ASI_SYS_STATUS:
+        break;
+    default:
+        tgt->cs[address & 0xF] = val;
+        break;
+    }
+}
+
+/*
+    Check a received key (the key is sent LSB first, which is the string reversed)
+*/
+static void _sim_key(upd_target_t *tgt)
+{
+    const struct {
+        const char *key;
+        int bit;
+    } keys[] = {
+        { UPDI_KEY_NVM, UPDI_ASI_KEY_STATUS_NVMPROG },
+        { UPDI_KEY_CHIPERASE, UPDI_ASI_KEY_STATUS_CHIPERASE },
+    };
+    int i, j;
+
+    for (i = 0; i < ARRAY_SIZE(keys); i++) {
+        if ((int)strlen(keys[i].key) != tgt->keylen)
+            continue;
+
+        for (j = 0; j < tgt->keylen; j++) {
+            if ((u8)keys[i].key[tgt->keylen - j - 1] != tgt->key[j])
+                break;
+        }
+
+        if (j == tgt->keylen)
+            tgt->key_status |= (1 << keys[i].bit);
+    }
+}
+
+/*
+    Whether the response signature is disabled
+*/
+static bool _sim_rsd(upd_target_t *tgt)
+{
+    return !!(tgt->cs[UPDI_CS_CTRLA] & (1 << UPDI_CTRLA_RSD_BIT));
+}
+
+/*
+    Size field of an instruction to bytes
+*/
+static int _sim_size(u8 field)
+{
+    return (field & 0x3) + 1;
+}
+
+/*
+    Load data at pointer for each repeat
+*/
+static int _sim_ld_ptr(upd_target_t *tgt, u8 *resp, int size)
+{
+    int i, j, n = 0;
+    int dsize = _sim_size(tgt->opcode);
+    bool inc = ((tgt->opcode >> 2) & 0x3) == 1;
+
+    for (i = 0; i <= tgt->repeat; i++) {
+        for (j = 0; j < dsize && n < size; j++)
+            resp[n++] = _sim_read(tgt, tgt->ptr + j);
+
+        if (inc)
+            tgt->ptr += dsize;
+    }
+
+    tgt->repeat = 0;
+    return n;
+}
+
+/*
+    Process an opcode
+*/
+static int _sim_opcode(upd_target_t *tgt, u8 val, u8 *resp, int size)
+{
+    const char *sib = SIM_NVM_V2(tgt) ? sim_sib_v2 : sim_sib;
+    int n = 0;
+    int mode;
+
+    tgt->opcode = val;
+    tgt->got = 0;
+    tgt->state = ST_IDLE;
+
+    switch (val & 0xE0) {
+    case UPDI_LDS:
+    case UPDI_STS:
+        tgt->nargs = _sim_size(val >> 2);
+        tgt->state = ST_ARGS;
+        break;
+    case UPDI_LD:
+        mode = (val >> 2) & 0x3;
+        if (mode == 2) {
+            //Load pointer register
+            for (n = 0; n < _sim_size(val) && n < size; n++)
+                resp[n] = (tgt->ptr >> (n * 8)) & 0xFF;
+        }
+        else {
+            n = _sim_ld_ptr(tgt, resp, size);
+        }
+        break;
+    case UPDI_ST:
+        mode = (val >> 2) & 0x3;
+        if (mode == 2) {
+            tgt->nargs = _sim_size(val);
+            tgt->state = ST_ARGS;
+        }
+        else {
+            tgt->nargs = _sim_size(val);
+            tgt->units = tgt->repeat + 1;
+            tgt->repeat = 0;
+            tgt->state = ST_DATA;
+        }
+        break;
+    case UPDI_LDCS:
+        if (size > 0)
+            resp[n++] = _sim_ldcs(tgt, val & 0x0F);
+        break;
+    case UPDI_STCS:
+        tgt->nargs = 1;
+        tgt->state = ST_ARGS;
+        break;
+    case UPDI_REPEAT:
+        tgt->nargs = _sim_size(val);
+        tgt->state = ST_ARGS;
+        break;
+    case UPDI_KEY:
+        if (val & UPDI_KEY_SIB) {
+            for (n = 0; n < (8 << (val & 0x3)) && n < size; n++)
+                resp[n] = n < (int)strlen(sib) ? sib[n] : ' ';
+        }
+        else {
+            tgt->keylen = 8 << (val & 0x3);
+            tgt->got = 0;
+            tgt->state = ST_KEY;
+        }
+        break;
+    }
+
+    return n;
+}
+
+/*
+    All arguments of an instruction received
+*/
+static int _sim_args(upd_target_t *tgt, u8 *resp, int size)
+{
+    u32 value = 0;
+    int i, n = 0;
+
+    for (i = 0; i < tgt->nargs; i++)
+        value |= (u32)tgt->arg[i] << (i * 8);
+
+    tgt->state = ST_IDLE;
+
+    switch (tgt->opcode & 0xE0) {
+    case UPDI_LDS:
+        for (i = 0; i < _sim_size(tgt->opcode) && n < size; i++)
+            resp[n++] = _sim_read(tgt, value + i);
+        break;
+    case UPDI_STS:
+        tgt->ptr = value;   //STS uses its own address, reuse ptr as a scratch
+        tgt->units = 1;
+        tgt->nargs = _sim_size(tgt->opcode);
+        tgt->got = 0;
+        tgt->state = ST_DATA;
+        if (!_sim_rsd(tgt) && size > 0)
+            resp[n++] = UPDI_PHY_ACK;
+        break;
+    case UPDI_ST:
+        tgt->ptr = value;
+        if (!_sim_rsd(tgt) && size > 0)
+            resp[n++] = UPDI_PHY_ACK;
+        break;
+    case UPDI_STCS:
+        _sim_stcs(tgt, tgt->opcode & 0x0F, (u8)value);
+        break;
+    case UPDI_REPEAT:
+        tgt->repeat = value;
+        break;
+    }
+
+    return n;
+}
+
+/*
+    One data unit of ST/STS received
+*/
+static int _sim_data(upd_target_t *tgt, u8 *resp, int size)
+{
+    bool sts = (tgt->opcode & 0xE0) == UPDI_STS;
+    bool inc = sts || ((tgt->opcode >> 2) & 0x3) == 1;
+    u32 address = tgt->ptr;
+    int i, n = 0;
+
+    for (i = 0; i < tgt->nargs; i++)
+        _sim_write(tgt, address + i, tgt->arg[i]);
+
+    if (inc && !sts)
+        tgt->ptr += tgt->nargs;
+
+    if (!_sim_rsd(tgt) && size > 0)
+        resp[n++] = UPDI_PHY_ACK;
+
+    tgt->got = 0;
+    if (--tgt->units <= 0)
+        tgt->state = ST_IDLE;
+
+    return n;
+}
+
+/*
+    TARGET receive one byte from the bus
+    @tgt_ptr: TARGET object pointer, acquired from sim_target_init()
+    @val: byte received
+    @now_us: time of the byte end on the wire(us), used for the NVM busy model
+    @resp: output buffer for the bytes driven by the target
+    @size: output buffer size
+    @return response length, 0 if no response
+*/
+int sim_target_receive(void *tgt_ptr, u8 val, unsigned long long now_us, u8 *resp, int size)
+{
+    upd_target_t *tgt = (upd_target_t *)tgt_ptr;
+    int n = 0;
+
+    if (!VALID_TARGET(tgt) || !resp)
+        return ERROR_PTR;
+
+    tgt->now = now_us;
+
+    /* A zero frame while idle is taken as BREAK, for the hosts which can't change the baudrate */
+    if (tgt->state == ST_IDLE && val == UPDI_BREAK) {
+        sim_target_break(tgt);
+        return 0;
+    }
+
+    if (tgt->disabled)
+        return 0;
+
+    switch (tgt->state) {
+    case ST_IDLE:
+        if (val == UPDI_PHY_SYNC)
+            tgt->state = ST_OPCODE;
+        break;
+    case ST_OPCODE:
+        n = _sim_opcode(tgt, val, resp, size);
+        break;
+    case ST_ARGS:
+        tgt->arg[tgt->got++] = val;
+        if (tgt->got >= tgt->nargs)
+            n = _sim_args(tgt, resp, size);
+        break;
+    case ST_DATA:
+        tgt->arg[tgt->got++] = val;
+        if (tgt->got >= tgt->nargs)
+            n = _sim_data(tgt, resp, size);
+        break;
+    case ST_KEY:
+        tgt->key[tgt->got++] = val;
+        if (tgt->got >= tgt->keylen) {
+            _sim_key(tgt);
+            tgt->state = ST_IDLE;
+        }
+        break;
+    default:
+        tgt->state = ST_IDLE;
+        break;
+    }
+
+    return n;
+}
@@ -0,0 +1,22 @@
+#ifndef __SIM_TARGET_H
+#define __SIM_TARGET_H
+
+void *sim_target_init(const void *dev, int flags);
+void sim_target_deinit(void *tgt_ptr);
+void sim_target_break(void *tgt_ptr);
+int sim_target_receive(void *tgt_ptr, u8 val, unsigned long long now_us, u8 *resp, int size);
+int sim_target_guard_bits(void *tgt_ptr);
+bool sim_target_idle(void *tgt_ptr);
+
+/*
+Target creation flags
+*/
+#define SIM_FLAG_LOCKED (1 << 0)    //Start with the device locked (LOCKBIT fuse programmed)
+#define SIM_FLAG_TIMING (1 << 1)    //Model NVM busy durations against the supplied clock
+
+/*
+Max response size of one received byte (SIB 32 bytes or a repeated LD of 256 words)
+*/
+#define SIM_MAX_RESPONSE_SIZE 512
+
+#endif
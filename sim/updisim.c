@@ -0,0 +1,189 @@
+/*
+    updisim: UPDI target simulator on a pseudo terminal
+
+    Usage: updisim -d tiny817 [-l] [-t] [-g 16] [-p /tmp/updi]
+    Then run cupdi with '-c <pty path>' printed (or the link path given by '-p').
+
+    The pty echoes every byte like the single-wire UPDI bus does, a byte received at or below
+    600 baud (the legacy 0x00 break of the host) is taken as a BREAK condition.
+    With '-t', the output is delayed by the wire time of the current baudrate, the guard time
+    and the NVM busy time, so the host timing could be measured on the simulator.
+    With '-g', a host adapter slow to turn around is modeled: the responses sent after a guard
+    time shorter than the given bits are lost.
+*/
+
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include "os/platform.h"
+#include "argparse/argparse.h"
+#include "device/device.h"
+#include "pty.h"
+#include "target.h"
+
+#define SIM_BREAK_BAUDRATE 600
+#define SIM_FRAME_BITS 12   //UPDI frame 8E2: start + 8 data + parity + 2 stop
+#define SIM_DEFAULT_BAUDRATE 115200
+
+static const char *const usage[] = {
+    "updisim [options] [[--] args]",
+    NULL,
+};
+
+static volatile int running = 1;
+
+static void sim_stop(int sig)
+{
+    running = 0;
+}
+
+int main(int argc, const char *argv[])
+{
+    char *dev_name = NULL;
+    char *link_path = NULL;
+    int locked = 0, timing = 0, verbose = 0, min_guard = 0;
+    const device_info_t *dev;
+    char slave_name[64];
+    int master, slave;
+    void *tgt;
+    u8 in[256], out[sizeof(in) * 2 + SIM_MAX_RESPONSE_SIZE];
+    u8 resp[SIM_MAX_RESPONSE_SIZE];
+    struct pollfd pfd;
+    unsigned int baud;
+    ULONGLONG wire, byte_us, now;
+    int i, j, n, len, outlen;
+
+    struct argparse_option options[] = {
+        OPT_HELP(),
+        OPT_GROUP("Basic options"),
+        OPT_STRING('d', "device", &dev_name, "Target device"),
+        OPT_STRING('p', "path", &link_path, "Create a symbolic link to the pty slave at the path"),
+        OPT_BOOLEAN('l', "locked", &locked, "Start with a locked device"),
+        OPT_BOOLEAN('t', "timing", &timing, "Model wire time, guard time and NVM busy time"),
+        OPT_INTEGER('g', "guard", &min_guard, "Lose the responses with a guard time shorter than the bits"),
+        OPT_INTEGER('v', "verbose", &verbose, "Set verbose mode (SILENCE|UPDI|NVM|APP|LINK|PHY|SER): [0~6], default 0"),
+        OPT_END(),
+    };
+
+    struct argparse argparse;
+    argparse_init(&argparse, options, usage, 0);
+    argparse_describe(&argparse, "\nUPDI target simulator on a pseudo terminal.", "\nThe pty path is printed at start, use it as the comport of cupdi.");
+    argc = argparse_parse(&argparse, argc, argv);
+
+    set_verbose_level(verbose);
+
+    if (!dev_name) {
+        argparse_usage(&argparse);
+        return -1;
+    }
+
+    dev = get_chip_info(dev_name);
+    if (!dev) {
+        _loginfo_i("Device %s not support", dev_name);
+        return -2;
+    }
+
+    tgt = sim_target_init(dev, (locked ? SIM_FLAG_LOCKED : 0) | (timing ? SIM_FLAG_TIMING : 0));
+    if (!tgt) {
+        _loginfo_i("Target init failed");
+        return -3;
+    }
+
+    master = sim_pty_open(slave_name, sizeof(slave_name), &slave);
+    if (master < 0) {
+        _loginfo_i("Open pty failed(%d)", master);
+        sim_target_deinit(tgt);
+        return -4;
+    }
+
+    if (link_path) {
+        unlink(link_path);
+        if (symlink(slave_name, link_path))
+            _loginfo_i("Create link %s failed", link_path);
+    }
+
+    signal(SIGINT, sim_stop);
+    signal(SIGTERM, sim_stop);
+
+    printf("%s\n", slave_name);
+    fflush(stdout);
+
+    pfd.fd = master;
+    pfd.events = POLLIN;
+    wire = 0;
+
+    while (running) {
+        if (poll(&pfd, 1, 200) <= 0)
+            continue;
+
+        len = read(master, in, sizeof(in));
+        if (len <= 0) {
+            if (len < 0 && errno != EINTR && errno != EAGAIN && errno != EIO)
+                break;
+            continue;
+        }
+
+        baud = sim_pty_baudrate(master);
+        if (!baud)
+            baud = SIM_DEFAULT_BAUDRATE;
+
+        now = clock_us();
+        byte_us = ((ULONGLONG)SIM_FRAME_BITS * 1000000 + baud - 1) / baud;
+        if (wire < now)
+            wire = now;
+
+        DBG(UPDI_DEBUG, "<< (%d baud)", in, len, (const unsigned char *)"0x%02x ", baud);
+
+        outlen = 0;
+        for (i = 0; i < len; i++) {
+            wire += byte_us;
+
+            //Local echo of the single wire
+            out[outlen++] = in[i];
+
+            if (baud <= SIM_BREAK_BAUDRATE) {
+                sim_target_break(tgt);
+                continue;
+            }
+
+            n = sim_target_receive(tgt, in[i], timing ? wire : 0, resp, sizeof(resp));
+            if (n > 0 && sim_target_guard_bits(tgt) < min_guard) {
+                DBG(UPDI_DEBUG, ">> (lost, guard %d bits)", resp, n, (const unsigned char *)"0x%02x ", sim_target_guard_bits(tgt));
+                n = 0;
+            }
+
+            if (n > 0) {
+                DBG(UPDI_DEBUG, ">>", resp, n, (const unsigned char *)"0x%02x ");
+
+                wire += ((ULONGLONG)sim_target_guard_bits(tgt) * 1000000 + baud - 1) / baud;
+                for (j = 0; j < n; j++) {
+                    if (outlen >= sizeof(out)) {
+                        write(master, out, outlen);
+                        outlen = 0;
+                    }
+                    out[outlen++] = resp[j];
+                    wire += byte_us;
+                }
+            }
+        }
+
+        if (timing) {
+            now = clock_us();
+            if (wire > now)
+                usleep(wire - now);
+        }
+
+        if (outlen)
+            write(master, out, outlen);
+    }
+
+    if (link_path)
+        unlink(link_path);
+
+    close(slave);
+    close(master);
+    sim_target_deinit(tgt);
+
+    return 0;
+}
@@ -0,0 +1,421 @@
+/*
+    upditrace: analyzer and pty replayer of the cupdi wire trace (cupdi --trace=<file>)
+
+    Usage: upditrace -f session.trc [-a]
+           upditrace -f session.trc -p /tmp/updi [-t]
+
+    '-a' prints the records count, the wire bytes and the TX-end to RX-start gap of each
+    NVM operation / LINK instruction. The gap is the time of a transfer which isn't spent
+    on the wire (adapter latency, guard time, NVM busy time and host overhead), the wire
+    time is taken from the recorded baudrate.
+    '-p' serves the recorded target side on a pty: the data sent by the host is checked
+    against the TX records and the RX records following them are written back, with the
+    recorded delays if '-t' is given.
+*/
+
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include "os/platform.h"
+#include "argparse/argparse.h"
+#include "updi/trace.h"
+#include "pty.h"
+
+#define TRACE_BREAK_BAUDRATE 600
+#define TRACE_FRAME_BITS 12   //UPDI frame 8E2: start + 8 data + parity + 2 stop
+#define TRACE_DEFAULT_BAUDRATE 115200
+
+static const char *const usage[] = {
+    "upditrace [options] [[--] args]",
+    NULL,
+};
+
+/*
+    Trace file content
+    @data/size: file content and size
+    @pos: current record position
+*/
+typedef struct _trace_file {
+    u8 *data;
+    int size;
+    int pos;
+}trace_file_t;
+
+/*
+    Gap statistic of an operation tag
+*/
+typedef struct _trace_gap {
+    int count;
+    int tx_bytes;
+    int rx_bytes;
+    ULONGLONG wire_us;
+    ULONGLONG gap_us;
+    u32 max_us;
+}trace_gap_t;
+
+static volatile int running = 1;
+
+static void trace_stop_serve(int sig)
+{
+    running = 0;
+}
+
+/*
+    Load trace file
+    @return 0 successful, other value if failed
+*/
+static int trace_load(const char *file, trace_file_t *tf)
+{
+    FILE *fp;
+    long size;
+
+    fp = fopen(file, "rb");
+    if (!fp)
+        return -1;
+
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    tf->data = malloc(size > 0 ? size : 1);
+    if (!tf->data || fread(tf->data, 1, size, fp) != (size_t)size ||
+        size < UPD_TRACE_MAGIC_SIZE || memcmp(tf->data, UPD_TRACE_MAGIC, UPD_TRACE_MAGIC_SIZE)) {
+        fclose(fp);
+        if (tf->data)
+            free(tf->data);
+        return -2;
+    }
+    fclose(fp);
+
+    tf->size = (int)size;
+    tf->pos = UPD_TRACE_MAGIC_SIZE;
+
+    return 0;
+}
+
+/*
+    Get current record
+    @data: output pointer of the record data
+    @return record header, NULL if end of trace
+*/
+static const upd_trace_record_t *trace_peek(trace_file_t *tf, const u8 **data)
+{
+    const upd_trace_record_t *rec;
+
+    if (tf->pos + (int)sizeof(*rec) > tf->size)
+        return NULL;
+
+    rec = (const upd_trace_record_t *)(tf->data + tf->pos);
+    if (tf->pos + (int)sizeof(*rec) + rec->len > tf->size)
+        return NULL;
+
+    *data = tf->data + tf->pos + sizeof(*rec);
+
+    return rec;
+}
+
+static void trace_next(trace_file_t *tf)
+{
+    const upd_trace_record_t *rec;
+    const u8 *data;
+
+    rec = trace_peek(tf, &data);
+    if (rec)
+        tf->pos += sizeof(*rec) + rec->len;
+}
+
+static u32 trace_get_u32(const u8 *data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((u32)data[3] << 24);
+}
+
+/*
+    Close a transfer(TX record and the RX records following it) into the gap statistic
+*/
+static void trace_account(trace_gap_t *gap, u32 baud, u32 tx_time, int tx_len, u32 rx_time, int rx_len)
+{
+    ULONGLONG wire;
+    u32 elapsed, idle;
+
+    //Echo of the single wire overlaps with the TX data, the wire is busy for the longer one
+    wire = ((ULONGLONG)max(tx_len, rx_len) * TRACE_FRAME_BITS * 1000000 + baud - 1) / baud;
+    elapsed = rx_time - tx_time;
+    idle = elapsed > wire ? (u32)(elapsed - wire) : 0;
+
+    gap->count++;
+    gap->tx_bytes += tx_len;
+    gap->rx_bytes += rx_len;
+    gap->wire_us += wire;
+    gap->gap_us += idle;
+    if (idle > gap->max_us)
+        gap->max_us = idle;
+}
+
+/*
+    Print the records and the gaps of each operation tag
+*/
+static int trace_analyze(trace_file_t *tf)
+{
+    static trace_gap_t gaps[256];
+    trace_gap_t total;
+    const upd_trace_record_t *rec;
+    const u8 *data;
+    u32 baud = TRACE_DEFAULT_BAUDRATE;
+    u32 tx_time = 0, rx_time = 0, end_time = 0;
+    int tx_len = 0, rx_len = 0, tx_tag = 0;
+    int counts[256] = { 0 };
+    int i;
+
+    memset(gaps, 0, sizeof(gaps));
+    memset(&total, 0, sizeof(total));
+
+    while ((rec = trace_peek(tf, &data))) {
+        counts[rec->type]++;
+        end_time = rec->time_us;
+
+        if (rec->type == TRACE_RX) {
+            if (tx_len) {
+                rx_len += rec->len;
+                rx_time = rec->time_us;
+            }
+        }
+        else {
+            if (tx_len && rx_len)
+                trace_account(&gaps[tx_tag], baud, tx_time, tx_len, rx_time, rx_len);
+            tx_len = rx_len = 0;
+
+            if (rec->type == TRACE_TX) {
+                tx_time = rec->time_us;
+                tx_len = rec->len;
+                tx_tag = rec->tag;
+            }
+            else if (rec->type == TRACE_STATE && rec->len >= sizeof(u32)) {
+                baud = trace_get_u32(data);
+                if (!baud)
+                    baud = TRACE_DEFAULT_BAUDRATE;
+            }
+        }
+
+        trace_next(tf);
+    }
+
+    if (tx_len && rx_len)
+        trace_account(&gaps[tx_tag], baud, tx_time, tx_len, rx_time, rx_len);
+
+    if (tf->pos != tf->size)
+        _loginfo_i("Trace truncated at %d/%d", tf->pos, tf->size);
+
+    _loginfo_i("Records: TX %d, RX %d, BREAK %d, STATE %d, duration %u us",
+        counts[TRACE_TX], counts[TRACE_RX], counts[TRACE_BREAK], counts[TRACE_STATE], end_time);
+    _loginfo_i("%-14s %-8s %8s %8s %8s %10s %10s %8s %8s", "NVM", "LINK", "xfers", "tx", "rx", "wire(us)", "gap(us)", "avg", "max");
+
+    for (i = 0; i < 256; i++) {
+        if (!gaps[i].count)
+            continue;
+
+        _loginfo_i("%-14s %-8s %8d %8d %8d %10llu %10llu %8llu %8u",
+            trace_nvm_op_name(TRACE_TAG_NVM(i)), trace_link_op_name(TRACE_TAG_LINK(i)),
+            gaps[i].count, gaps[i].tx_bytes, gaps[i].rx_bytes, gaps[i].wire_us, gaps[i].gap_us,
+            gaps[i].gap_us / gaps[i].count, gaps[i].max_us);
+
+        total.count += gaps[i].count;
+        total.tx_bytes += gaps[i].tx_bytes;
+        total.rx_bytes += gaps[i].rx_bytes;
+        total.wire_us += gaps[i].wire_us;
+        total.gap_us += gaps[i].gap_us;
+        if (gaps[i].max_us > total.max_us)
+            total.max_us = gaps[i].max_us;
+    }
+
+    if (total.count) {
+        _loginfo_i("%-14s %-8s %8d %8d %8d %10llu %10llu %8llu %8u", "total", "",
+            total.count, total.tx_bytes, total.rx_bytes, total.wire_us, total.gap_us,
+            total.gap_us / total.count, total.max_us);
+    }
+
+    return 0;
+}
+
+/*
+    Write the RX records following current position to the pty
+    @delay: keep the recorded delay to the TX record at 'tx_time'
+*/
+static void trace_serve_rx(trace_file_t *tf, int master, bool delay, u32 tx_time, ULONGLONG tx_clock)
+{
+    const upd_trace_record_t *rec;
+    const u8 *data;
+    ULONGLONG now;
+
+    while ((rec = trace_peek(tf, &data)) && rec->type == TRACE_RX) {
+        if (delay && rec->time_us > tx_time) {
+            now = clock_us();
+            if (tx_clock + (rec->time_us - tx_time) > now)
+                usleep(tx_clock + (rec->time_us - tx_time) - now);
+        }
+
+        if (rec->len)
+            write(master, data, rec->len);
+        trace_next(tf);
+    }
+}
+
+/*
+    Serve the target side of the trace on a pty
+    @path: symbolic link to the pty slave, NULL if not used
+    @delay: keep the recorded response delays
+*/
+static int trace_serve(trace_file_t *tf, const char *path, bool delay)
+{
+    const upd_trace_record_t *rec;
+    const u8 *data;
+    char slave_name[64];
+    int master, slave;
+    struct pollfd pfd;
+    u8 in[256];
+    unsigned int baud;
+    ULONGLONG tx_clock = 0;
+    int offset = 0, breaks = 0, mismatch = 0;
+    int i, len;
+
+    master = sim_pty_open(slave_name, sizeof(slave_name), &slave);
+    if (master < 0) {
+        _loginfo_i("Open pty failed(%d)", master);
+        return -2;
+    }
+
+    if (path) {
+        unlink(path);
+        if (symlink(slave_name, path))
+            _loginfo_i("Create link %s failed", path);
+    }
+
+    signal(SIGINT, trace_stop_serve);
+    signal(SIGTERM, trace_stop_serve);
+
+    printf("%s\n", slave_name);
+    fflush(stdout);
+
+    pfd.fd = master;
+    pfd.events = POLLIN;
+
+    while (running && trace_peek(tf, &data)) {
+        if (poll(&pfd, 1, 200) <= 0)
+            continue;
+
+        len = read(master, in, sizeof(in));
+        if (len <= 0) {
+            if (len < 0 && errno != EINTR && errno != EAGAIN && errno != EIO)
+                break;
+            continue;
+        }
+
+        baud = sim_pty_baudrate(master);
+
+        for (i = 0; i < len; i++) {
+            while ((rec = trace_peek(tf, &data)) && (rec->type == TRACE_STATE || rec->type == TRACE_RX))
+                trace_next(tf);
+
+            if (!rec) {
+                DBG_INFO(UPDI_DEBUG, "End of trace, %d bytes dropped", len - i);
+                break;
+            }
+
+            //A hardware BREAK is recorded, the pty host sends it as a slow zero frame
+            if (rec->type == TRACE_BREAK) {
+                if (baud && baud <= TRACE_BREAK_BAUDRATE) {
+                    write(master, &in[i], 1);
+                    if (++breaks >= (rec->len ? data[0] : 1)) {
+                        breaks = 0;
+                        trace_next(tf);
+                    }
+                    continue;
+                }
+                breaks = 0;
+                trace_next(tf);
+                rec = trace_peek(tf, &data);
+                if (!rec || rec->type != TRACE_TX)
+                    continue;
+            }
+
+            if (!offset)
+                tx_clock = clock_us();
+
+            if (offset < rec->len && in[i] != data[offset]) {
+                DBG_INFO(UPDI_DEBUG, "TX mismatch %02x(%02x) at record %d", in[i], data[offset], tf->pos);
+                mismatch++;
+            }
+
+            if (++offset >= rec->len) {
+                offset = 0;
+                trace_next(tf);
+                trace_serve_rx(tf, master, delay, rec->time_us, tx_clock);
+            }
+        }
+    }
+
+    //Let the host drain the last response
+    usleep(100000);
+
+    if (mismatch)
+        _loginfo_i("%d bytes mismatched with the trace", mismatch);
+
+    if (path)
+        unlink(path);
+
+    close(slave);
+    close(master);
+
+    return mismatch ? -3 : 0;
+}
+
+int main(int argc, const char *argv[])
+{
+    char *file = NULL;
+    char *link_path = NULL;
+    int analyze = 0, delay = 0, verbose = 0;
+    trace_file_t tf;
+    int result;
+
+    struct argparse_option options[] = {
+        OPT_HELP(),
+        OPT_GROUP("Basic options"),
+        OPT_STRING('f', "file", &file, "Trace file recorded by 'cupdi --trace'"),
+        OPT_BOOLEAN('a', "analyze", &analyze, "Print the gaps of each operation (default if no '-p')"),
+        OPT_STRING('p', "path", &link_path, "Serve the trace on a pty, and create a symbolic link to the pty slave at the path"),
+        OPT_BOOLEAN('t', "timing", &delay, "Keep the recorded response delays while serving"),
+        OPT_INTEGER('v', "verbose", &verbose, "Set verbose mode (SILENCE|UPDI|NVM|APP|LINK|PHY|SER): [0~6], default 0"),
+        OPT_END(),
+    };
+
+    struct argparse argparse;
+    argparse_init(&argparse, options, usage, 0);
+    argparse_describe(&argparse, "\nAnalyzer and pty replayer of the cupdi wire trace.", "\nThe trace is recorded with 'cupdi --trace=<file>'.");
+    argc = argparse_parse(&argparse, argc, argv);
+
+    set_verbose_level(verbose);
+
+    if (!file) {
+        argparse_usage(&argparse);
+        return -1;
+    }
+
+    memset(&tf, 0, sizeof(tf));
+    result = trace_load(file, &tf);
+    if (result) {
+        _loginfo_i("Load trace %s failed(%d)", file, result);
+        return -2;
+    }
+
+    if (analyze || !link_path) {
+        result = trace_analyze(&tf);
+        tf.pos = UPD_TRACE_MAGIC_SIZE;
+    }
+
+    if (link_path)
+        result = trace_serve(&tf, link_path, delay);
+
+    free(tf.data);
+
+    return result;
+}
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include "os/platform.h"
 #include "device/device.h"
+#include "stats.h"
 #include "link.h"
 #include "application.h"
 #include "constants.h"
@@ -26,12 +27,30 @@ limitations under the License.
     @mgwd: magicword
     @link: pointer to link object
     @dev: point chip dev object
+    @stats: performance counters, kept by the phy object
+    @sib/sigrow/revid: device information read once per session
+    @sernum/sernum_len: unique serial number of the chip, read with the SIGROW
+    @has_sib/has_sigrow: whether the device information above is cached
+    @nvm_busy: a NVM operation may be in progress, app_wait_flash_ready() only polls the controller then
+    @nvm_ready_us: expected end time of the NVM operation in progress, the first poll is deferred to it
+    @pbuf_clean: the page buffer is known all cleared, by PAGE_BUFFER_CLR or a page write
 */
 typedef struct _upd_application {
 #define UPD_APPLICATION_MAGIC_WORD 0xB4B4 //'uapp'
     unsigned int mgwd;  //magic word
     void *link;
     device_info_t *dev;
+    upd_stats_t *stats;
+    u8 sib[16];
+    u8 sigrow[14];
+    u8 revid;
+    u8 sernum[16];
+    int sernum_len;
+    bool has_sib;
+    bool has_sigrow;
+    bool nvm_busy;
+    ULONGLONG nvm_ready_us;
+    bool pbuf_clean;
 }upd_application_t;
 
 /*
@@ -39,31 +58,83 @@ typedef struct _upd_application {
     @VALID_APP(): check whether valid APP object
     @LINK(): get link object ptr
     @APP_REG(): chip reg address
+    @APP_FLAG(): chip capability flag DEV_FLAG_*
 */
 #define VALID_APP(_app) ((_app) && ((_app)->mgwd == UPD_APPLICATION_MAGIC_WORD))
 #define LINK(_app) ((_app)->link)
 #define APP_REG(_app, _name) ((_app)->dev->mmap->reg._name)
+#define APP_FLAG(_app, _flag) (!!((_app)->dev->mmap->flags & (_flag)))
+
+/*
+    Expected busy time(us) of the NVMCTRL commands, typical values of tinyAVR 0/1 datasheet,
+        indexed by UPDI_NVMCTRL_CTRLA_*
+*/
+static const int nvm_command_time[] = {
+    0,      /* NOP */
+    2000,   /* WRITE_PAGE */
+    2000,   /* ERASE_PAGE */
+    4000,   /* ERASE_WRITE_PAGE */
+    0,      /* PAGE_BUFFER_CLR */
+    4000,   /* CHIP_ERASE */
+    4000,   /* ERASE_EEPROM */
+    4000,   /* WRITE_FUSE */
+};
+
+/*
+    NVMCTRL v2 expected busy time(us), typical values of AVR DA datasheet. Except the chip erase,
+        the controller is busy by the data written after the command, not the command itself
+*/
+#define APP_V2_FLASH_WRITE_TIME 70
+#define APP_V2_PAGE_ERASE_TIME 10000
+#define APP_V2_EEPROM_WRITE_TIME 11000
+#define APP_V2_CHIP_ERASE_TIME 70000
+
+/*
+    Backoff(us) of the NVM ready polls after the expected busy time, doubled at each busy poll
+*/
+#define APP_NVM_POLL_MIN_US 50
+#define APP_NVM_POLL_MAX_US 1000
+
+/*
+    Serial number in the SIGROW: 10 bytes after the device ID of tinyAVR/megaAVR 0/1,
+        16 bytes at offset 0x10 of AVR DA/DB
+*/
+#define APP_SERNUM_OFFSET 3
+#define APP_SERNUM_SIZE 10
+#define APP_V2_SERNUM_OFFSET 0x10
+#define APP_V2_SERNUM_SIZE 16
 
 /*
     APP object init
     @port: serial port name of Window or Linux
     @baud: baudrate
     @dev: point chip dev object
+    @fast: attach to an already enabled UPDI without BREAK if possible
     @return APP ptr, NULL if failed
 */
-void *updi_application_init(const char *port, int baud, void *dev)
+void *updi_application_init(const char *port, int baud, void *dev, bool fast)
 {
     upd_application_t *app = NULL;
     void *link;
 
     DBG_INFO(APP_DEBUG, "<APP> init application");
 
-    link = updi_datalink_init(port, baud);
+    link = updi_datalink_init(port, baud, fast);
     if (link) {
         app = (upd_application_t *)malloc(sizeof(*app));
         app->mgwd = UPD_APPLICATION_MAGIC_WORD;
         app->link = (void *)link;
         app->dev = (device_info_t *)dev;
+        app->stats = link_get_stats(link);
+        app->has_sib = false;
+        app->has_sigrow = false;
+        // Unknown state of the controller, poll once before the first operation
+        app->nvm_busy = true;
+        app->nvm_ready_us = 0;
+        app->pbuf_clean = false;
+
+        if (APP_FLAG(app, DEV_FLAG_ADDRESS_24))
+            link_set_address_size(link, UPDI_ADDRESS_24);
     }
 
     return app;
@@ -87,6 +158,7 @@ void updi_application_deinit(void *app_ptr)
 
 /*
     APP get device ID information, in Unlocked Mode, the SIGROW could be readout
+    The SIB and SIGROW are read once and cached for the session
     @app_ptr: APP object pointer, acquired from updi_application_init()
     @return 0 successful, other value if failed
 */
@@ -96,10 +168,7 @@ int app_device_info(void *app_ptr)
         Reads out device information from various sources
     */
     upd_application_t *app = (upd_application_t *)app_ptr;
-    u8 sib[16];
     u8 pdi;
-    u8 sigrow[14];
-    u8 revid[1];
     int result;
 
     if (!VALID_APP(app))
@@ -107,36 +176,59 @@ int app_device_info(void *app_ptr)
 
     DBG_INFO(APP_DEBUG, "<APP> Device info");
 
-    result = link_read_sib(LINK(app), sib, sizeof(sib));
-    if (result) {
-        DBG_INFO(APP_DEBUG, "link_read_sib failed %d", result);
-        return -2;
+    if (app->has_sib && app->has_sigrow) {
+        DBG_INFO(APP_DEBUG, "Device info cached");
+        return 0;
     }
 
-    DBG(APP_DEBUG, "[SIB]", sib, sizeof(sib), "%02x ");
-    DBG(APP_DEBUG, "[Family ID]", sib, 7, "%c");
-    DBG(APP_DEBUG, "[NVM revision]", sib + 8, 3, "%c");
-    DBG(APP_DEBUG, "[OCD revision]", sib + 11, 3, "%c");
-    DBG_INFO(APP_DEBUG, "[PDI OSC] is %cMHz", sib[15]);
+    if (!app->has_sib) {
+        result = link_read_sib(LINK(app), app->sib, sizeof(app->sib));
+        if (result) {
+            DBG_INFO(APP_DEBUG, "link_read_sib failed %d", result);
+            return -2;
+        }
+        app->has_sib = true;
+
+        DBG(APP_DEBUG, "[SIB]", app->sib, sizeof(app->sib), "%02x ");
+        DBG(APP_DEBUG, "[Family ID]", app->sib, 7, "%c");
+        DBG(APP_DEBUG, "[NVM revision]", app->sib + 8, 3, "%c");
+        DBG(APP_DEBUG, "[OCD revision]", app->sib + 11, 3, "%c");
+        DBG_INFO(APP_DEBUG, "[PDI OSC] is %cMHz", app->sib[15]);
 
-    pdi = link_ldcs(LINK(app), UPDI_CS_STATUSA);
-    DBG_INFO(APP_DEBUG, "[PDI Rev] is %d", (pdi >> 4));
+        if (!link_ldcs_stable(LINK(app), UPDI_CS_STATUSA, &pdi))
+            DBG_INFO(APP_DEBUG, "[PDI Rev] is %d", (pdi >> 4));
+    }
 
     if (app_in_prog_mode(app)) {
-        result = app_read_data(app, APP_REG(app, sigrow_address), sigrow, sizeof(sigrow));
+        result = app_read_data(app, APP_REG(app, sigrow_address), app->sigrow, sizeof(app->sigrow));
         if (result) {
             DBG_INFO(APP_DEBUG, "app_read_data sigrow failed %d", result);
             return -3;
         }
 
-        result = app_read_data(app, APP_REG(app, syscfg_address) + 1, revid, sizeof(revid));
+        result = app_read_data(app, APP_REG(app, syscfg_address) + 1, &app->revid, 1);
         if (result) {
             DBG_INFO(APP_DEBUG, "app_read_data revid failed %d", result);
             return -4;
         }
-        DBG(APP_DEBUG, "[Device ID]", sigrow, 3, "%02x ");
-        DBG(APP_DEBUG, "[Sernum ID]", sigrow + 3, 10, "%02x ");
-        DBG_INFO(APP_DEBUG, "[Device Rev] is %c", revid[0] + 'A');
+
+        if (APP_FLAG(app, DEV_FLAG_NVMCTRL_V2)) {
+            result = app_read_data(app, APP_REG(app, sigrow_address) + APP_V2_SERNUM_OFFSET, app->sernum, APP_V2_SERNUM_SIZE);
+            if (result) {
+                DBG_INFO(APP_DEBUG, "app_read_data sernum failed %d", result);
+                return -5;
+            }
+            app->sernum_len = APP_V2_SERNUM_SIZE;
+        }
+        else {
+            memcpy(app->sernum, app->sigrow + APP_SERNUM_OFFSET, APP_SERNUM_SIZE);
+            app->sernum_len = APP_SERNUM_SIZE;
+        }
+        app->has_sigrow = true;
+
+        DBG(APP_DEBUG, "[Device ID]", app->sigrow, 3, "%02x ");
+        DBG(APP_DEBUG, "[Sernum ID]", app->sernum, app->sernum_len, "%02x ");
+        DBG_INFO(APP_DEBUG, "[Device Rev] is %c", app->revid + 'A');
     }
 
     return 0;
@@ -160,7 +252,8 @@ bool app_in_prog_mode(void *app_ptr)
     if (!VALID_APP(app))
         return ret;
 
-    result = _link_ldcs(LINK(app), UPDI_ASI_SYS_STATUS, &status);
+    // NVMPROG only changes with a key and reset, served from the shadow after the last status load
+    result = link_ldcs_stable(LINK(app), UPDI_ASI_SYS_STATUS, &status);
     if (!result && status & (1 << UPDI_ASI_SYS_STATUS_NVMPROG))
         ret = true;
 
@@ -222,6 +315,7 @@ int app_unlock(void *app_ptr)
         Unlock and erase
     */
     upd_application_t *app = (upd_application_t *)app_ptr;
+    link_frame_t frm;
     u8 status;
     int result;
 
@@ -230,17 +324,18 @@ int app_unlock(void *app_ptr)
 
     DBG_INFO(APP_DEBUG, "<APP> unlock");
 
-    // Put in the key
-    result = link_key(LINK(app), UPDI_KEY_64, UPDI_KEY_CHIPERASE);
+    // Put in the key and check key status in one frame
+    link_frame_init(LINK(app), &frm);
+    link_frame_key(&frm, UPDI_KEY_64, UPDI_KEY_CHIPERASE);
+    link_frame_ldcs(&frm, UPDI_ASI_KEY_STATUS, &status);
+    result = link_frame_send(&frm);
     if (result) {
-        DBG_INFO(APP_DEBUG, "link_key failed %d", result);
+        DBG_INFO(APP_DEBUG, "link_frame_send key failed %d", result);
         return -2;
     }
 
-    // Check key status
-    result = _link_ldcs(LINK(app), UPDI_ASI_KEY_STATUS, &status);
-    if (result || !(status & (1 << UPDI_ASI_KEY_STATUS_CHIPERASE))) {
-        DBG_INFO(APP_DEBUG, "_link_ldcs Chiperase Key not accepted(%d), status 0x%02x", result, status);
+    if (!(status & (1 << UPDI_ASI_KEY_STATUS_CHIPERASE))) {
+        DBG_INFO(APP_DEBUG, "Chiperase Key not accepted, status 0x%02x", status);
         return -3;
     }
 
@@ -272,6 +367,7 @@ int app_enter_progmode(void *app_ptr)
         Enters into NVM programming mode
     */
     upd_application_t *app = (upd_application_t *)app_ptr;
+    link_frame_t frm;
     u8 status;
     int result;
 
@@ -288,17 +384,18 @@ int app_enter_progmode(void *app_ptr)
 
     DBG_INFO(APP_DEBUG, "Entering NVM programming mode");
 
-    // Put in the key
-    result = link_key(LINK(app), UPDI_KEY_64, UPDI_KEY_NVM);
+    // Put in the key and check key status in one frame
+    link_frame_init(LINK(app), &frm);
+    link_frame_key(&frm, UPDI_KEY_64, UPDI_KEY_NVM);
+    link_frame_ldcs(&frm, UPDI_ASI_KEY_STATUS, &status);
+    result = link_frame_send(&frm);
     if (result) {
-        DBG_INFO(APP_DEBUG, "link_key failed %d", result);
+        DBG_INFO(APP_DEBUG, "link_frame_send key failed %d", result);
         return -2;
     }
 
-    // Check key status
-    result = _link_ldcs(LINK(app), UPDI_ASI_KEY_STATUS, &status);
-    if (result || !(status & (1 << UPDI_ASI_KEY_STATUS_NVMPROG))) {
-        DBG_INFO(APP_DEBUG, "_link_ldcs Nvm Key not accepted(%d), status 0x%02x", result, status);
+    if (!(status & (1 << UPDI_ASI_KEY_STATUS_NVMPROG))) {
+        DBG_INFO(APP_DEBUG, "Nvm Key not accepted, status 0x%02x", status);
         return -3;
     }
 
@@ -405,7 +502,13 @@ int app_reset(void *app_ptr, bool apply_reset)
     DBG_INFO(APP_DEBUG, "<APP> Reset %d", apply_reset);
 
     if (apply_reset) {
+        // Don't cut a NVM operation in progress
+        result = app_wait_flash_ready(app, TIMEOUT_WAIT_FLASH_READY);
+        if (result)
+            DBG_INFO(APP_DEBUG, "app_wait_flash_ready before reset failed %d", result);
+
         DBG_INFO(APP_DEBUG, "Apply reset");
+        app->pbuf_clean = false;
         result = link_stcs(LINK(app), UPDI_ASI_RESET_REQ, UPDI_RESET_REQ_VALUE);
     }
     else {
@@ -458,10 +561,27 @@ int app_toggle_reset(void *app_ptr, int delay)
     return 0;
 }
 
+/*
+    APP mark the NVM controller busy by an operation just started, the wait is deferred to
+        the next operation needing the controller, see app_wait_flash_ready()
+    @app: APP object
+    @busy_us: expected busy time, 0 if the operation completes at once
+*/
+static void _app_nvm_busy(upd_application_t *app, int busy_us)
+{
+    if (busy_us <= 0)
+        return;
+
+    app->nvm_busy = true;
+    app->nvm_ready_us = clock_us() + busy_us;
+}
+
 /*
     APP wait flash ready
+    Return at once if no NVM operation is in progress. Otherwise the status is first polled
+        at the expected end of the operation, then with a backoff from APP_NVM_POLL_MIN_US
     @app_ptr: APP object pointer, acquired from updi_application_init()
-    @timeout: max flash programing time
+    @timeout: max flash programing time in ms
     @return 0 successful, other value if failed
 */
 int app_wait_flash_ready(void *app_ptr, int timeout)
@@ -470,14 +590,28 @@ int app_wait_flash_ready(void *app_ptr, int timeout)
         Waits for the NVM controller to be ready
     */
     upd_application_t *app = (upd_application_t *)app_ptr;
-    u8 status;
+    ULONGLONG start, now, deadline;
+    int poll = APP_NVM_POLL_MIN_US;
+    u8 status, error;
     int result;
 
     if (!VALID_APP(app))
         return ERROR_PTR;
 
+    if (!app->nvm_busy)
+        return 0;
+
     DBG_INFO(APP_DEBUG, "<APP> Wait flash ready");
 
+    error = APP_FLAG(app, DEV_FLAG_NVMCTRL_V2) ? UPDI_V2_NVM_STATUS_ERROR_MASK : (1 << UPDI_NVM_STATUS_WRITE_ERROR);
+
+    start = clock_us();
+    deadline = start + (ULONGLONG)timeout * 1000;
+
+    // Don't poll before the operation could be done
+    if (app->nvm_ready_us > start)
+        udelay((int)(app->nvm_ready_us - start));
+
     do {
         result = _link_ld(LINK(app), APP_REG(app, nvmctrl_address) + UPDI_NVMCTRL_STATUS, &status);
         if (result) {
@@ -486,7 +620,7 @@ int app_wait_flash_ready(void *app_ptr, int timeout)
             break;
         }
         else {
-            if (status & (1 << UPDI_NVM_STATUS_WRITE_ERROR)) {
+            if (status & error) {
                 result = -3;
                 break;
             }
@@ -495,19 +629,34 @@ int app_wait_flash_ready(void *app_ptr, int timeout)
                 break;
         }
 
-        msleep(1);
-    } while (--timeout > 0);
+        app->stats->app.busy_polls++;
 
-    if (timeout <= 0 || result) {
+        now = clock_us();
+        if (now >= deadline) {
+            result = -4;
+            break;
+        }
+
+        udelay(poll);
+        if (poll < APP_NVM_POLL_MAX_US)
+            poll <<= 1;
+    } while (1);
+
+    stats_hist_add(&app->stats->flash_ready, clock_us() - start);
+
+    if (result) {
         DBG_INFO(APP_DEBUG, "Timeout waiting for wait flash ready status %02x result %d", status, result);
         return -3;
     }
 
+    app->nvm_busy = false;
+
     return 0;
 }
 
 /*
-    APP send a nvm command
+    APP send a nvm command, after the controller is ready. The command is not waited for,
+        the controller is marked busy for its expected time instead
     @app_ptr: APP object pointer, acquired from updi_application_init()
     @command: command content
     @return 0 successful, other value if failed
@@ -518,55 +667,101 @@ int app_execute_nvm_command(void *app_ptr, u8 command)
         Executes an NVM COMMAND on the NVM CTRL
     */
     upd_application_t *app = (upd_application_t *)app_ptr;
+    int result;
 
     if (!VALID_APP(app))
         return ERROR_PTR;
 
     DBG_INFO(APP_DEBUG, "<APP> NVMCMD %d executing", command);
 
-    return link_st(LINK(app), APP_REG(app, nvmctrl_address) + UPDI_NVMCTRL_CTRLA, command);
+    result = app_wait_flash_ready(app, TIMEOUT_WAIT_FLASH_READY);
+    if (result) {
+        DBG_INFO(APP_DEBUG, "app_wait_flash_ready before command %d failed %d", command, result);
+        return -2;
+    }
+
+    app->stats->app.nvm_commands++;
+
+    result = link_st(LINK(app), APP_REG(app, nvmctrl_address) + UPDI_NVMCTRL_CTRLA, command);
+    if (result) {
+        // Not known whether the command is started
+        _app_nvm_busy(app, 1);
+        return result;
+    }
+
+    if (APP_FLAG(app, DEV_FLAG_NVMCTRL_V2))
+        _app_nvm_busy(app, command == UPDI_V2_NVMCTRL_CTRLA_CHIP_ERASE ? APP_V2_CHIP_ERASE_TIME : 0);
+    else if (command < ARRAY_SIZE(nvm_command_time))
+        _app_nvm_busy(app, nvm_command_time[command]);
+
+    return 0;
 }
 
 /*
     APP erase page
     @app_ptr: APP object pointer, acquired from updi_application_init()
-    @page: page address to be erased
+    @address: address in the flash page to be erased
     @return 0 successful, other value if failed
 */
-int app_page_erase(void *app_ptr, u16 address)
+int app_page_erase(void *app_ptr, u32 address)
 {
     /*
-    Does a chip erase using the NVM controller
-    Note that on locked devices this it not possible and the ERASE KEY has to be used instead
+        Erases a flash page using the NVM controller, the page is selected by a dummy write to it:
+        to the page buffer before the ERASE_PAGE command, or to the flash with FLPER set in CTRLA of the NVMCTRL v2
     */
 
     upd_application_t *app = (upd_application_t *)app_ptr;
-    int result;
+    u8 dummy = 0xFF;
+    int result, ret = 0;
 
     if (!VALID_APP(app))
         return ERROR_PTR;
 
-    DBG_INFO(APP_DEBUG, "<APP> page erase using NVM CTRL");
+    DBG_INFO(APP_DEBUG, "<APP> page erase using NVM CTRL at %X", address);
+
+    if (APP_FLAG(app, DEV_FLAG_NVMCTRL_V2)) {
+        result = app_execute_nvm_command(app, UPDI_V2_NVMCTRL_CTRLA_FLASH_PAGE_ERASE);
+        if (result) {
+            DBG_INFO(APP_DEBUG, "app_execute_nvm_command failed %d", result);
+            return -3;
+        }
+
+        result = link_st(LINK(app), address, dummy);
+        _app_nvm_busy(app, APP_V2_PAGE_ERASE_TIME);
+        if (result) {
+            DBG_INFO(APP_DEBUG, "Page erase at %X failed %d", address, result);
+            ret = -4;
+        }
+
+        // NOCMD is sent after the erase is done
+        result = app_execute_nvm_command(app, UPDI_V2_NVMCTRL_CTRLA_NOCMD);
+        if (result) {
+            DBG_INFO(APP_DEBUG, "app_execute_nvm_command NOCMD failed %d", result);
+            return -5;
+        }
+
+        return ret;
+    }
 
-    //Wait until NVM CTRL is ready to erase
+    // The page buffer is loaded after the NVM CTRL is ready
     result = app_wait_flash_ready(app, TIMEOUT_WAIT_FLASH_READY);
     if (result) {
-        DBG_INFO(APP_DEBUG, "app_wait_flash_ready timeout before erase failed %d", result);
+        DBG_INFO(APP_DEBUG, "app_wait_flash_ready failed %d", result);
         return -2;
     }
 
-    //Erase
-    result = app_execute_nvm_command(app, UPDI_NVMCTRL_CTRLA_CHIP_ERASE);
+    app->pbuf_clean = false;
+    result = link_st(LINK(app), address, dummy);
     if (result) {
-        DBG_INFO(APP_DEBUG, "app_execute_nvm_command failed %d", result);
-        return -3;
+        DBG_INFO(APP_DEBUG, "Page buffer load at %X failed %d", address, result);
+        return -4;
     }
 
-    // And wait for it
-    result = app_wait_flash_ready(app, TIMEOUT_WAIT_FLASH_READY);
+    // The erase is waited for by the next operation of the NVM controller
+    result = app_execute_nvm_command(app, UPDI_NVMCTRL_CTRLA_ERASE_PAGE);
     if (result) {
-        DBG_INFO(APP_DEBUG, "app_wait_flash_ready timeout after erase failed %d", result);
-        return -2;
+        DBG_INFO(APP_DEBUG, "app_execute_nvm_command failed %d", result);
+        return -3;
     }
 
     return 0;
@@ -592,27 +787,104 @@ int app_chip_erase(void *app_ptr)
 
     DBG_INFO(APP_DEBUG, "<APP> Chip erase using NVM CTRL");
 
-    //Wait until NVM CTRL is ready to erase
+    //Erase, after the NVM CTRL is ready
+    result = app_execute_nvm_command(app, APP_FLAG(app, DEV_FLAG_NVMCTRL_V2) ? UPDI_V2_NVMCTRL_CTRLA_CHIP_ERASE : UPDI_NVMCTRL_CTRLA_CHIP_ERASE);
+    if (result) {
+        DBG_INFO(APP_DEBUG, "app_execute_nvm_command failed %d", result);
+        return -3;
+    }
+
+    // The NVMCTRL v2 keeps the command until cleared, after the erase is done. Otherwise it's waited for by the next operation
+    if (APP_FLAG(app, DEV_FLAG_NVMCTRL_V2)) {
+        result = app_execute_nvm_command(app, UPDI_V2_NVMCTRL_CTRLA_NOCMD);
+        if (result) {
+            DBG_INFO(APP_DEBUG, "app_execute_nvm_command NOCMD failed %d", result);
+            return -4;
+        }
+    }
+
+    return 0;
+}
+
+/*
+    APP check the flash by the CRCSCAN of the target: the CRC-16 of the whole flash, with the checksum
+        stored in its last 2 bytes, is computed on chip. The scan is polled by ASI_CRC_STATUS,
+        or by CRCSCAN STATUS if the UPDI doesn't report it
+    @app_ptr: APP object pointer, acquired from updi_application_init()
+    @timeout: max scan time in ms
+    @return 0 flash CRC ok, -4 CRC mismatch, other value if failed
+*/
+int app_crc_check(void *app_ptr, int timeout)
+{
+    upd_application_t *app = (upd_application_t *)app_ptr;
+    u16 crcscan;
+    u8 asi = 0, status = 0;
+    int result;
+
+    if (!VALID_APP(app))
+        return ERROR_PTR;
+
+    DBG_INFO(APP_DEBUG, "<APP> CRCSCAN flash check");
+
+    crcscan = APP_REG(app, crcscan_address);
+
+    // The flash must be settled before the scan
     result = app_wait_flash_ready(app, TIMEOUT_WAIT_FLASH_READY);
     if (result) {
-        DBG_INFO(APP_DEBUG, "app_wait_flash_ready timeout before erase failed %d", result);
+        DBG_INFO(APP_DEBUG, "app_wait_flash_ready before CRCSCAN failed %d", result);
         return -2;
     }
 
-    //Erase
-    result = app_execute_nvm_command(app, UPDI_NVMCTRL_CTRLA_CHIP_ERASE);
+    // Reset any previous scan, select the whole flash and start
+    result = link_st(LINK(app), crcscan + UPDI_CRCSCAN_CTRLA, 1 << UPDI_CRCSCAN_CTRLA_RESET);
+    if (!result)
+        result = link_st(LINK(app), crcscan + UPDI_CRCSCAN_CTRLB, UPDI_CRCSCAN_CTRLB_SRC_FLASH);
+    if (!result)
+        result = link_st(LINK(app), crcscan + UPDI_CRCSCAN_CTRLA, 1 << UPDI_CRCSCAN_CTRLA_ENABLE);
     if (result) {
-        DBG_INFO(APP_DEBUG, "app_execute_nvm_command failed %d", result);
+        DBG_INFO(APP_DEBUG, "CRCSCAN start failed %d", result);
+        return -2;
+    }
+
+    do {
+        result = _link_ldcs(LINK(app), UPDI_ASI_CRC_STATUS, &asi);
+        if (!result) {
+            asi &= UPDI_ASI_CRC_STATUS_MASK;
+            if (asi == UPDI_ASI_CRC_STATUS_OK || asi == UPDI_ASI_CRC_STATUS_FAILED)
+                break;
+
+            if (asi == UPDI_ASI_CRC_STATUS_NOT_ENABLED) {
+                result = _link_ld(LINK(app), crcscan + UPDI_CRCSCAN_STATUS, &status);
+                if (!result && !(status & (1 << UPDI_CRCSCAN_STATUS_BUSY)))
+                    break;
+            }
+        }
+
+        if (result) {
+            DBG_INFO(APP_DEBUG, "CRCSCAN status read failed %d", result);
+            return -3;
+        }
+
+        app->stats->app.busy_polls++;
+        msleep(1);
+    } while (--timeout > 0);
+
+    if (timeout <= 0) {
+        DBG_INFO(APP_DEBUG, "Timeout waiting for CRCSCAN, ASI CRC status %02x", asi);
         return -3;
     }
 
-    // And wait for it
-    result = app_wait_flash_ready(app, TIMEOUT_WAIT_FLASH_READY);
+    result = _link_ld(LINK(app), crcscan + UPDI_CRCSCAN_STATUS, &status);
     if (result) {
-        DBG_INFO(APP_DEBUG, "app_wait_flash_ready timeout after erase failed %d", result);
-        return -2;
+        DBG_INFO(APP_DEBUG, "_link_ld CRCSCAN status failed %d", result);
+        return -3;
     }
 
+    DBG_INFO(APP_DEBUG, "CRCSCAN status %02x, ASI CRC status %02x", status, asi);
+
+    if (!(status & (1 << UPDI_CRCSCAN_STATUS_OK)) || asi == UPDI_ASI_CRC_STATUS_FAILED)
+        return -4;
+
     return 0;
 }
 
@@ -624,18 +896,19 @@ int app_chip_erase(void *app_ptr)
     @len: data len
     @return 0 successful, other value if failed
 */
-int app_read_data_words(void *app_ptr, u16 address, u8 *data, int len)
+int app_read_data_words(void *app_ptr, u32 address, u8 *data, int len)
 {
     /*
     Reads a number of words of data from UPDI
     */
     upd_application_t *app = (upd_application_t *)app_ptr;
+    link_frame_t frm;
     int result;
 
     if (!VALID_APP(app) || !VALID_PTR(data) || len < 2)
         return ERROR_PTR;
 
-    DBG_INFO(APP_DEBUG, "<APP> Read words data(%d) addr: %hX", len, address);
+    DBG_INFO(APP_DEBUG, "<APP> Read words data(%d) addr: %X", len, address);
 
     // Special-case of 1 word
     if (len == 2) {
@@ -654,27 +927,17 @@ int app_read_data_words(void *app_ptr, u16 address, u8 *data, int len)
         return -3;
     }
 
-    // Store the address
-    result = link_st_ptr(LINK(app), address);
+    // Store the address, fire up the repeat and do the read(s) in one frame
+    link_frame_init(LINK(app), &frm);
+    link_frame_st_ptr(&frm, address);
+    link_frame_repeat(&frm, (len >> 1) - 1);
+    link_frame_ld_ptr_inc(&frm, data, len, true);
+    result = link_frame_send(&frm);
     if (result) {
-        DBG_INFO(APP_DEBUG, "link_st_ptr failed %d", result);
+        DBG_INFO(APP_DEBUG, "link_frame_send failed %d", result);
         return -4;
     }
 
-    //Fire up the repeat
-    result = link_repeat16(LINK(app), (len >> 1) - 1);
-    if (result) {
-        DBG_INFO(APP_DEBUG, "link_repeat16 failed %d", result);
-        return -5;
-    }
-
-    //Do the read(s)
-    result = link_ld_ptr_inc16(LINK(app), data, len);
-    if (result) {
-        DBG_INFO(APP_DEBUG, "link_ld_ptr_inc16 failed %d", result);
-        return -6;
-    }
-
     return 0;
 }
 
@@ -686,18 +949,19 @@ int app_read_data_words(void *app_ptr, u16 address, u8 *data, int len)
     @len: data len
     @return 0 successful, other value if failed
 */
-int app_read_data_bytes(void *app_ptr, u16 address, u8 *data, int len)
+int app_read_data_bytes(void *app_ptr, u32 address, u8 *data, int len)
 {
     /*
     Reads a number of bytes of data from UPDI
     */
     upd_application_t *app = (upd_application_t *)app_ptr;
+    link_frame_t frm;
     int result;
 
     if (!VALID_APP(app) || !VALID_PTR(data) || len < 1)
         return ERROR_PTR;
 
-    DBG_INFO(APP_DEBUG, "<APP> Read bytes data(%d) addr: %hX", len, address);
+    DBG_INFO(APP_DEBUG, "<APP> Read bytes data(%d) addr: %X", len, address);
 
     // Special-case of 1 byte
     if (len == 1) {
@@ -716,25 +980,75 @@ int app_read_data_bytes(void *app_ptr, u16 address, u8 *data, int len)
         return -3;
     }
 
-    // Store the address
-    result = link_st_ptr(LINK(app), address);
+    // Store the address, fire up the repeat and do the read(s) in one frame
+    link_frame_init(LINK(app), &frm);
+    link_frame_st_ptr(&frm, address);
+    link_frame_repeat(&frm, len - 1);
+    link_frame_ld_ptr_inc(&frm, data, len, false);
+    result = link_frame_send(&frm);
     if (result) {
-        DBG_INFO(APP_DEBUG, "link_st_ptr failed %d", result);
+        DBG_INFO(APP_DEBUG, "link_frame_send failed %d", result);
         return -4;
     }
 
-    //Fire up the repeat
-    result = link_repeat(LINK(app), len - 1);
+    return 0;
+}
+
+/*
+    APP read a block of any length. The pointer is set by the first frame only, each following chunk
+        is a REPEAT and a LD *ptr++, the pointer post-increment carries over from chunk to chunk.
+        The words are read while the address is even, an odd tail byte is read at last
+    @app_ptr: APP object pointer, acquired from updi_application_init()
+    @address: target address
+    @data: data output buffer
+    @len: data len
+    @return 0 successful, other value if failed
+*/
+int app_read_data_block(void *app_ptr, u32 address, u8 *data, int len)
+{
+    upd_application_t *app = (upd_application_t *)app_ptr;
+    link_frame_t frm;
+    bool word;
+    int off, size, units, result;
+
+    if (!VALID_APP(app) || !VALID_PTR(data) || len < 1)
+        return ERROR_PTR;
+
+    DBG_INFO(APP_DEBUG, "<APP> Read block(%d) addr: %X", len, address);
+
+    // The NVM reads back only after the write in progress
+    result = app_wait_flash_ready(app, TIMEOUT_WAIT_FLASH_READY);
     if (result) {
-        DBG_INFO(APP_DEBUG, "link_repeat failed %d", result);
-        return -5;
+        DBG_INFO(APP_DEBUG, "app_wait_flash_ready before read failed %d", result);
+        return -2;
     }
 
-    //Do the read(s)
-    result = link_ld_ptr_inc(LINK(app), data, len);
-    if (result) {
-        DBG_INFO(APP_DEBUG, "link_ld_ptr_inc failed %d", result);
-        return -6;
+    for (off = 0; off < len; off += size) {
+        size = len - off;
+        word = !(address & 0x1) && size >= 2;
+        if (word) {
+            size &= ~0x1;
+            if (size > (UPDI_MAX_REPEAT_SIZE + 1) << 1)
+                size = (UPDI_MAX_REPEAT_SIZE + 1) << 1;
+            units = size >> 1;
+        }
+        else {
+            if (size > UPDI_MAX_REPEAT_SIZE + 1)
+                size = UPDI_MAX_REPEAT_SIZE + 1;
+            units = size;
+        }
+
+        link_frame_init(LINK(app), &frm);
+        if (!off)
+            link_frame_st_ptr(&frm, address);
+        if (units > 1)
+            link_frame_repeat(&frm, units - 1);
+        link_frame_ld_ptr_inc(&frm, data + off, size, word);
+        result = link_frame_send(&frm);
+        if (result) {
+            DBG_INFO(APP_DEBUG, "link_frame_send at %X failed %d", address + off, result);
+            return -3;
+        }
     }
 
     return 0;
@@ -748,7 +1062,7 @@ int app_read_data_bytes(void *app_ptr, u16 address, u8 *data, int len)
     @len: data len
     @return 0 successful, other value if failed
 */
-int app_read_data(void *app_ptr, u16 address, u8 *data, int len)
+int app_read_data(void *app_ptr, u32 address, u8 *data, int len)
 {
     /*
     Reads a number of bytes of data from UPDI
@@ -777,7 +1091,7 @@ int app_read_data(void *app_ptr, u16 address, u8 *data, int len)
     @len: data len
     @return 0 successful, other value if failed
 */
-int app_read_nvm(void *app_ptr, u16 address, u8 *data, int len)
+int app_read_nvm(void *app_ptr, u32 address, u8 *data, int len)
 {
     /*
     Read data from NVM.
@@ -790,6 +1104,12 @@ int app_read_nvm(void *app_ptr, u16 address, u8 *data, int len)
 
     DBG_INFO(APP_DEBUG, "<APP> Chip read nvm");
 
+    result = app_wait_flash_ready(app, TIMEOUT_WAIT_FLASH_READY);
+    if (result) {
+        DBG_INFO(APP_DEBUG, "app_wait_flash_ready before read failed %d", result);
+        return -3;
+    }
+
     // Load to buffer by reading directly to location
     result = app_read_data(app, address, data, len);
     if (result) {
@@ -808,7 +1128,7 @@ int app_read_nvm(void *app_ptr, u16 address, u8 *data, int len)
     @len: data len
     @return 0 successful, other value if failed
 */
-int app_write_data_words(void *app_ptr, u16 address, const u8 *data, int len)
+int app_write_data_words(void *app_ptr, u32 address, const u8 *data, int len)
 {
     /*
         Writes a number of words to memory
@@ -819,7 +1139,7 @@ int app_write_data_words(void *app_ptr, u16 address, const u8 *data, int len)
     if (!VALID_APP(app) || !VALID_PTR(data) || len < 2)
         return ERROR_PTR;
 
-    DBG_INFO(APP_DEBUG, "<APP> Write words data(%d) addr: %hX", len, address);
+    DBG_INFO(APP_DEBUG, "<APP> Write words data(%d) addr: %X", len, address);
     
     // Special-case of 1 word
     if (len == 2) {
@@ -869,7 +1189,7 @@ int app_write_data_words(void *app_ptr, u16 address, const u8 *data, int len)
     @len: data len
     @return 0 successful, other value if failed
 */
-int app_write_data_bytes(void *app_ptr, u16 address, const u8 *data, int len)
+int app_write_data_bytes(void *app_ptr, u32 address, const u8 *data, int len)
 {
     /*
     Writes a number of bytes to memory
@@ -880,7 +1200,7 @@ int app_write_data_bytes(void *app_ptr, u16 address, const u8 *data, int len)
     if (!VALID_APP(app) || !VALID_PTR(data) || len < 1)
         return ERROR_PTR;
 
-    DBG_INFO(APP_DEBUG, "<APP> Write bytes data(%d) addr: %hX", len, address);
+    DBG_INFO(APP_DEBUG, "<APP> Write bytes data(%d) addr: %X", len, address);
 
     // Special-case of 1 byte
     if (len == 1) {
@@ -889,6 +1209,8 @@ int app_write_data_bytes(void *app_ptr, u16 address, const u8 *data, int len)
             DBG_INFO(APP_DEBUG, "link_st16 failed %d", result);
             return -2;
         }
+
+        return 0;
     }
 
     // Range check
@@ -929,7 +1251,7 @@ int app_write_data_bytes(void *app_ptr, u16 address, const u8 *data, int len)
     @use_word_access: whether use 2 bytes mode for writing
     @return 0 successful, other value if failed
 */
-int app_write_data(void *app_ptr, u16 address, const u8 *data, int len, bool use_word_access)
+int app_write_data(void *app_ptr, u32 address, const u8 *data, int len, bool use_word_access)
 {
     /*
     Writes a number of data to memory
@@ -949,6 +1271,192 @@ int app_write_data(void *app_ptr, u16 address, const u8 *data, int len, bool use
     return result;
 }
 
+/*
+    APP load the page buffer with the response signature disabled: ST ptr, REPEAT and the
+        ST ptr++ data are streamed without waiting any ACK, then the pointer register is read back
+        to check that all the data arrived. A write error is reported by NVMCTRL STATUS at commit
+    @app: APP object
+    @address: target address
+    @data: data buffer
+    @len: data len
+    @use_word_access: whether use 2 bytes mode for writing
+    @return 0 successful, other value if failed
+*/
+static int _app_load_page_rsd(upd_application_t *app, u32 address, const u8 *data, int len, bool use_word_access)
+{
+    u32 ptr, end;
+    int result, ret = 0;
+
+    DBG_INFO(APP_DEBUG, "<APP> Load page(%d) addr: %X, RSD", len, address);
+
+    result = link_set_rsd(LINK(app), true);
+    if (result) {
+        DBG_INFO(APP_DEBUG, "link_set_rsd failed %d", result);
+        return -2;
+    }
+
+    result = link_st_ptr(LINK(app), address);
+    if (result) {
+        DBG_INFO(APP_DEBUG, "link_st_ptr failed %d", result);
+        ret = -3;
+        goto out;
+    }
+
+    if (use_word_access) {
+        result = link_repeat16(LINK(app), (len >> 1) - 1);
+        if (!result)
+            result = link_st_ptr_inc16(LINK(app), data, len);
+    }
+    else {
+        result = link_repeat(LINK(app), len - 1);
+        if (!result)
+            result = link_st_ptr_inc(LINK(app), data, len);
+    }
+
+    if (result) {
+        DBG_INFO(APP_DEBUG, "RSD stream failed %d", result);
+        ret = -4;
+    }
+
+out:
+    result = link_set_rsd(LINK(app), false);
+    if (result) {
+        DBG_INFO(APP_DEBUG, "link_set_rsd off failed %d", result);
+        return -5;
+    }
+
+    if (ret)
+        return ret;
+
+    // The pointer register is 16bit wide out of the 24bit address mode
+    end = address + len;
+    if (!APP_FLAG(app, DEV_FLAG_ADDRESS_24))
+        end &= 0xFFFF;
+
+    result = link_ld_ptr(LINK(app), &ptr);
+    if (result || ptr != end) {
+        DBG_INFO(APP_DEBUG, "RSD load incomplete(%d), ptr %X expected %X", result, ptr, end);
+        return -6;
+    }
+
+    return 0;
+}
+
+/*
+    APP load the data to the page buffer, or to the NVM directly with the NVMCTRL v2
+    @app: APP object
+    @address: target address
+    @data: data buffer
+    @len: data len
+    @use_word_access: whether use 2 bytes mode for writing
+    @return 0 successful, other value if failed
+*/
+static int _app_load_page(upd_application_t *app, u32 address, const u8 *data, int len, bool use_word_access)
+{
+    int result;
+
+    result = app_wait_flash_ready(app, TIMEOUT_WAIT_FLASH_READY);
+    if (result) {
+        DBG_INFO(APP_DEBUG, "app_wait_flash_ready before page load failed %d", result);
+        return -2;
+    }
+
+#ifndef DISABLE_RSD
+    if (len > (use_word_access ? 2 : 1) && len <= ((UPDI_MAX_REPEAT_SIZE + 1) << use_word_access))
+        return _app_load_page_rsd(app, address, data, len, use_word_access);
+#endif
+
+    return app_write_data(app, address, data, len, use_word_access);
+}
+
+/*
+    APP check whether a write doesn't cover a whole page of its NVM block
+    @app: APP object
+    @address: target address
+    @len: data len
+    @return true if partial
+*/
+static bool _app_page_partial(upd_application_t *app, u32 address, int len)
+{
+    const chip_info_t *map = app->dev->mmap;
+    const nvm_info_t *blocks[] = { &map->flash, &map->eeprom, &map->userrow };
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(blocks); i++) {
+        if (address >= blocks[i]->nvm_start && address < blocks[i]->nvm_start + blocks[i]->nvm_size)
+            return (address - blocks[i]->nvm_start) % blocks[i]->nvm_pagesize || len != (int)blocks[i]->nvm_pagesize;
+    }
+
+    return true;
+}
+
+/*
+    APP write nvm with the NVMCTRL v2: there is no page buffer, the command is set in CTRLA
+        and kept while the data are stored to the NVM, then cleared by NOCMD.
+        The flash is written by FLWR, erased by FLPER first if asked, the other blocks by EEERWR byte by byte
+    @app: APP object
+    @address: target address
+    @data: data buffer
+    @len: data len
+    @erase: erase the flash page before writing
+    @use_word_access: whether use 2 bytes mode for writing
+    @return 0 successful, other value if failed
+*/
+static int _app_write_nvm_v2(upd_application_t *app, u32 address, const u8 *data, int len, bool erase, bool use_word_access)
+{
+    const nvm_info_t *flash = &app->dev->mmap->flash;
+    bool is_flash = address >= flash->nvm_start && address < flash->nvm_start + flash->nvm_size;
+    int i, result, ret = 0;
+
+    if (is_flash && erase) {
+        // Page erase is triggered by a dummy write to the page, waited for by the write command
+        result = app_execute_nvm_command(app, UPDI_V2_NVMCTRL_CTRLA_FLASH_PAGE_ERASE);
+        if (!result)
+            result = app_write_data_bytes(app, address, data, 1);
+        _app_nvm_busy(app, APP_V2_PAGE_ERASE_TIME);
+        if (result) {
+            DBG_INFO(APP_DEBUG, "Page erase at %X failed %d", address, result);
+            ret = -3;
+            goto out;
+        }
+    }
+
+    result = app_execute_nvm_command(app, is_flash ? UPDI_V2_NVMCTRL_CTRLA_FLASH_WRITE : UPDI_V2_NVMCTRL_CTRLA_EEPROM_ERASE_WRITE);
+    if (result) {
+        DBG_INFO(APP_DEBUG, "app_execute_nvm_command write failed %d", result);
+        ret = -4;
+        goto out;
+    }
+
+    if (is_flash) {
+        result = _app_load_page(app, address, data, len, use_word_access);
+        _app_nvm_busy(app, APP_V2_FLASH_WRITE_TIME);
+    }
+    else {
+        // The EEPROM cells are written one by one, each after the last one is done
+        for (i = 0; i < len && !result; i++) {
+            result = app_wait_flash_ready(app, TIMEOUT_WAIT_FLASH_READY);
+            if (!result)
+                result = app_write_data_bytes(app, address + i, data + i, 1);
+            _app_nvm_busy(app, APP_V2_EEPROM_WRITE_TIME);
+        }
+    }
+    if (result) {
+        DBG_INFO(APP_DEBUG, "page load failed %d", result);
+        ret = -5;
+    }
+
+out:
+    // NOCMD is sent after the write is done
+    result = app_execute_nvm_command(app, UPDI_V2_NVMCTRL_CTRLA_NOCMD);
+    if (result) {
+        DBG_INFO(APP_DEBUG, "app_execute_nvm_command NOCMD failed %d", result);
+        return -8;
+    }
+
+    return ret;
+}
+
 /*
     APP write nvm
     @app_ptr: APP object pointer, acquired from updi_application_init()
@@ -958,13 +1466,14 @@ int app_write_data(void *app_ptr, u16 address, const u8 *data, int len, bool use
     @nvm_command: programming command
     @return 0 successful, other value if failed
 */
-int _app_write_nvm(void *app_ptr, u16 address, const u8 *data, int len, u8 nvm_command, bool use_word_access)
+int _app_write_nvm(void *app_ptr, u32 address, const u8 *data, int len, u8 nvm_command, bool use_word_access)
 {
     /*
         Writes a page of data to NVM.
         By default the PAGE_WRITE command is used, which requires that the page is already erased.
     */
     upd_application_t *app = (upd_application_t *)app_ptr;
+    ULONGLONG start;
     int result;
 
     if (!VALID_APP(app))
@@ -972,34 +1481,33 @@ int _app_write_nvm(void *app_ptr, u16 address, const u8 *data, int len, u8 nvm_c
 
     DBG_INFO(APP_DEBUG, "<APP> Chip write nvm");
 
-    // Check that NVM controller is ready
-    result = app_wait_flash_ready(app, TIMEOUT_WAIT_FLASH_READY);
-    if (result) {
-        DBG_INFO(APP_DEBUG, "app_wait_flash_ready timeout before page buffer clear failed %d", result);
-        return -2;
-    }
+    start = clock_us();
 
-    // Erase write command will clear the buffer automantic
-    
-    //Clear the page buffer
-    DBG_INFO(APP_DEBUG, "Clear page buffer");
-    result = app_execute_nvm_command(app, UPDI_NVMCTRL_CTRLA_PAGE_BUFFER_CLR);
-    if (result) {
-        DBG_INFO(APP_DEBUG, "app_execute_nvm_command failed %d", UPDI_NVMCTRL_CTRLA_PAGE_BUFFER_CLR, result);
-        return -3;
+    if (APP_FLAG(app, DEV_FLAG_NVMCTRL_V2)) {
+        result = _app_write_nvm_v2(app, address, data, len, nvm_command == UPDI_NVMCTRL_CTRLA_ERASE_WRITE_PAGE, use_word_access);
+        if (result)
+            return result;
+
+        goto done;
     }
 
-    // Waif for NVM controller to be ready
-    result = app_wait_flash_ready(app, TIMEOUT_WAIT_FLASH_READY);
-    if (result) {
-        DBG_INFO(APP_DEBUG, "app_wait_flash_ready timeout after page buffer clear failed %d", result);
-        return -4;
+    // The page write commands clear the buffer automantic, so a whole page is loaded to a clean buffer.
+    // Clear the page buffer if a partial page is loaded or the buffer state is unknown
+    if (!app->pbuf_clean || _app_page_partial(app, address, len)) {
+        DBG_INFO(APP_DEBUG, "Clear page buffer");
+        result = app_execute_nvm_command(app, UPDI_NVMCTRL_CTRLA_PAGE_BUFFER_CLR);
+        if (result) {
+            DBG_INFO(APP_DEBUG, "app_execute_nvm_command failed %d", UPDI_NVMCTRL_CTRLA_PAGE_BUFFER_CLR, result);
+            app->pbuf_clean = false;
+            return -3;
+        }
     }
-    
+    app->pbuf_clean = false;
+
     // Load the page buffer by writing directly to location
-    result = app_write_data(app, address, data, len, use_word_access);
+    result = _app_load_page(app, address, data, len, use_word_access);
     if (result) {
-        DBG_INFO(APP_DEBUG, "app_write_data failed %d", result);
+        DBG_INFO(APP_DEBUG, "page load failed %d", result);
         return -5;
     }
 
@@ -1011,12 +1519,12 @@ int _app_write_nvm(void *app_ptr, u16 address, const u8 *data, int len, u8 nvm_c
         return -6;
     }
 
-    // Waif for NVM controller to be ready again
-    result = app_wait_flash_ready(app, TIMEOUT_WAIT_FLASH_READY);
-    if (result) {
-        DBG_INFO(APP_DEBUG, "app_wait_flash_ready timeout after page write failed %d", result);
-        return -7;
-    }
+    // The page write is waited for by the next operation of the NVM controller
+    app->pbuf_clean = true;
+
+done:
+    app->stats->app.page_writes++;
+    stats_hist_add(&app->stats->page_write, clock_us() - start);
 
     return 0;
 }
@@ -1029,7 +1537,7 @@ int _app_write_nvm(void *app_ptr, u16 address, const u8 *data, int len, u8 nvm_c
     @len: data len
     @return 0 successful, other value if failed
 */
-int app_write_nvm(void *app_ptr, u16 address, const u8 *data, int len)
+int app_write_nvm(void *app_ptr, u32 address, const u8 *data, int len)
 {
     bool use_word_access = !(len & 0x1);
 
@@ -1045,7 +1553,7 @@ int app_write_nvm(void *app_ptr, u16 address, const u8 *data, int len)
     @use_word_access: 2 bytes mode for writting
     @return 0 successful, other value if failed
 */
-int _app_erase_write_nvm(void *app_ptr, u16 address, const u8 *data, int len, bool use_word_access)
+int _app_erase_write_nvm(void *app_ptr, u32 address, const u8 *data, int len, bool use_word_access)
 {
     return _app_write_nvm(app_ptr, address, data, len, UPDI_NVMCTRL_CTRLA_ERASE_WRITE_PAGE, use_word_access);
 }
@@ -1058,7 +1566,7 @@ int _app_erase_write_nvm(void *app_ptr, u16 address, const u8 *data, int len, bo
     @len: data len
     @return 0 successful, other value if failed
 */
-int app_erase_write_nvm(void *app_ptr, u16 address, const u8 *data, int len)
+int app_erase_write_nvm(void *app_ptr, u32 address, const u8 *data, int len)
 {
     bool use_word_access = !(len & 0x1);
 
@@ -1073,7 +1581,7 @@ int app_erase_write_nvm(void *app_ptr, u16 address, const u8 *data, int len)
     @len: data len
     @return 0 successful, other value if failed
 */
-int app_ld_reg(void *app_ptr, u16 address, u8* data, int len)
+int app_ld_reg(void *app_ptr, u32 address, u8* data, int len)
 {
     /*
         Load reg data
@@ -1100,7 +1608,7 @@ int app_ld_reg(void *app_ptr, u16 address, u8* data, int len)
     @len: data len
     @return 0 successful, other value if failed
 */
-int app_st_reg(void *app_ptr, u16 address, const u8 *data, int len)
+int app_st_reg(void *app_ptr, u32 address, const u8 *data, int len)
 {
     /*
         Set reg data
@@ -1118,4 +1626,95 @@ int app_st_reg(void *app_ptr, u16 address, const u8 *data, int len)
     }
 
     return 0;
-}
\ No newline at end of file
+}
+/*
+    APP get the serial number of the chip, read by app_device_info() in Unlocked Mode
+    @app_ptr: APP object pointer, acquired from updi_application_init()
+    @data: output buffer
+    @len: buffer size
+    @return bytes of the serial number, negative value if failed
+*/
+int app_get_serial(void *app_ptr, u8 *data, int len)
+{
+    upd_application_t *app = (upd_application_t *)app_ptr;
+
+    if (!VALID_APP(app))
+        return ERROR_PTR;
+
+    if (!app->has_sigrow) {
+        DBG_INFO(APP_DEBUG, "SIGROW not read");
+        return -2;
+    }
+
+    if (len < app->sernum_len)
+        return -3;
+
+    memcpy(data, app->sernum, app->sernum_len);
+
+    return app->sernum_len;
+}
+
+/*
+    APP get performance counters
+    @app_ptr: APP object pointer, acquired from updi_application_init()
+    @return counters of the stack, NULL if failed
+*/
+upd_stats_t *app_get_stats(void *app_ptr)
+{
+    upd_application_t *app = (upd_application_t *)app_ptr;
+
+    if (!VALID_APP(app))
+        return NULL;
+
+    return app->stats;
+}
+
+/*
+    APP apply link timing settings
+    @app_ptr: APP object pointer, acquired from updi_application_init()
+    @tm: timing settings
+    @return 0 successful, other value if failed
+*/
+int app_set_timing(void *app_ptr, const link_timing_t *tm)
+{
+    upd_application_t *app = (upd_application_t *)app_ptr;
+
+    if (!VALID_APP(app))
+        return ERROR_PTR;
+
+    return link_set_timing(LINK(app), tm);
+}
+
+/*
+    APP get link timing settings
+    @app_ptr: APP object pointer, acquired from updi_application_init()
+    @tm: output timing settings
+    @return 0 successful, other value if failed
+*/
+int app_get_timing(void *app_ptr, link_timing_t *tm)
+{
+    upd_application_t *app = (upd_application_t *)app_ptr;
+
+    if (!VALID_APP(app))
+        return ERROR_PTR;
+
+    return link_get_timing(LINK(app), tm);
+}
+
+/*
+    APP calibrate link timing
+    @app_ptr: APP object pointer, acquired from updi_application_init()
+    @tm: output timing settings applied
+    @return 0 successful, other value if failed
+*/
+int app_calibrate(void *app_ptr, link_timing_t *tm)
+{
+    upd_application_t *app = (upd_application_t *)app_ptr;
+
+    if (!VALID_APP(app))
+        return ERROR_PTR;
+
+    DBG_INFO(APP_DEBUG, "<APP> Calibrate link");
+
+    return link_calibrate(LINK(app), LINK_CALIBRATE_PROBES, tm);
+}
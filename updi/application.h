@@ -1,7 +1,7 @@
 #ifndef __UD_APPLICATION_H
 #define __UD_APPLICATION_H
 
-void *updi_application_init(const char *port, int baud, void *dev);
+void *updi_application_init(const char *port, int baud, void *dev, bool fast);
 void updi_application_deinit(void *app_ptr);
 int app_device_info(void *app_ptr);
 bool app_in_prog_mode(void *app_ptr);
@@ -15,22 +15,35 @@ int app_toggle_reset(void *app_ptr, int delay);
 int app_wait_flash_ready(void *app_ptr, int timeout);
 int app_execute_nvm_command(void *app_ptr, u8 command);
 int app_chip_erase(void *app_ptr);
-int app_read_data_bytes(void *app_ptr, u16 address, u8 *data, int len);
-int app_read_data_words(void *app_ptr, u16 address, u8 *data, int len);
-int app_read_data(void *app_ptr, u16 address, u8 *data, int len);
-int app_read_nvm(void *app_ptr, u16 address, u8 *data, int len);
-int app_write_data_words(void *app_ptr, u16 address, const u8 *data, int len);
-int app_write_data_bytes(void *app_ptr, u16 address, const u8 *data, int len);
-int app_write_data(void *app_ptr, u16 address, const u8 *data, int len, bool use_word_access);
-int app_write_nvm(void *app_ptr, u16 address, const u8 *data, int len);
-int _app_erase_write_nvm(void *app_ptr, u16 address, const u8 *data, int len, bool use_word_access);
-int app_erase_write_nvm(void *app_ptr, u16 address, const u8 *data, int len);
-int app_ld_reg(void *app_ptr, u16 address, u8* data, int len);
-int app_st_reg(void *app_ptr, u16 address, const u8 *data, int len);
+int app_page_erase(void *app_ptr, u32 address);
+int app_crc_check(void *app_ptr, int timeout);
+int app_read_data_bytes(void *app_ptr, u32 address, u8 *data, int len);
+int app_read_data_words(void *app_ptr, u32 address, u8 *data, int len);
+int app_read_data(void *app_ptr, u32 address, u8 *data, int len);
+int app_read_data_block(void *app_ptr, u32 address, u8 *data, int len);
+int app_read_nvm(void *app_ptr, u32 address, u8 *data, int len);
+int app_write_data_words(void *app_ptr, u32 address, const u8 *data, int len);
+int app_write_data_bytes(void *app_ptr, u32 address, const u8 *data, int len);
+int app_write_data(void *app_ptr, u32 address, const u8 *data, int len, bool use_word_access);
+int app_write_nvm(void *app_ptr, u32 address, const u8 *data, int len);
+int _app_erase_write_nvm(void *app_ptr, u32 address, const u8 *data, int len, bool use_word_access);
+int app_erase_write_nvm(void *app_ptr, u32 address, const u8 *data, int len);
+int app_ld_reg(void *app_ptr, u32 address, u8* data, int len);
+int app_st_reg(void *app_ptr, u32 address, const u8 *data, int len);
+int app_get_serial(void *app_ptr, u8 *data, int len);
+upd_stats_t *app_get_stats(void *app_ptr);
+int app_set_timing(void *app_ptr, const link_timing_t *tm);
+int app_get_timing(void *app_ptr, link_timing_t *tm);
+int app_calibrate(void *app_ptr, link_timing_t *tm);
 
 /*
 Max waiting time at flash programming
 */
 #define TIMEOUT_WAIT_FLASH_READY 1000
 
+/*
+Max waiting time of the CRCSCAN over the whole flash
+*/
+#define TIMEOUT_WAIT_CRCSCAN 1000
+
 #endif
\ No newline at end of file
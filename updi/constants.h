@@ -19,9 +19,11 @@
 
 #define UPDI_ADDRESS_8  0x00
 #define UPDI_ADDRESS_16  0x04
+#define UPDI_ADDRESS_24  0x08
 
 #define UPDI_DATA_8  0x00
 #define UPDI_DATA_16  0x01
+#define UPDI_DATA_24  0x02
 
 #define UPDI_KEY_SIB  0x04
 #define UPDI_KEY_KEY  0x00
@@ -57,6 +59,15 @@
 #define UPDI_ASI_CTRLA_CLKSEL_16M 0x1
 
 #define UPDI_CTRLA_IBDLY_BIT  7
+#define UPDI_CTRLA_RSD_BIT  3
+#define UPDI_CTRLA_GTVAL_MASK  0x7
+#define UPDI_CTRLA_GTVAL_128  0x0   //guard time 128 cycles(default)
+#define UPDI_CTRLA_GTVAL_64  0x1
+#define UPDI_CTRLA_GTVAL_32  0x2
+#define UPDI_CTRLA_GTVAL_16  0x3
+#define UPDI_CTRLA_GTVAL_8  0x4
+#define UPDI_CTRLA_GTVAL_4  0x5
+#define UPDI_CTRLA_GTVAL_2  0x6
 #define UPDI_CTRLB_CCDETDIS_BIT  3
 #define UPDI_CTRLB_UPDIDIS_BIT  2
 
@@ -103,4 +114,33 @@
 #define UPDI_NVM_STATUS_EEPROM_BUSY  1
 #define UPDI_NVM_STATUS_FLASH_BUSY  0
 
+// CTRLA of the NVMCTRL v2(AVR DA/DB), the command is kept until cleared by NOCMD
+#define UPDI_V2_NVMCTRL_CTRLA_NOCMD  0x00
+#define UPDI_V2_NVMCTRL_CTRLA_NOOP  0x01
+#define UPDI_V2_NVMCTRL_CTRLA_FLASH_WRITE  0x02
+#define UPDI_V2_NVMCTRL_CTRLA_FLASH_PAGE_ERASE  0x08
+#define UPDI_V2_NVMCTRL_CTRLA_EEPROM_ERASE_WRITE  0x13
+#define UPDI_V2_NVMCTRL_CTRLA_CHIP_ERASE  0x20
+
+#define UPDI_V2_NVM_STATUS_ERROR_MASK  0x70
+
+// CRCSCAN
+#define UPDI_CRCSCAN_CTRLA  0x00
+#define UPDI_CRCSCAN_CTRLB  0x01
+#define UPDI_CRCSCAN_STATUS  0x02
+
+#define UPDI_CRCSCAN_CTRLA_RESET  7
+#define UPDI_CRCSCAN_CTRLA_ENABLE  0
+#define UPDI_CRCSCAN_CTRLB_SRC_FLASH  0x00
+
+#define UPDI_CRCSCAN_STATUS_OK  1
+#define UPDI_CRCSCAN_STATUS_BUSY  0
+
+// ASI_CRC_STATUS
+#define UPDI_ASI_CRC_STATUS_MASK  0x07
+#define UPDI_ASI_CRC_STATUS_NOT_ENABLED  0x00
+#define UPDI_ASI_CRC_STATUS_BUSY  0x01
+#define UPDI_ASI_CRC_STATUS_OK  0x02
+#define UPDI_ASI_CRC_STATUS_FAILED  0x04
+
 #endif
\ No newline at end of file
@@ -16,19 +16,36 @@ limitations under the License.
 */
 
 #include "os/platform.h"
+#include "stats.h"
 #include "physical.h"
 #include "link.h"
 #include "constants.h"
+#include "trace.h"
 
 /*
     LINK level memory struct
     @mgwd: magicword
     @phy: pointer to phy object
+    @stats: performance counters, kept by the phy object
+    @ctrla: shadow of UPDI CS CTRLA(guard time and inter-byte delay), restored after each BREAK
+    @baud: working baudrate
+    @rsd: response signature disabled by link_set_rsd(), the ST instructions are not acknowledged
+    @asize: address size of the LDS/STS and ST ptr instructions, UPDI_ADDRESS_16 or UPDI_ADDRESS_24
+    @cs/cs_valid: shadow of the stable bits of the CS/ASI registers and the mask of the registers held, see _link_cs_stable()
+    @cs_breaks: phy BREAK count the shadow was taken at, a BREAK resets the UPDI registers
 */
 typedef struct _upd_datalink {
 #define UPD_DATALINK_MAGIC_WORD 0xC3C3 //'ulin'
     unsigned int mgwd;  //magic word
     void *phy;
+    upd_stats_t *stats;
+    u8 ctrla;
+    int baud;
+    bool rsd;
+    u8 asize;
+    u8 cs[16];
+    u16 cs_valid;
+    u32 cs_breaks;
 }upd_datalink_t;
 
 /*
@@ -39,13 +56,182 @@ typedef struct _upd_datalink {
 #define VALID_LINK(_link) ((_link) && ((_link)->mgwd == UPD_DATALINK_MAGIC_WORD))
 #define PHY(_link) ((_link)->phy)
 
+/*
+    Address field of the current address mode
+    @LINK_ADDRESS_24(): 24bit address mode
+    @LINK_PTR_SIZE(): data size of the ST/LD ptr instructions
+    @LINK_ADDRESS_MAX: max address bytes
+*/
+#define LINK_ADDRESS_24(_link) ((_link)->asize == UPDI_ADDRESS_24)
+#define LINK_PTR_SIZE(_link) (LINK_ADDRESS_24(_link) ? UPDI_DATA_24 : UPDI_DATA_16)
+#define LINK_ADDRESS_MAX 3
+
+/*
+    Start a LINK instruction, counted and tagged to the wire trace
+*/
+static void _link_op(upd_datalink_t *link, TRACE_LINK_OP_T op)
+{
+    link->stats->link.instructions++;
+    trace_link_op(op);
+}
+
+/*
+    Stable bits of a CS/ASI register: the ones only changed by a STCS, a key, a reset request or a BREAK,
+        which could be served from the shadow. The other bits are volatile and always loaded
+    @address: reg address
+    @return bit mask, 0 if the register is not kept in the shadow
+*/
+static u8 _link_cs_stable(u8 address)
+{
+    switch (address) {
+    case UPDI_CS_STATUSA:   //UPDI revision
+    case UPDI_CS_CTRLA:
+    case UPDI_CS_CTRLB:
+    case UPDI_ASI_CTRLA:
+        return 0xFF;
+    case UPDI_ASI_SYS_STATUS:
+        return (1 << UPDI_ASI_SYS_STATUS_NVMPROG) | (1 << UPDI_ASI_SYS_STATUS_UROWPROG) | (1 << UPDI_ASI_SYS_STATUS_LOCKSTATUS);
+    default:
+        return 0;
+    }
+}
+
+/*
+    Drop registers from the CS shadow
+    @link: LINK object
+    @mask: bit mask of the reg addresses, 0xFFFF for all
+*/
+static void _link_cs_invalidate(upd_datalink_t *link, u16 mask)
+{
+    link->cs_valid &= ~mask;
+}
+
+/*
+    Check whether a register is held by the CS shadow, the whole shadow is dropped after a BREAK
+    @link: LINK object
+    @address: reg address
+    @return true if held
+*/
+static bool _link_cs_cached(upd_datalink_t *link, u8 address)
+{
+    if (link->cs_breaks != link->stats->phy.breaks) {
+        link->cs_breaks = link->stats->phy.breaks;
+        _link_cs_invalidate(link, 0xFFFF);
+    }
+
+    return !!(link->cs_valid & (1 << (address & 0x0F)));
+}
+
+/*
+    Update the CS shadow with a register value loaded or stored, and drop the registers changed by its side effect
+    @link: LINK object
+    @address: reg address
+    @value: reg value
+    @store: the value is stored by STCS
+*/
+static void _link_cs_update(upd_datalink_t *link, u8 address, u8 value, bool store)
+{
+    u8 stable = _link_cs_stable(address);
+
+    _link_cs_cached(link, address);
+
+    address &= 0x0F;
+    if (store) {
+        if (address == UPDI_ASI_RESET_REQ)
+            _link_cs_invalidate(link, (1 << UPDI_ASI_KEY_STATUS) | (1 << UPDI_ASI_SYS_STATUS));
+        else if (address == UPDI_CS_CTRLB && (value & (1 << UPDI_CTRLB_UPDIDIS_BIT)))
+            stable = 0; //the UPDI is reset by disable
+        
+        if (!stable) {
+            _link_cs_invalidate(link, address == UPDI_CS_CTRLB ? 0xFFFF : (1 << address));
+            return;
+        }
+    }
+    else if (!stable || (address == UPDI_ASI_SYS_STATUS && (value & (1 << UPDI_ASI_SYS_STATUS_RSTSYS)))) {
+        //The status is not settled in reset
+        return;
+    }
+
+    link->cs[address] = value & stable;
+    link->cs_valid |= (1 << address);
+}
+
+/*
+    Build an instruction with address operand, in the current address mode
+    @link: LINK object
+    @cmd: output buffer, at least 2 + LINK_ADDRESS_MAX bytes
+    @opcode: instruction, with the size field
+    @address: address operand
+    @return instruction length
+*/
+static int _link_addr_cmd(const upd_datalink_t *link, u8 *cmd, u8 opcode, u32 address)
+{
+    int len = 0;
+
+    cmd[len++] = UPDI_PHY_SYNC;
+    cmd[len++] = opcode;
+    cmd[len++] = address & 0xFF;
+    cmd[len++] = (address >> 8) & 0xFF;
+    if (LINK_ADDRESS_24(link))
+        cmd[len++] = (address >> 16) & 0xFF;
+
+    return len;
+}
+
+/*
+    LINK attach to an UPDI left enabled by a previous session, at the working baudrate and
+    without BREAK: the CS registers must read back as configured by link_set_init()
+    @link: LINK object
+    @return 0 successful, other value if the target needs the full init
+*/
+static int _link_attach(upd_datalink_t *link)
+{
+    u8 statusa, ctrlb, ctrla, sys;
+    int result;
+
+    DBG_INFO(LINK_DEBUG, "<LINK> Fast attach at %d", link->baud);
+
+    result = _link_ldcs(link, UPDI_CS_STATUSA, &statusa);
+    if (result || !statusa) {
+        DBG_INFO(LINK_DEBUG, "UPDI not enabled(%d), status 0x%02x", result, statusa);
+        return -2;
+    }
+
+    result = _link_ldcs(link, UPDI_CS_CTRLB, &ctrlb);
+    if (result || ctrlb != (1 << UPDI_CTRLB_CCDETDIS_BIT)) {
+        DBG_INFO(LINK_DEBUG, "UPDI not initialized(%d), CTRLB 0x%02x", result, ctrlb);
+        return -3;
+    }
+
+    result = _link_ldcs(link, UPDI_CS_CTRLA, &ctrla);
+    if (result || (ctrla & (1 << UPDI_CTRLA_RSD_BIT))) {
+        DBG_INFO(LINK_DEBUG, "UPDI CTRLA not usable(%d), CTRLA 0x%02x", result, ctrla);
+        return -4;
+    }
+
+    result = _link_ldcs(link, UPDI_ASI_SYS_STATUS, &sys);
+    if (result) {
+        DBG_INFO(LINK_DEBUG, "_link_ldcs ASI_SYS_STATUS failed %d", result);
+        return -5;
+    }
+
+    // Keep the guard time and inter-byte delay the target is running with
+    link->ctrla = ctrla;
+
+    DBG_INFO(LINK_DEBUG, "UPDI attached (%02x), CTRLA %02x, NVMPROG %d", statusa, ctrla,
+        !!(sys & (1 << UPDI_ASI_SYS_STATUS_NVMPROG)));
+
+    return 0;
+}
+
 /*
     LINK object init
     @port: serial port name of Window or Linux
     @baud: baudrate
+    @fast: try to attach to an already enabled UPDI at @baud first, skipping the BREAK and clock setup
     @return LINK ptr, NULL if failed
 */
-void *updi_datalink_init(const char *port, int baud)
+void *updi_datalink_init(const char *port, int baud, bool fast)
 {
     upd_datalink_t *link = NULL;
     void *phy;
@@ -53,16 +239,36 @@ void *updi_datalink_init(const char *port, int baud)
 
     DBG_INFO(LINK_DEBUG, "<LINK> init link");
     
-    phy = updi_physical_init(port, 115200);  //default baudrate first
+    phy = updi_physical_init(port, fast ? baud : 115200, !fast);  //default baudrate first
     if (phy) {
         link = (upd_datalink_t *)malloc(sizeof(*link));
         link->mgwd = UPD_DATALINK_MAGIC_WORD;
         link->phy = (void *)phy;
+        link->stats = phy_get_stats(phy);
+#ifdef DISABLE_INTER_BYTE
+        link->ctrla = 1 << UPDI_CTRLA_IBDLY_BIT;
+#else
+        link->ctrla = 0;
+#endif
+        link->baud = baud;
+        link->rsd = false;
+        link->asize = UPDI_ADDRESS_16;
+        link->cs_valid = 0;
+        link->cs_breaks = link->stats->phy.breaks;
+
+        if (fast) {
+            if (!_link_attach(link))
+                return link;
+
+            // Not live, the full init from BREAK
+            phy_send_double_break(phy);
+        }
 
         do {
           result = link_set_init(link, baud);
           if (result) {
               DBG_INFO(LINK_DEBUG, "link_set_init failed %d, retry=%d", result, retry);
+              link->stats->link.retries++;
               phy_send_double_break(phy);
               continue;
           }
@@ -70,6 +276,7 @@ void *updi_datalink_init(const char *port, int baud)
           result = link_check(link);
           if (result) {
               DBG_INFO(LINK_DEBUG, "link_check failed %d, retry=%d", result, retry);
+              link->stats->link.retries++;
               phy_send_double_break(phy);
               continue;
           }
@@ -117,6 +324,9 @@ int link_set_init(void *link_ptr, int baud)
 
     DBG_INFO(LINK_DEBUG, "<LINK> link set init");
 
+    // BREAK clears the RSD bit
+    link->rsd = false;
+
     result = phy_set_baudrate(PHY(link), 115200);
     if (result) {
         DBG_INFO(LINK_DEBUG, "phy_set_baudrate default failed %d", result);
@@ -131,15 +341,15 @@ int link_set_init(void *link_ptr, int baud)
         return -3;
     }
     
-    // Set the inter-byte delay bit
-#ifdef DISABLE_INTER_BYTE
-    DBG_INFO(LINK_DEBUG, "<LINK> Set the inter-byte delay bit");
-    result = link_stcs(link, UPDI_CS_CTRLA, 1 << UPDI_CTRLA_IBDLY_BIT);
-    if (result) {
-        DBG_INFO(LINK_DEBUG, "link_stcs UPDI_CS_CTRLA failed %d", result);
-        return -4;
+    // Set the inter-byte delay bit and the guard time, CTRLA is reset to 0 by BREAK
+    if (link->ctrla) {
+        DBG_INFO(LINK_DEBUG, "<LINK> Set CTRLA %02x", link->ctrla);
+        result = link_stcs(link, UPDI_CS_CTRLA, link->ctrla);
+        if (result) {
+            DBG_INFO(LINK_DEBUG, "link_stcs UPDI_CS_CTRLA failed %d", result);
+            return -4;
+        }
     }
-#endif
 
     // Set baudrate and clock
     if (baud <= 225000) {
@@ -152,13 +362,13 @@ int link_set_init(void *link_ptr, int baud)
         clksel = UPDI_ASI_CTRLA_CLKSEL_16M;
     }
     else {
-        DBG_INFO(LINK_DEBUG, "Unsupported baudrate for UPDI clk %d, max 0.9Mhz", baud);
+        DBG_INFO(LINK_DEBUG, "Unsupported baudrate for UPDI clk %d, max 900Khz", baud);
         return -6;
     }
 
     // Set clock source
     DBG_INFO(LINK_DEBUG, "<LINK> Check and set clock source to %d", clksel);
-    result = _link_ldcs(link_ptr, UPDI_ASI_CTRLA, &resp);
+    result = link_ldcs_stable(link_ptr, UPDI_ASI_CTRLA, &resp);
     if (result) {
         DBG_INFO(LINK_DEBUG, "_link_ldcs failed %d", result);
         return -7;
@@ -178,6 +388,8 @@ int link_set_init(void *link_ptr, int baud)
         return -9;
     }
 
+    link->baud = baud;
+
     return 0;
 }
 
@@ -229,7 +441,7 @@ int link_check(void *link_ptr)
 }
 
 /*
-    LINK read udpi control register
+    LINK read udpi control register, always loaded from the target and the shadow updated
     @link_ptr: APP object pointer, acquired from updi_datalink_init()
     @address: reg address
     @data: output 8bit buffer
@@ -249,6 +461,8 @@ int _link_ldcs(void *link_ptr, u8 address, u8 *data)
     if (!VALID_LINK(link) || !data)
         return ERROR_PTR;
 
+    _link_op(link, TRACE_LINK_LDCS);
+
     DBG_INFO(LINK_DEBUG, "<LINK> LDCS from 0x%02x", address);
     result = phy_transfer(PHY(link), cmd, sizeof(cmd), &resp, sizeof(resp));
     if (result != sizeof(resp)) {
@@ -256,12 +470,45 @@ int _link_ldcs(void *link_ptr, u8 address, u8 *data)
         return -2;
     }
 
-    
+    _link_cs_update(link, address, resp, false);
+
     *data = resp;
 
     return 0;
 }
 
+/*
+    LINK read the stable bits of udpi control register, served from the shadow if held there,
+        the volatile bits(see _link_cs_stable()) are returned as 0
+    @link_ptr: APP object pointer, acquired from updi_datalink_init()
+    @address: reg address
+    @data: output 8bit buffer
+    @return 0 successful, other value if failed
+*/
+int link_ldcs_stable(void *link_ptr, u8 address, u8 *data)
+{
+    upd_datalink_t *link = (upd_datalink_t *)link_ptr;
+    int result;
+
+    if (!VALID_LINK(link) || !data)
+        return ERROR_PTR;
+
+    if (_link_cs_cached(link, address)) {
+        DBG_INFO(LINK_DEBUG, "<LINK> LDCS 0x%02x from shadow", address);
+        link->stats->link.cs_hits++;
+        *data = link->cs[address & 0x0F];
+        return 0;
+    }
+
+    result = _link_ldcs(link, address, data);
+    if (result)
+        return result;
+
+    *data &= _link_cs_stable(address);
+
+    return 0;
+}
+
 /*
     LINK read udpi control register capsule
     @link_ptr: APP object pointer, acquired from updi_datalink_init()
@@ -301,14 +548,19 @@ int link_stcs(void *link_ptr, u8 address, u8 value)
     if (!VALID_LINK(link))
         return ERROR_PTR;
 
+    _link_op(link, TRACE_LINK_STCS);
+
     DBG_INFO(LINK_DEBUG, "<LINK> STCS to 0x02x", address);
 
     result = phy_send(PHY(link), cmd, sizeof(cmd));
     if (result) {
         DBG_INFO(LINK_DEBUG, "phy_send failed %d", result);
+        _link_cs_invalidate(link, 1 << (address & 0x0F));
         return -2;
     }
 
+    _link_cs_update(link, address, value, true);
+
     return 0;
 }
 
@@ -319,23 +571,26 @@ int link_stcs(void *link_ptr, u8 address, u8 value)
     @val: output buffer
     @return 0 successful, other value if failed
 */
-int _link_ld(void *link_ptr, u16 address, u8 *val)
+int _link_ld(void *link_ptr, u32 address, u8 *val)
 {
     /*
-        Load a single byte direct from a 16 - bit address
+        Load a single byte direct from a 16/24 - bit address
         return 0 if error
     */
     upd_datalink_t *link = (upd_datalink_t *)link_ptr;
-    const u8 cmd[] = { UPDI_PHY_SYNC, UPDI_LDS | UPDI_ADDRESS_16 | UPDI_DATA_8, address & 0xFF, (address >> 8) & 0xFF};
+    u8 cmd[2 + LINK_ADDRESS_MAX];
     u8 resp;
-    int result;
+    int len, result;
 
     if (!VALID_LINK(link) || !val)
         return ERROR_PTR;
 
+    _link_op(link, TRACE_LINK_LDS);
+
     DBG_INFO(LINK_DEBUG, "<LINK> LD from %04X}", address);
-  
-    result = phy_transfer(PHY(link), cmd, sizeof(cmd), &resp, sizeof(resp));
+
+    len = _link_addr_cmd(link, cmd, UPDI_LDS | link->asize | UPDI_DATA_8, address);
+    result = phy_transfer(PHY(link), cmd, len, &resp, sizeof(resp));
     if (result != sizeof(resp)) {
         DBG_INFO(LINK_DEBUG, "phy_transfer failed %d", result);
         return -2;
@@ -352,7 +607,7 @@ int _link_ld(void *link_ptr, u16 address, u8 *val)
     @address: target address
     @return target data if successful, zero if not accessiable(this will confict with target data zero)
 */
-u8 link_ld(void *link_ptr, u16 address)
+u8 link_ld(void *link_ptr, u32 address)
 {
     u8 resp = 0;
 
@@ -368,22 +623,25 @@ u8 link_ld(void *link_ptr, u16 address)
     @val: output buffer
     @return 0 successful, other value if failed
 */
-int _link_ld16(void *link_ptr, u16 address, u16 *val)
+int _link_ld16(void *link_ptr, u32 address, u16 *val)
 {
     /*
-    Load a 2 byte direct from a 16 - bit address
+    Load a 2 byte direct from a 16/24 - bit address
     */
     upd_datalink_t *link = (upd_datalink_t *)link_ptr;
-    const u8 cmd[] = { UPDI_PHY_SYNC , UPDI_LDS | UPDI_ADDRESS_16 | UPDI_DATA_16, address & 0xFF, (address >> 8) & 0xFF};
+    u8 cmd[2 + LINK_ADDRESS_MAX];
     u8 resp[2];
-    int result;
+    int len, result;
 
     if (!VALID_LINK(link))
         return ERROR_PTR;
 
+    _link_op(link, TRACE_LINK_LDS);
+
     DBG_INFO(LINK_DEBUG, "<LINK> LD from %04X}", address);
 
-    result = phy_transfer(PHY(link), cmd, sizeof(cmd), resp, sizeof(resp));
+    len = _link_addr_cmd(link, cmd, UPDI_LDS | link->asize | UPDI_DATA_16, address);
+    result = phy_transfer(PHY(link), cmd, len, resp, sizeof(resp));
     if (result != sizeof(resp)) {
         DBG_INFO(LINK_DEBUG, "phy_transfer failed %d", result);
         return -2;
@@ -400,7 +658,7 @@ int _link_ld16(void *link_ptr, u16 address, u16 *val)
     @val: output buffer
     @return 0 successful, other value if failed
 */
-u16 link_ld16(void *link_ptr, u16 address)
+u16 link_ld16(void *link_ptr, u32 address)
 {
     u16 val = 0;
     int result;
@@ -420,23 +678,26 @@ u16 link_ld16(void *link_ptr, u16 address)
     @value: target value
     @return 0 successful, other value if failed
 */
-int link_st(void *link_ptr, u16 address, u8 value)
+int link_st(void *link_ptr, u32 address, u8 value)
 {
     /*
         Store a single byte value directly to a 16 - bit address
     */
     upd_datalink_t *link = (upd_datalink_t *)link_ptr;
-    const u8 cmd[] = { UPDI_PHY_SYNC, UPDI_STS | UPDI_ADDRESS_16 | UPDI_DATA_8, address & 0xFF, (address >> 8) & 0xFF};
+    u8 cmd[2 + LINK_ADDRESS_MAX];
     const u8 val[] = { value };
     u8 resp = 0xff;
-    int result;
+    int len, result;
 
     if (!VALID_LINK(link))
         return ERROR_PTR;
 
+    _link_op(link, TRACE_LINK_STS);
+
     DBG_INFO(LINK_DEBUG, "<LINK> ST to 0x04X: %02x", address, value);
 
-    result = phy_transfer(PHY(link), cmd, sizeof(cmd), &resp, sizeof(resp));
+    len = _link_addr_cmd(link, cmd, UPDI_STS | link->asize | UPDI_DATA_8, address);
+    result = phy_transfer(PHY(link), cmd, len, &resp, sizeof(resp));
     if (result != sizeof(resp) || resp != UPDI_PHY_ACK) {
         DBG_INFO(LINK_DEBUG, "phy_transfer failed %d ack %02x", result, resp);
         return -2;
@@ -458,23 +719,26 @@ int link_st(void *link_ptr, u16 address, u8 value)
     @value: target value
     @return 0 successful, other value if failed
 */
-int link_st16(void *link_ptr, u16 address, u16 value)
+int link_st16(void *link_ptr, u32 address, u16 value)
 {
     /*
         Store a 16 - bit word value directly to a 16 - bit address
     */
     upd_datalink_t *link = (upd_datalink_t *)link_ptr;
-    const u8 cmd[] = { UPDI_PHY_SYNC, UPDI_STS | UPDI_ADDRESS_16 | UPDI_DATA_16, address & 0xFF, (address >> 8) & 0xFF };
+    u8 cmd[2 + LINK_ADDRESS_MAX];
     const u8 val[] = { value & 0xFF, (value >> 8) & 0xFF };
     u8 resp = 0xff;
-    int result;
+    int len, result;
 
     if (!VALID_LINK(link))
         return ERROR_PTR;
 
+    _link_op(link, TRACE_LINK_STS);
+
     DBG_INFO(LINK_DEBUG, "<LINK> ST16 to 0x04X: %04x", address, value);
 
-    result = phy_transfer(PHY(link), cmd, sizeof(cmd), &resp, sizeof(resp));
+    len = _link_addr_cmd(link, cmd, UPDI_STS | link->asize | UPDI_DATA_16, address);
+    result = phy_transfer(PHY(link), cmd, len, &resp, sizeof(resp));
     if (result != sizeof(resp) || resp != UPDI_PHY_ACK) {
         DBG_INFO(LINK_DEBUG, "phy_transfer failed %d ack %02x", result, resp);
         return -2;
@@ -509,6 +773,8 @@ int link_ld_ptr_inc(void *link_ptr, u8 *data, int len)
     if (!VALID_LINK(link))
         return ERROR_PTR;
 
+    _link_op(link, TRACE_LINK_LD_PTR);
+
     DBG_INFO(LINK_DEBUG, "<LINK> LD8 from ptr++");
  
     result = phy_transfer(PHY(link), cmd, sizeof(cmd), data, len);
@@ -540,6 +806,8 @@ int link_ld_ptr_inc16(void *link_ptr, u8 *data, int len)
     if (!VALID_LINK(link))
         return ERROR_PTR;
 
+    _link_op(link, TRACE_LINK_LD_PTR);
+
     DBG_INFO(LINK_DEBUG, "<LINK> LD16 from ptr++");
 
     result = phy_transfer(PHY(link), cmd, sizeof(cmd), data, len);
@@ -557,22 +825,35 @@ int link_ld_ptr_inc16(void *link_ptr, u8 *data, int len)
     @address: the address to be set
     @return 0 successful, other value if failed
 */
-int link_st_ptr(void *link_ptr, u16 address)
+int link_st_ptr(void *link_ptr, u32 address)
 {
     /*
         Set the pointer location
     */
     upd_datalink_t *link = (upd_datalink_t *)link_ptr;
-    const u8 cmd[] = { UPDI_PHY_SYNC, UPDI_ST | UPDI_PTR_ADDRESS | UPDI_DATA_16, address & 0xFF, (address >> 8) & 0xFF };
+    u8 cmd[2 + LINK_ADDRESS_MAX];
     u8 resp = 0xFF;
-    int result;
+    int len, result;
 
     if (!VALID_LINK(link))
         return ERROR_PTR;
 
+    _link_op(link, TRACE_LINK_ST_PTR);
+
     DBG_INFO(LINK_DEBUG, "<LINK> ST ptr %x", address);
 
-    result = phy_transfer(PHY(link), cmd, sizeof(cmd), &resp, sizeof(resp));
+    len = _link_addr_cmd(link, cmd, UPDI_ST | UPDI_PTR_ADDRESS | LINK_PTR_SIZE(link), address);
+    if (link->rsd) {
+        result = phy_send(PHY(link), cmd, len);
+        if (result) {
+            DBG_INFO(LINK_DEBUG, "phy_send failed %d", result);
+            return -2;
+        }
+
+        return 0;
+    }
+
+    result = phy_transfer(PHY(link), cmd, len, &resp, sizeof(resp));
     if (result != sizeof(resp) || resp != UPDI_PHY_ACK) {
         DBG_INFO(LINK_DEBUG, "phy_transfer failed %d resp = 0x%02x", result, resp);
         return -2;
@@ -581,6 +862,38 @@ int link_st_ptr(void *link_ptr, u16 address)
     return 0;
 }
 
+/*
+    LINK stream ST *ptr++ data with the response signature disabled: the instruction and all the
+        data go out in one send, only the echo is checked
+    @link: LINK object
+    @opcode: ST instruction
+    @data: data input buffer
+    @len: data length
+    @return 0 successful, other value if failed
+*/
+static int _link_st_ptr_inc_rsd(upd_datalink_t *link, u8 opcode, const u8 *data, int len)
+{
+    u8 frame[2 + ((UPDI_MAX_REPEAT_SIZE + 1) << 1)];
+    int result;
+
+    if (len > (int)sizeof(frame) - 2) {
+        DBG_INFO(LINK_DEBUG, "RSD data length out of size %d", len);
+        return -2;
+    }
+
+    frame[0] = UPDI_PHY_SYNC;
+    frame[1] = opcode;
+    memcpy(frame + 2, data, len);
+
+    result = phy_send(PHY(link), frame, len + 2);
+    if (result) {
+        DBG_INFO(LINK_DEBUG, "phy_send RSD stream failed %d", result);
+        return -3;
+    }
+
+    return 0;
+}
+
 /*
     LINK set 8bit data by indirect mode,
         the address is set by link_st_ptr() first. After the operation, the ptr in increase 1
@@ -603,8 +916,13 @@ int link_st_ptr_inc(void *link_ptr, const u8 *data, int len)
     if (!VALID_LINK(link))
         return ERROR_PTR;
 
+    _link_op(link, TRACE_LINK_ST_PTR);
+
     DBG_INFO(LINK_DEBUG, "<LINK> ST8 to *ptr++");
 
+    if (link->rsd)
+        return _link_st_ptr_inc_rsd(link, cmd[1], data, len);
+
     result = phy_transfer(PHY(link), cmd, sizeof(cmd), &resp, sizeof(resp));
     if (result != sizeof(resp) || resp != UPDI_PHY_ACK) {
         DBG_INFO(LINK_DEBUG, "phy_transfer failed %d resp 0x%02x", result, resp);
@@ -644,8 +962,13 @@ int link_st_ptr_inc16(void *link_ptr, const u8 *data, int len)
     if (!VALID_LINK(link))
         return ERROR_PTR;
 
+    _link_op(link, TRACE_LINK_ST_PTR);
+
     DBG_INFO(LINK_DEBUG, "<LINK> ST16 to *ptr++");
 
+    if (link->rsd)
+        return _link_st_ptr_inc_rsd(link, cmd[1], data, len);
+
     result = phy_transfer(PHY(link), cmd, sizeof(cmd), &resp, sizeof(resp));
     if (result != sizeof(resp) || resp != UPDI_PHY_ACK) {
         DBG_INFO(LINK_DEBUG, "phy_transfer failed %d resp 0x%02x", result, resp);
@@ -663,6 +986,101 @@ int link_st_ptr_inc16(void *link_ptr, const u8 *data, int len)
     return 0;
 }
 
+/*
+    LINK read back the pointer register
+    @link_ptr: APP object pointer, acquired from updi_datalink_init()
+    @address: output pointer value
+    @return 0 successful, other value if failed
+*/
+int link_ld_ptr(void *link_ptr, u32 *address)
+{
+    /*
+        Load the 16/24-bit pointer register
+    */
+    upd_datalink_t *link = (upd_datalink_t *)link_ptr;
+    u8 cmd[] = { UPDI_PHY_SYNC, UPDI_LD | UPDI_PTR_ADDRESS };
+    u8 resp[LINK_ADDRESS_MAX] = { 0 };
+    int len, result;
+
+    if (!VALID_LINK(link) || !address)
+        return ERROR_PTR;
+
+    _link_op(link, TRACE_LINK_LD_PTR);
+
+    DBG_INFO(LINK_DEBUG, "<LINK> LD ptr");
+
+    cmd[1] |= LINK_PTR_SIZE(link);
+    len = LINK_ADDRESS_24(link) ? 3 : 2;
+    result = phy_transfer(PHY(link), cmd, sizeof(cmd), resp, len);
+    if (result != len) {
+        DBG_INFO(LINK_DEBUG, "phy_transfer failed %d", result);
+        return -2;
+    }
+
+    *address = resp[0] | (resp[1] << 8) | ((u32)resp[2] << 16);
+
+    return 0;
+}
+
+/*
+    LINK enable or disable the response signature(CTRLA RSD), while disabled the ST instructions
+        are not acknowledged, link_st_ptr()/link_st_ptr_inc()/link_st_ptr_inc16() only check the echo
+    @link_ptr: APP object pointer, acquired from updi_datalink_init()
+    @enable: true to disable the response signature
+    @return 0 successful, other value if failed
+*/
+int link_set_rsd(void *link_ptr, bool enable)
+{
+    upd_datalink_t *link = (upd_datalink_t *)link_ptr;
+    u8 ctrla;
+    int result;
+
+    if (!VALID_LINK(link))
+        return ERROR_PTR;
+
+    DBG_INFO(LINK_DEBUG, "<LINK> RSD %d", enable);
+
+    ctrla = link->ctrla;
+    if (enable)
+        ctrla |= (1 << UPDI_CTRLA_RSD_BIT);
+
+    result = link_stcs(link, UPDI_CS_CTRLA, ctrla);
+    if (result) {
+        DBG_INFO(LINK_DEBUG, "link_stcs UPDI_CS_CTRLA failed %d", result);
+        return -2;
+    }
+
+    link->rsd = enable;
+
+    return 0;
+}
+
+/*
+    LINK select the address size of the LDS/STS and ST/LD ptr instructions, a host side setting,
+        24bit addresses are accepted by the UPDI of the devices with more than 64KB address space only
+    @link_ptr: APP object pointer, acquired from updi_datalink_init()
+    @asize: UPDI_ADDRESS_16 or UPDI_ADDRESS_24
+    @return 0 successful, other value if failed
+*/
+int link_set_address_size(void *link_ptr, u8 asize)
+{
+    upd_datalink_t *link = (upd_datalink_t *)link_ptr;
+
+    if (!VALID_LINK(link))
+        return ERROR_PTR;
+
+    if (asize != UPDI_ADDRESS_16 && asize != UPDI_ADDRESS_24) {
+        DBG_INFO(LINK_DEBUG, "Unsupported address size %02x", asize);
+        return -2;
+    }
+
+    DBG_INFO(LINK_DEBUG, "<LINK> %d bit address", asize == UPDI_ADDRESS_24 ? 24 : 16);
+
+    link->asize = asize;
+
+    return 0;
+}
+
 /*
     LINK repeat ST/LD operation by indirect mode,
         the address is set by link_st_ptr() first. After the operation, the ptr will increase by st/ld command dedicated
@@ -682,6 +1100,8 @@ int link_repeat(void *link_ptr, u8 repeats)
     if (!VALID_LINK(link))
         return ERROR_PTR;
 
+    _link_op(link, TRACE_LINK_REPEAT);
+
     DBG_INFO(LINK_DEBUG, "<LINK> Repeat %d", repeats);
 
     result = phy_send(PHY(link), cmd, sizeof(cmd));
@@ -712,6 +1132,8 @@ int link_repeat16(void *link_ptr, u16 repeats)
     if (!VALID_LINK(link))
         return ERROR_PTR;
 
+    _link_op(link, TRACE_LINK_REPEAT);
+
     DBG_INFO(LINK_DEBUG, "<LINK> Repeat16 %d", repeats);
 
     result = phy_send(PHY(link), cmd, sizeof(cmd));
@@ -739,6 +1161,8 @@ int link_read_sib(void *link_ptr, u8 *data, int len)
     if (!VALID_LINK(link))
         return ERROR_PTR;
 
+    _link_op(link, TRACE_LINK_SIB);
+
     DBG_INFO(LINK_DEBUG, "<LINK> Read SIB len %d", len);
 
     return phy_sib(PHY(link), data, len);
@@ -756,30 +1180,444 @@ int link_key(void *link_ptr, u8 size_k, const char *key)
     /*
         Write a key
     */
+    link_frame_t frm;
+    int result;
+
+    link_frame_init(link_ptr, &frm);
+    link_frame_key(&frm, size_k, key);
+    result = link_frame_send(&frm);
+    if (result) {
+        DBG_INFO(LINK_DEBUG, "link_frame_send failed %d", result);
+        return -2;
+    }
+
+    return 0;
+}
+
+/*
+    LINK append an instruction to the frame, counted and tagged to the wire trace
+    @frm: frame, initialized by link_frame_init()
+    @op: trace tag of the instruction
+    @data: instruction bytes, without SYNC
+    @len: instruction length
+    @return 0 successful, other value if failed
+*/
+static int _link_frame_put(link_frame_t *frm, TRACE_LINK_OP_T op, const u8 *data, int len)
+{
+    upd_datalink_t *link = (upd_datalink_t *)frm->link;
+
+    if (frm->error)
+        return frm->error;
+
+    if (frm->rdata || frm->len + len + 1 > (int)sizeof(frm->buf)) {
+        DBG_INFO(LINK_DEBUG, "Frame full or already closed by a response(%d)", frm->len);
+        frm->error = -2;
+        return frm->error;
+    }
+
+    _link_op(link, op);
+
+    frm->buf[frm->len++] = UPDI_PHY_SYNC;
+    memcpy(frm->buf + frm->len, data, len);
+    frm->len += len;
+
+    return 0;
+}
+
+/*
+    LINK start a frame, several instructions packed in one send, with the echo and the response
+        read back in one receive. The target must not respond before the end of the frame, so
+        only the last instruction may have a response
+    @link_ptr: APP object pointer, acquired from updi_datalink_init()
+    @frm: frame to init
+    @return 0 successful, other value if failed
+*/
+int link_frame_init(void *link_ptr, link_frame_t *frm)
+{
     upd_datalink_t *link = (upd_datalink_t *)link_ptr;
-    const u8 cmd[] = { UPDI_PHY_SYNC, UPDI_KEY | UPDI_KEY_KEY | size_k };
-    u8 len = 8 << size_k;
-    int i;
+
+    if (!frm)
+        return ERROR_PTR;
+
+    frm->link = link_ptr;
+    frm->len = 0;
+    frm->rdata = NULL;
+    frm->rlen = 0;
+    frm->error = VALID_LINK(link) ? 0 : ERROR_PTR;
+
+    return frm->error;
+}
+
+/*
+    LINK frame: store control register, no response
+    @frm: frame, initialized by link_frame_init()
+    @address: reg address
+    @value: reg value
+    @return 0 successful, other value if failed
+*/
+int link_frame_stcs(link_frame_t *frm, u8 address, u8 value)
+{
+    const u8 cmd[] = { UPDI_STCS | (address & 0x0F), value };
     int result;
 
+    result = _link_frame_put(frm, TRACE_LINK_STCS, cmd, sizeof(cmd));
+    if (!result)
+        _link_cs_update((upd_datalink_t *)frm->link, address, value, true);
+
+    return result;
+}
+
+/*
+    LINK frame: set the pointer, the ACK is suppressed by the response signature disabled around it
+    @frm: frame, initialized by link_frame_init()
+    @address: the address to be set
+    @return 0 successful, other value if failed
+*/
+int link_frame_st_ptr(link_frame_t *frm, u32 address)
+{
+    upd_datalink_t *link = (upd_datalink_t *)frm->link;
+    u8 cmd[2 + LINK_ADDRESS_MAX];
+    int len, result;
+
+    if (frm->error)
+        return frm->error;
+
+    // SYNC is added by the frame
+    len = _link_addr_cmd(link, cmd, UPDI_ST | UPDI_PTR_ADDRESS | LINK_PTR_SIZE(link), address) - 1;
+    if (link->rsd)
+        return _link_frame_put(frm, TRACE_LINK_ST_PTR, cmd + 1, len);
+
+    result = link_frame_stcs(frm, UPDI_CS_CTRLA, link->ctrla | (1 << UPDI_CTRLA_RSD_BIT));
+    if (!result)
+        result = _link_frame_put(frm, TRACE_LINK_ST_PTR, cmd + 1, len);
+    if (!result)
+        result = link_frame_stcs(frm, UPDI_CS_CTRLA, link->ctrla);
+
+    return result;
+}
+
+/*
+    LINK frame: repeat the next instruction, the 16bit counter is used only if needed
+    @frm: frame, initialized by link_frame_init()
+    @repeats: repeats count
+    @return 0 successful, other value if failed
+*/
+int link_frame_repeat(link_frame_t *frm, u16 repeats)
+{
+    const u8 cmd8[] = { UPDI_REPEAT | UPDI_REPEAT_BYTE, repeats & 0xFF };
+    const u8 cmd16[] = { UPDI_REPEAT | UPDI_REPEAT_WORD, repeats & 0xFF, (repeats >> 8) & 0xFF };
+
+    if (repeats <= 0xFF)
+        return _link_frame_put(frm, TRACE_LINK_REPEAT, cmd8, sizeof(cmd8));
+    else
+        return _link_frame_put(frm, TRACE_LINK_REPEAT, cmd16, sizeof(cmd16));
+}
+
+/*
+    LINK frame: key, no response
+    @frm: frame, initialized by link_frame_init()
+    @size_k: key size in 8-bit unit mode, (2 ^ size_k) * 8
+    @key: key data
+    @return 0 successful, other value if failed
+*/
+int link_frame_key(link_frame_t *frm, u8 size_k, const char *key)
+{
+    u8 cmd[1 + (8 << 2)];
+    int i, len = 8 << size_k;
+
+    if (size_k > 2 || !key) {
+        frm->error = ERROR_PTR;
+        return frm->error;
+    }
+
+    DBG_INFO(LINK_DEBUG, "<LINK> Key %x", size_k);
+
+    cmd[0] = UPDI_KEY | UPDI_KEY_KEY | size_k;
+    for (i = 0; i < len; i++)
+        cmd[1 + i] = (u8)key[len - i - 1];  //Reserse the string
+
+    // The key changes the key and system status
+    _link_cs_invalidate((upd_datalink_t *)frm->link, (1 << UPDI_ASI_KEY_STATUS) | (1 << UPDI_ASI_SYS_STATUS));
+
+    return _link_frame_put(frm, TRACE_LINK_KEY, cmd, len + 1);
+}
+
+/*
+    LINK frame: load control register, closes the frame
+    @frm: frame, initialized by link_frame_init()
+    @address: reg address
+    @data: output 8bit buffer
+    @return 0 successful, other value if failed
+*/
+int link_frame_ldcs(link_frame_t *frm, u8 address, u8 *data)
+{
+    const u8 cmd[] = { UPDI_LDCS | (address & 0x0F) };
+    int result;
+
+    result = _link_frame_put(frm, TRACE_LINK_LDCS, cmd, sizeof(cmd));
+    if (!result) {
+        frm->rdata = data;
+        frm->rlen = 1;
+    }
+
+    return result;
+}
+
+/*
+    LINK frame: load data from the pointer with post-increment, closes the frame
+    @frm: frame, initialized by link_frame_init()
+    @data: data output buffer
+    @len: data length to be read
+    @word: 16bit access
+    @return 0 successful, other value if failed
+*/
+int link_frame_ld_ptr_inc(link_frame_t *frm, u8 *data, int len, bool word)
+{
+    const u8 cmd[] = { UPDI_LD | UPDI_PTR_INC | (word ? UPDI_DATA_16 : UPDI_DATA_8) };
+    int result;
+
+    result = _link_frame_put(frm, TRACE_LINK_LD_PTR, cmd, sizeof(cmd));
+    if (!result) {
+        frm->rdata = data;
+        frm->rlen = len;
+    }
+
+    return result;
+}
+
+/*
+    LINK send the frame in one transfer, and check the echo and the response
+    @frm: frame, built by link_frame_*()
+    @return 0 successful, other value if failed
+*/
+int link_frame_send(link_frame_t *frm)
+{
+    upd_datalink_t *link;
+    int result;
+
+    if (!frm)
+        return ERROR_PTR;
+
+    if (frm->error) {
+        DBG_INFO(LINK_DEBUG, "Frame build failed %d", frm->error);
+        return -2;
+    }
+
+    link = (upd_datalink_t *)frm->link;
+
+    DBG_INFO(LINK_DEBUG, "<LINK> Frame %d bytes, response %d", frm->len, frm->rlen);
+
+    result = phy_transfer(PHY(link), frm->buf, frm->len, frm->rdata, frm->rlen);
+    if (result != frm->rlen) {
+        DBG_INFO(LINK_DEBUG, "phy_transfer failed %d", result);
+        // Not known which STCS reached the target
+        _link_cs_invalidate(link, 0xFFFF);
+        return -3;
+    }
+
+    return 0;
+}
+
+/*
+    LINK get performance counters
+    @link_ptr: LINK object pointer, acquired from updi_datalink_init()
+    @return counters of the stack, NULL if failed
+*/
+upd_stats_t *link_get_stats(void *link_ptr)
+{
+    upd_datalink_t *link = (upd_datalink_t *)link_ptr;
+
     if (!VALID_LINK(link))
+        return NULL;
+
+    return link->stats;
+}
+
+/*
+    LINK apply timing settings
+    @link_ptr: LINK object pointer, acquired from updi_datalink_init()
+    @tm: timing settings
+    @return 0 successful, other value if failed
+*/
+int link_set_timing(void *link_ptr, const link_timing_t *tm)
+{
+    upd_datalink_t *link = (upd_datalink_t *)link_ptr;
+    u8 ctrla;
+    int result;
+
+    if (!VALID_LINK(link) || !tm)
         return ERROR_PTR;
 
-    DBG_INFO(LINK_DEBUG, "<LINK> Key %x", size_k);
+    DBG_INFO(LINK_DEBUG, "<LINK> Set timing: gtval %d, ibdly %d, phy ibdly %d ms", tm->gtval, tm->ibdly, tm->phy_ibdly);
 
-    result = phy_send(PHY(link), cmd, sizeof(cmd));
+    ctrla = link->ctrla & ~((1 << UPDI_CTRLA_IBDLY_BIT) | UPDI_CTRLA_GTVAL_MASK);
+    ctrla |= (tm->gtval & UPDI_CTRLA_GTVAL_MASK);
+    if (tm->ibdly)
+        ctrla |= (1 << UPDI_CTRLA_IBDLY_BIT);
+
+    result = phy_set_ibdly(PHY(link), tm->phy_ibdly);
     if (result) {
-        DBG_INFO(LINK_DEBUG, "phy_send failed %d", result);
+        DBG_INFO(LINK_DEBUG, "phy_set_ibdly failed %d", result);
+        return -2;
+    }
+
+    if (ctrla != link->ctrla) {
+        result = link_stcs(link, UPDI_CS_CTRLA, ctrla);
+        if (result) {
+            DBG_INFO(LINK_DEBUG, "link_stcs UPDI_CS_CTRLA failed %d", result);
+            return -3;
+        }
+        link->ctrla = ctrla;
+    }
+
+    return 0;
+}
+
+/*
+    LINK get current timing settings
+    @link_ptr: LINK object pointer, acquired from updi_datalink_init()
+    @tm: output timing settings
+    @return 0 successful, other value if failed
+*/
+int link_get_timing(void *link_ptr, link_timing_t *tm)
+{
+    upd_datalink_t *link = (upd_datalink_t *)link_ptr;
+
+    if (!VALID_LINK(link) || !tm)
+        return ERROR_PTR;
+
+    tm->gtval = link->ctrla & UPDI_CTRLA_GTVAL_MASK;
+    tm->ibdly = !!(link->ctrla & (1 << UPDI_CTRLA_IBDLY_BIT));
+    tm->phy_ibdly = phy_get_ibdly(PHY(link));
+
+    return 0;
+}
+
+/*
+    LINK probe the responses with current timing
+    CTRLA is read back against the shadow, STATUSA and a LD of data space must be stable
+    @link: LINK object
+    @probes: probe rounds
+    @return 0 successful, other value if any response is lost or corrupted
+*/
+static int _link_probe(upd_datalink_t *link, int probes)
+{
+    u8 val, statusa = 0, data = 0;
+    int i, result;
+
+    for (i = 0; i < probes; i++) {
+        result = _link_ldcs(link, UPDI_CS_CTRLA, &val);
+        if (result || val != link->ctrla)
+            return -2;
+
+        result = _link_ldcs(link, UPDI_CS_STATUSA, &val);
+        if (result || (i && val != statusa))
+            return -3;
+        statusa = val;
+
+        result = _link_ld(link, 0x0000, &val);
+        if (result || (i && val != data))
+            return -4;
+        data = val;
+    }
+
+    return 0;
+}
+
+/*
+    LINK recover after a failed probe: BREAK, then init again with the last good timing
+    @return 0 successful, other value if failed
+*/
+static int _link_recover(upd_datalink_t *link, const link_timing_t *tm)
+{
+    int result;
+
+    phy_send_double_break(PHY(link));
+
+    link->ctrla = 0;
+    result = link_set_init(link, link->baud);
+    if (result) {
+        DBG_INFO(LINK_DEBUG, "link_set_init failed %d", result);
         return -2;
     }
 
-    for (i = 0; i < len; i++) {
-        result = phy_send_byte(PHY(link), (u8)key[len - i - 1]); //Reserse the string
+    return link_set_timing(link, tm);
+}
+
+/*
+    LINK find the shortest guard time which is still reliable on the port
+    Starting from the default 128 cycles (with the inter-byte delays added if even that fails),
+    the guard time is halved while all the probes pass, the last good setting is applied
+    @link_ptr: LINK object pointer, acquired from updi_datalink_init()
+    @probes: probe rounds of each setting
+    @tm: output timing settings applied
+    @return 0 successful, other value if failed
+*/
+int link_calibrate(void *link_ptr, int probes, link_timing_t *tm)
+{
+    upd_datalink_t *link = (upd_datalink_t *)link_ptr;
+    link_timing_t good, next;
+    int result;
+
+    if (!VALID_LINK(link) || !tm)
+        return ERROR_PTR;
+
+    DBG_INFO(LINK_DEBUG, "<LINK> Calibrate timing with %d probes", probes);
+
+    // Baseline: default guard time, add the delays of the target and then of the host if it's not reliable
+    good.gtval = UPDI_CTRLA_GTVAL_128;
+    good.ibdly = false;
+    good.phy_ibdly = 0;
+    while (1) {
+        result = link_set_timing(link, &good);
+        if (!result)
+            result = _link_probe(link, probes);
+        if (!result)
+            break;
+
+        DBG_INFO(LINK_DEBUG, "Probe failed %d at ibdly %d, phy ibdly %d ms", result, good.ibdly, good.phy_ibdly);
+
+        if (!good.ibdly)
+            good.ibdly = true;
+        else if (!good.phy_ibdly)
+            good.phy_ibdly = 1;
+        else {
+            DBG_INFO(LINK_DEBUG, "No reliable timing found");
+            return -2;
+        }
+
+        result = _link_recover(link, &good);
         if (result) {
-            DBG_INFO(LINK_DEBUG, "phy_send byte %d failed %d", i, result);
+            DBG_INFO(LINK_DEBUG, "_link_recover failed %d", result);
             return -3;
         }
     }
 
+    // Shorten the guard time
+    memcpy(&next, &good, sizeof(next));
+    while (next.gtval < UPDI_CTRLA_GTVAL_2) {
+        next.gtval++;
+
+        result = link_set_timing(link, &next);
+        if (!result)
+            result = _link_probe(link, probes);
+        if (result) {
+            DBG_INFO(LINK_DEBUG, "Probe failed %d at gtval %d", result, next.gtval);
+
+            result = _link_recover(link, &good);
+            if (result) {
+                DBG_INFO(LINK_DEBUG, "_link_recover failed %d", result);
+                return -4;
+            }
+            break;
+        }
+
+        memcpy(&good, &next, sizeof(good));
+    }
+
+    DBG_INFO(LINK_DEBUG, "<LINK> Calibrated: gtval %d(%d cycles), ibdly %d, phy ibdly %d ms", good.gtval, 128 >> good.gtval, good.ibdly, good.phy_ibdly);
+
+    memcpy(tm, &good, sizeof(*tm));
+
     return 0;
 }
@@ -1,27 +1,79 @@
 #ifndef __UD_LINK_H
 #define __UD_LINK_H
 
-void *updi_datalink_init(const char *port, int baud);
+/*
+    LINK timing settings
+    @gtval: guard time of the target responses, UPDI_CTRLA_GTVAL_*
+    @ibdly: inter-byte delay of the target responses(CTRLA IBDLY)
+    @phy_ibdly: host delay after each transfer in ms
+*/
+typedef struct _link_timing {
+    u8 gtval;
+    bool ibdly;
+    int phy_ibdly;
+}link_timing_t;
+
+/*
+    LINK frame, several instructions sent in one transfer, see link_frame_init()
+    @link: LINK object
+    @buf: instructions
+    @len: instructions length
+    @rdata: response buffer of the last instruction
+    @rlen: response length
+    @error: first build error, the frame won't be sent
+*/
+#define LINK_FRAME_SIZE 64
+typedef struct _link_frame {
+    void *link;
+    u8 buf[LINK_FRAME_SIZE];
+    int len;
+    u8 *rdata;
+    int rlen;
+    int error;
+}link_frame_t;
+
+void *updi_datalink_init(const char *port, int baud, bool fast);
 void updi_datalink_deinit(void *link_ptr);
 int link_set_init(void *link_ptr, int baud);
 int link_check(void *link_ptr);
 int _link_ldcs(void *link_ptr, u8 address, u8 *val);
 u8 link_ldcs(void *link_ptr, u8 address);
+int link_ldcs_stable(void *link_ptr, u8 address, u8 *data);
 int link_stcs(void *link_ptr, u8 address, u8 value);
-int _link_ld(void *link_ptr, u16 address, u8 *val);
-u8 link_ld(void *link_ptr, u16 address);
-int _link_ld16(void *link_ptr, u16 address, u16 *val);
-u16 link_ld16(void *link_ptr, u16 address);
-int link_st(void *link_ptr, u16 address, u8 value);
-int link_st16(void *link_ptr, u16 address, u16 value);
+int _link_ld(void *link_ptr, u32 address, u8 *val);
+u8 link_ld(void *link_ptr, u32 address);
+int _link_ld16(void *link_ptr, u32 address, u16 *val);
+u16 link_ld16(void *link_ptr, u32 address);
+int link_st(void *link_ptr, u32 address, u8 value);
+int link_st16(void *link_ptr, u32 address, u16 value);
 int link_ld_ptr_inc(void *link_ptr, u8 *data, int len);
 int link_ld_ptr_inc16(void *link_ptr, u8 *data, int len);
-int link_st_ptr(void *link_ptr, u16 address);
+int link_st_ptr(void *link_ptr, u32 address);
 int link_st_ptr_inc(void *link_ptr, const u8 *data, int len);
 int link_st_ptr_inc16(void *link_ptr, const u8 *data, int len);
+int link_ld_ptr(void *link_ptr, u32 *address);
+int link_set_rsd(void *link_ptr, bool enable);
+int link_set_address_size(void *link_ptr, u8 asize);
 int link_repeat(void *link_ptr, u8 repeats);
 int link_repeat16(void *link_ptr, u16 repeats);
 int link_read_sib(void *link_ptr, u8 *data, int len);
 int link_key(void *link_ptr, u8 size_k, const char *key);
+int link_frame_init(void *link_ptr, link_frame_t *frm);
+int link_frame_stcs(link_frame_t *frm, u8 address, u8 value);
+int link_frame_st_ptr(link_frame_t *frm, u32 address);
+int link_frame_repeat(link_frame_t *frm, u16 repeats);
+int link_frame_key(link_frame_t *frm, u8 size_k, const char *key);
+int link_frame_ldcs(link_frame_t *frm, u8 address, u8 *data);
+int link_frame_ld_ptr_inc(link_frame_t *frm, u8 *data, int len, bool word);
+int link_frame_send(link_frame_t *frm);
+upd_stats_t *link_get_stats(void *link_ptr);
+int link_set_timing(void *link_ptr, const link_timing_t *tm);
+int link_get_timing(void *link_ptr, link_timing_t *tm);
+int link_calibrate(void *link_ptr, int probes, link_timing_t *tm);
+
+/*
+Probe rounds of the link calibration
+*/
+#define LINK_CALIBRATE_PROBES 16
 
 #endif
\ No newline at end of file
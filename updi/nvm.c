@@ -17,9 +17,12 @@ limitations under the License.
 
 #include "os/platform.h"
 #include "device/device.h"
+#include "stats.h"
+#include "link.h"
 #include "application.h"
 #include "nvm.h"
 #include "constants.h"
+#include "trace.h"
 
 /*
     NVM level memory struct
@@ -27,6 +30,7 @@ limitations under the License.
     @progmode: Unlock mode flag
     @app: pointer to app object
     @dev: point chip dev object
+    @stats: performance counters, kept by the phy object
 */
 typedef struct _upd_nvm {
 #define UPD_NVM_MAGIC_WORD 0xD2D2 //'unvm'
@@ -34,6 +38,7 @@ typedef struct _upd_nvm {
     bool progmode;
     void *app;
     device_info_t *dev;
+    upd_stats_t *stats;
 }upd_nvm_t;
 
 /*
@@ -46,28 +51,33 @@ typedef struct _upd_nvm {
 #define VALID_NVM(_nvm) ((_nvm) && ((_nvm)->mgwd == UPD_NVM_MAGIC_WORD))
 #define APP(_nvm) ((_nvm)->app)
 #define NVM_REG(_nvm, _name) ((_nvm)->dev->mmap->reg._name)
+#define NVM_FLAG(_nvm, _flag) (!!((_nvm)->dev->mmap->flags & (_flag)))
 
 /*
     NVM object init
     @port: serial port name of Window or Linux
     @baud: baudrate
     @dev: point chip dev object
+    @fast: attach to a target left enabled by a previous session without BREAK, key and reset if possible
     @return NVM ptr, NULL if failed
 */
-void *updi_nvm_init(const char *port, int baud, void *dev)
+void *updi_nvm_init(const char *port, int baud, void *dev, bool fast)
 {
     upd_nvm_t *nvm = NULL;
     void *app;
 
     DBG_INFO(NVM_DEBUG, "<NVM> init nvm");
 
-    app = updi_application_init(port, baud, dev);
+    trace_nvm_op(TRACE_NVM_ATTACH);
+
+    app = updi_application_init(port, baud, dev, fast);
     if (app) {
         nvm = (upd_nvm_t *)malloc(sizeof(*nvm));
         nvm->mgwd = UPD_NVM_MAGIC_WORD;
         nvm->progmode = false;
         nvm->dev = (device_info_t *)dev;
         nvm->app = (void *)app;
+        nvm->stats = app_get_stats(app);
     }
 
     return nvm;
@@ -103,6 +113,8 @@ int nvm_get_device_info(void *nvm_ptr)
     if (!VALID_NVM(nvm))
         return ERROR_PTR;
 
+    trace_nvm_op(TRACE_NVM_INFO);
+
     DBG_INFO(NVM_DEBUG, "<NVM> Reading device info");
 
     return app_device_info(APP(nvm));
@@ -124,6 +136,8 @@ int nvm_enter_progmode(void *nvm_ptr)
     if (!VALID_NVM(nvm))
         return ERROR_PTR;
 
+    trace_nvm_op(TRACE_NVM_PROGMODE);
+
     DBG_INFO(NVM_DEBUG, "<NVM> Entering NVM programming mode");
     
     result = app_enter_progmode(APP(nvm));
@@ -153,6 +167,8 @@ int nvm_leave_progmode(void *nvm_ptr)
     if (!VALID_NVM(nvm))
         return ERROR_PTR;
 
+    trace_nvm_op(TRACE_NVM_PROGMODE);
+
     if (!nvm->progmode)
         return 0;
 
@@ -185,6 +201,8 @@ int nvm_disable(void *nvm_ptr)
     if (!VALID_NVM(nvm))
         return ERROR_PTR;
 
+    trace_nvm_op(TRACE_NVM_PROGMODE);
+
     DBG_INFO(NVM_DEBUG, "<NVM> Disable UPDI interface");
 
     result = app_disable(APP(nvm));
@@ -212,6 +230,8 @@ int nvm_unlock_device(void *nvm_ptr)
     if (!VALID_NVM(nvm))
         return ERROR_PTR;
 
+    trace_nvm_op(TRACE_NVM_UNLOCK);
+
     DBG_INFO(NVM_DEBUG, "<NVM> Unlock and erase a device");
 
     if (nvm->progmode)
@@ -219,12 +239,18 @@ int nvm_unlock_device(void *nvm_ptr)
 
     // Unlock
     result = app_unlock(APP(nvm));
-    if (!result) {
+    if (result) {
         DBG_INFO(NVM_DEBUG, "app_unlock failed %d", result);
         return -2;
     }
 
-    // Unlock after using the NVM key results in prog mode.
+    // The chip erase key only unlocks, the NVM key is still needed for prog mode
+    result = app_enter_progmode(APP(nvm));
+    if (result) {
+        DBG_INFO(NVM_DEBUG, "app_enter_progmode failed %d", result);
+        return -3;
+    }
+
     nvm->progmode = true;
 
     return 0;
@@ -246,6 +272,8 @@ int nvm_chip_erase(void *nvm_ptr)
     if (!VALID_NVM(nvm))
         return ERROR_PTR;
 
+    trace_nvm_op(TRACE_NVM_ERASE);
+
     DBG_INFO(NVM_DEBUG, "<NVM> Erase device");
 
     if (!nvm->progmode) {
@@ -262,6 +290,81 @@ int nvm_chip_erase(void *nvm_ptr)
     return 0;
 }
 
+/*
+    NVM wait until the NVM controller is done with the last operation, which is otherwise waited for
+        by the next operation needing the controller
+    @nvm_ptr: NVM object pointer, acquired from updi_nvm_init()
+    @return 0 successful, other value failed
+*/
+int nvm_wait_ready(void *nvm_ptr)
+{
+    upd_nvm_t *nvm = (upd_nvm_t *)nvm_ptr;
+    int result;
+
+    if (!VALID_NVM(nvm))
+        return ERROR_PTR;
+
+    result = app_wait_flash_ready(APP(nvm), TIMEOUT_WAIT_FLASH_READY);
+    if (result) {
+        DBG_INFO(NVM_DEBUG, "app_wait_flash_ready failed %d", result);
+        return -2;
+    }
+
+    return 0;
+}
+
+/*
+    NVM erase the flash pages of a range, page by page with the page erase command
+    @nvm_ptr: NVM object pointer, acquired from updi_nvm_init()
+    @address: start address, flash offset or mapped address, any address in the first page
+    @len: range length, each page the range touches is erased
+    @return 0 successful, other value failed
+*/
+int nvm_erase_flash(void *nvm_ptr, u32 address, int len)
+{
+    upd_nvm_t *nvm = (upd_nvm_t *)nvm_ptr;
+    nvm_info_t info;
+    u32 page, end;
+    int result;
+
+    if (!VALID_NVM(nvm))
+        return ERROR_PTR;
+
+    trace_nvm_op(TRACE_NVM_ERASE);
+
+    DBG_INFO(NVM_DEBUG, "<NVM> Erase flash pages");
+
+    if (!nvm->progmode) {
+        DBG_INFO(NVM_DEBUG, "Enter progmode first!");
+        return -2;
+    }
+
+    result = nvm_get_block_info(nvm, NVM_FLASH, &info);
+    if (result) {
+        DBG_INFO(NVM_DEBUG, "nvm_get_block_info failed");
+        return -3;
+    }
+
+    if (address < info.nvm_start)
+        address += info.nvm_start;
+
+    end = address + len;
+    if (len <= 0 || end > info.nvm_start + info.nvm_size) {
+        DBG_INFO(NVM_DEBUG, "flash address overflow, addr %x, len %x.", address, len);
+        return -4;
+    }
+
+    for (page = address - (address - info.nvm_start) % info.nvm_pagesize; page < end; page += info.nvm_pagesize) {
+        result = app_page_erase(APP(nvm), page);
+        if (result) {
+            DBG_INFO(NVM_DEBUG, "app_page_erase at 0x%x failed %d", page, result);
+            return -5;
+        }
+    }
+
+    return 0;
+}
+
 /*
     NVM read common nvm area(flash/eeprom/userrow/fuses)
     @nvm_ptr: NVM object pointer, acquired from updi_nvm_init()
@@ -271,7 +374,7 @@ int nvm_chip_erase(void *nvm_ptr)
     @len: data len
     @return 0 successful, other value failed
 */
-int _nvm_read_common(void *nvm_ptr, const nvm_info_t *info, u16 address, u8 *data, int len)
+int _nvm_read_common(void *nvm_ptr, const nvm_info_t *info, u32 address, u8 *data, int len)
 {
     /*
     Read from nvm area
@@ -281,6 +384,8 @@ int _nvm_read_common(void *nvm_ptr, const nvm_info_t *info, u16 address, u8 *dat
     if (!VALID_NVM(nvm) || !data)
         return ERROR_PTR;
 
+    trace_nvm_op(TRACE_NVM_READ);
+
     DBG_INFO(NVM_DEBUG, "<NVM> Read from nvm area");
 
     if (!nvm->progmode) {
@@ -292,13 +397,47 @@ int _nvm_read_common(void *nvm_ptr, const nvm_info_t *info, u16 address, u8 *dat
         address += info->nvm_start;
 
     if (address + len > info->nvm_start + info->nvm_size) {
-        DBG_INFO(NVM_DEBUG, "nvm area address overflow, addr %hx, len %x.", address, len);
+        DBG_INFO(NVM_DEBUG, "nvm area address overflow, addr %x, len %x.", address, len);
         return -3;
     }
 
     return nvm_read_mem(nvm_ptr, address, data, len);
 }
 
+/*
+    NVM check the flash by the CRCSCAN of the target, against the checksum in the last 2 bytes of the flash
+    @nvm_ptr: NVM object pointer, acquired from updi_nvm_init()
+    @return 0 flash CRC ok, 1 CRC mismatch, other value failed
+*/
+int nvm_crc_check(void *nvm_ptr)
+{
+    upd_nvm_t *nvm = (upd_nvm_t *)nvm_ptr;
+    int result;
+
+    if (!VALID_NVM(nvm))
+        return ERROR_PTR;
+
+    trace_nvm_op(TRACE_NVM_CRC);
+
+    DBG_INFO(NVM_DEBUG, "<NVM> CRC check");
+
+    if (!nvm->progmode) {
+        DBG_INFO(NVM_DEBUG, "Enter progmode first!");
+        return -2;
+    }
+
+    result = app_crc_check(APP(nvm), TIMEOUT_WAIT_CRCSCAN);
+    if (result == -4)
+        return 1;
+
+    if (result) {
+        DBG_INFO(NVM_DEBUG, "app_crc_check failed %d", result);
+        return -3;
+    }
+
+    return 0;
+}
+
 /*
     NVM read flash
     @nvm_ptr: NVM object pointer, acquired from updi_nvm_init()
@@ -307,7 +446,7 @@ int _nvm_read_common(void *nvm_ptr, const nvm_info_t *info, u16 address, u8 *dat
     @len: data len
     @return 0 successful, other value failed
 */
-int nvm_read_flash(void *nvm_ptr, u16 address, u8 *data, int len)
+int nvm_read_flash(void *nvm_ptr, u32 address, u8 *data, int len)
 {
     upd_nvm_t *nvm = (upd_nvm_t *)nvm_ptr;
     nvm_info_t info;
@@ -323,14 +462,15 @@ int nvm_read_flash(void *nvm_ptr, u16 address, u8 *data, int len)
 }
 
 /*
-    NVM write flash
+    NVM write flash page by page
     @nvm_ptr: NVM object pointer, acquired from updi_nvm_init()
     @address: target address
     @data: data buffer
     @len: data len
+    @erase: erase each page before writing, otherwise the pages must be erased
     @return 0 successful, other value failed
 */
-int nvm_write_flash(void *nvm_ptr, u16 address, const u8 *data, int len)
+static int _nvm_write_flash(void *nvm_ptr, u32 address, const u8 *data, int len, bool erase)
 {
     /*
     Writes to flash
@@ -343,6 +483,8 @@ int nvm_write_flash(void *nvm_ptr, u16 address, const u8 *data, int len)
     if (!VALID_NVM(nvm) || !data)
         return ERROR_PTR;
 
+    trace_nvm_op(TRACE_NVM_WRITE_FLASH);
+
     DBG_INFO(NVM_DEBUG, "<NVM> Writes to flash");
 
     if (!nvm->progmode) {
@@ -362,7 +504,7 @@ int nvm_write_flash(void *nvm_ptr, u16 address, const u8 *data, int len)
         address += flash_address;
 
     if (address + len > flash_address + flash_size) {
-        DBG_INFO(NVM_DEBUG, "flash address overflow, addr %hx, len %x.", address, len);
+        DBG_INFO(NVM_DEBUG, "flash address overflow, addr %x, len %x.", address, len);
         return -4;
     }
 
@@ -375,12 +517,17 @@ int nvm_write_flash(void *nvm_ptr, u16 address, const u8 *data, int len)
         if (size > page_size)
             size = page_size;
 
-        result = app_write_nvm(APP(nvm), address + off, data + off, size);
+        if (erase)
+            result = app_erase_write_nvm(APP(nvm), address + off, data + off, size);
+        else
+            result = app_write_nvm(APP(nvm), address + off, data + off, size);
         if (result) {
-            DBG_INFO(NVM_DEBUG, "app_write_nvm failed %d", result);
+            DBG_INFO(NVM_DEBUG, "app_write_nvm(erase %d) failed %d", erase, result);
             break;
         }
 
+        nvm->stats->nvm.bytes_written += size;
+
         off += page_size;
     }
 
@@ -393,6 +540,32 @@ int nvm_write_flash(void *nvm_ptr, u16 address, const u8 *data, int len)
     return 0;
 }
 
+/*
+    NVM write flash, the pages must be erased
+    @nvm_ptr: NVM object pointer, acquired from updi_nvm_init()
+    @address: target address
+    @data: data buffer
+    @len: data len
+    @return 0 successful, other value failed
+*/
+int nvm_write_flash(void *nvm_ptr, u32 address, const u8 *data, int len)
+{
+    return _nvm_write_flash(nvm_ptr, address, data, len, false);
+}
+
+/*
+    NVM erase and write flash, each page is erased before written
+    @nvm_ptr: NVM object pointer, acquired from updi_nvm_init()
+    @address: target address
+    @data: data buffer
+    @len: data len
+    @return 0 successful, other value failed
+*/
+int nvm_erase_write_flash(void *nvm_ptr, u32 address, const u8 *data, int len)
+{
+    return _nvm_write_flash(nvm_ptr, address, data, len, true);
+}
+
 /*
 NVM read eeprom
     @nvm_ptr: NVM object pointer, acquired from updi_nvm_init()
@@ -401,7 +574,7 @@ NVM read eeprom
     @len: data len
     @return 0 successful, other value failed
 */
-int nvm_read_eeprom(void *nvm_ptr, u16 address, u8 *data, int len)
+int nvm_read_eeprom(void *nvm_ptr, u32 address, u8 *data, int len)
 {
     upd_nvm_t *nvm = (upd_nvm_t *)nvm_ptr;
     nvm_info_t info;
@@ -424,7 +597,7 @@ NVM read userrow
     @len: data len
     @return 0 successful, other value failed
 */
-int nvm_read_userrow(void *nvm_ptr, u16 address, u8 *data, int len)
+int nvm_read_userrow(void *nvm_ptr, u32 address, u8 *data, int len)
 {
     upd_nvm_t *nvm = (upd_nvm_t *)nvm_ptr;
     nvm_info_t info;
@@ -448,7 +621,7 @@ NVM write eeprom (compatible with userrow)
     @len: data len
     @return 0 successful, other value failed
 */
-int _nvm_write_eeprom(void *nvm_ptr, const nvm_info_t *info, u16 address, const u8 *data, int len)
+int _nvm_write_eeprom(void *nvm_ptr, const nvm_info_t *info, u32 address, const u8 *data, int len)
 {
     /*
     Writes to eeprom
@@ -460,6 +633,8 @@ int _nvm_write_eeprom(void *nvm_ptr, const nvm_info_t *info, u16 address, const
     if (!VALID_NVM(nvm) || !data)
         return ERROR_PTR;
 
+    trace_nvm_op(TRACE_NVM_WRITE_EEPROM);
+
     DBG_INFO(NVM_DEBUG, "<NVM> Writes to eeprom");
 
     if (!nvm->progmode) {
@@ -471,7 +646,7 @@ int _nvm_write_eeprom(void *nvm_ptr, const nvm_info_t *info, u16 address, const
         address += info->nvm_start;
 
     if (address + len > info->nvm_start + info->nvm_size) {
-        DBG_INFO(NVM_DEBUG, "eeprom address overflow, addr %hx, len %x.", address, len);
+        DBG_INFO(NVM_DEBUG, "eeprom address overflow, addr %x, len %x.", address, len);
         return -3;
     }
 
@@ -490,6 +665,8 @@ int _nvm_write_eeprom(void *nvm_ptr, const nvm_info_t *info, u16 address, const
             break;
         }
 
+        nvm->stats->nvm.bytes_written += size;
+
         off += page_size;
     }
 
@@ -509,7 +686,7 @@ int _nvm_write_eeprom(void *nvm_ptr, const nvm_info_t *info, u16 address, const
     @len: data len
     @return 0 successful, other value failed
 */
-int nvm_write_eeprom(void *nvm_ptr, u16 address, const u8 *data, int len)
+int nvm_write_eeprom(void *nvm_ptr, u32 address, const u8 *data, int len)
 {
     upd_nvm_t *nvm = (upd_nvm_t *)nvm_ptr;
     nvm_info_t info;
@@ -532,7 +709,7 @@ int nvm_write_eeprom(void *nvm_ptr, u16 address, const u8 *data, int len)
     @len: data len
     @return 0 successful, other value failed
 */
-int nvm_write_userrow(void *nvm_ptr, u16 address, const u8 *data, int len)
+int nvm_write_userrow(void *nvm_ptr, u32 address, const u8 *data, int len)
 {
     upd_nvm_t *nvm = (upd_nvm_t *)nvm_ptr;
     nvm_info_t info;
@@ -555,7 +732,7 @@ int nvm_write_userrow(void *nvm_ptr, u16 address, const u8 *data, int len)
     @len: data len
     @return 0 successful, other value failed
 */
-int nvm_read_fuse(void *nvm_ptr, u16 address, u8 *data, int len)
+int nvm_read_fuse(void *nvm_ptr, u32 address, u8 *data, int len)
 {
     upd_nvm_t *nvm = (upd_nvm_t *)nvm_ptr;
     nvm_info_t info;
@@ -578,7 +755,7 @@ int nvm_read_fuse(void *nvm_ptr, u16 address, u8 *data, int len)
     @value: fuse value
     @return 0 successful, other value failed
 */
-int _nvm_write_fuse(void *nvm_ptr, const nvm_info_t *info, u16 address, const u8 value)
+int _nvm_write_fuse(void *nvm_ptr, const nvm_info_t *info, u32 address, const u8 value)
 {
     /*
     Writes to fuse
@@ -591,6 +768,8 @@ int _nvm_write_fuse(void *nvm_ptr, const nvm_info_t *info, u16 address, const u8
     if (!VALID_NVM(nvm))
         return ERROR_PTR;
 
+    trace_nvm_op(TRACE_NVM_WRITE_FUSE);
+
     DBG_INFO(NVM_DEBUG, "<NVM> Writes to fuse");
 
     if (!nvm->progmode) {
@@ -602,10 +781,21 @@ int _nvm_write_fuse(void *nvm_ptr, const nvm_info_t *info, u16 address, const u8
         address += info->nvm_start;
 
     if (address >= info->nvm_start + info->nvm_size) {
-        DBG_INFO(NVM_DEBUG, "fuse address overflow, addr %hx.", address);
+        DBG_INFO(NVM_DEBUG, "fuse address overflow, addr %x.", address);
         return -3;
     }
 
+    // The NVMCTRL v2 writes the fuses as the EEPROM
+    if (NVM_FLAG(nvm, DEV_FLAG_NVMCTRL_V2)) {
+        result = _app_erase_write_nvm(APP(nvm), address, &value, 1, false);
+        if (result) {
+            DBG_INFO(NVM_DEBUG, "_app_erase_write_nvm fuse failed %d", result);
+            return -6;
+        }
+
+        return 0;
+    }
+
     // Check that NVM controller is ready
     result = app_wait_flash_ready(APP(nvm), TIMEOUT_WAIT_FLASH_READY);
     if (result) {
@@ -644,7 +834,7 @@ int _nvm_write_fuse(void *nvm_ptr, const nvm_info_t *info, u16 address, const u8
     @len: data len
     @return 0 successful, other value failed
 */
-int nvm_write_fuse(void *nvm_ptr, u16 address, const u8 *data, int len)
+int nvm_write_fuse(void *nvm_ptr, u32 address, const u8 *data, int len)
 {
     upd_nvm_t *nvm = (upd_nvm_t *)nvm_ptr;
     nvm_info_t info;
@@ -675,41 +865,36 @@ int nvm_write_fuse(void *nvm_ptr, u16 address, const u8 *data, int len)
     @len: data len
     @return 0 successful, other value failed
 */
-int nvm_read_mem(void *nvm_ptr, u16 address, u8 *data, int len)
+int nvm_read_mem(void *nvm_ptr, u32 address, u8 *data, int len)
 {
     /*
         Read Memory
     */
     upd_nvm_t *nvm = (upd_nvm_t *)nvm_ptr;
-    int size, off;
     int result;
 
     if (!VALID_NVM(nvm))
         return ERROR_PTR;
 
+    trace_nvm_op(TRACE_NVM_READ);
+
     DBG_INFO(NVM_DEBUG, "<NVM> Read memory");
 
     if (!nvm->progmode)
         DBG_INFO(NVM_DEBUG, "Memory read at locked mode");
 
-    off = 0;
-    do {
-        size = len - off;
-        if (size > UPDI_MAX_TRANSFER_SIZE)
-            size = UPDI_MAX_TRANSFER_SIZE;
-    
-        DBG_INFO(NVM_DEBUG, "Reading %d bytes at address 0x%x", size, address + off);
+    DBG_INFO(NVM_DEBUG, "Reading %d bytes at address 0x%x", len, address);
 
-        result = app_read_data_bytes(APP(nvm), address + off, data + off, size);
-        if (result) {
-            DBG_INFO(NVM_DEBUG, "app_read_data_bytes failed %d", result);
-            break;
-        }
+    // One pointer setup for the whole block, then back-to-back chunks
+    result = app_read_data_block(APP(nvm), address, data, len);
+    if (result) {
+        DBG_INFO(NVM_DEBUG, "app_read_data_block failed %d", result);
+        return result;
+    }
 
-        off += size;
-    } while (off < len);
+    nvm->stats->nvm.bytes_read += len;
 
-    return result;
+    return 0;
 }
 
 /*
@@ -720,7 +905,7 @@ int nvm_read_mem(void *nvm_ptr, u16 address, u8 *data, int len)
     @len: data len
     @return 0 successful, other value failed
 */
-int nvm_write_mem(void *nvm_ptr, u16 address, const u8 *data, int len)
+int nvm_write_mem(void *nvm_ptr, u32 address, const u8 *data, int len)
 {
     /*
         Write Memory
@@ -732,6 +917,8 @@ int nvm_write_mem(void *nvm_ptr, u16 address, const u8 *data, int len)
     if (!VALID_NVM(nvm))
         return ERROR_PTR;
 
+    trace_nvm_op(TRACE_NVM_WRITE_MEM);
+
     DBG_INFO(NVM_DEBUG, "<NVM> Write Memory");
 
     if (!nvm->progmode)
@@ -751,6 +938,7 @@ int nvm_write_mem(void *nvm_ptr, u16 address, const u8 *data, int len)
             break;
         }
 
+        nvm->stats->nvm.bytes_written += size;
         off += size;
     } while (off < len);
 
@@ -765,7 +953,7 @@ int nvm_write_mem(void *nvm_ptr, u16 address, const u8 *data, int len)
     @len: data len
     @return 0 successful, other value failed
 */
-int nvm_write_auto(void *nvm_ptr, u16 address, const u8 *data, int len)
+int nvm_write_auto(void *nvm_ptr, u32 address, const u8 *data, int len)
 {
     upd_nvm_t *nvm = (upd_nvm_t *)nvm_ptr;
     nvm_info_t info;
@@ -810,6 +998,8 @@ int nvm_reset(void *nvm_ptr, int delay_ms)
     if (!VALID_NVM(nvm))
         return ERROR_PTR;
 
+    trace_nvm_op(TRACE_NVM_RESET);
+
     DBG_INFO(NVM_DEBUG, "<NVM> Reset");
 
     result = app_toggle_reset(APP(nvm), 1);
@@ -853,3 +1043,83 @@ int nvm_get_block_info(void *nvm_ptr, int type, nvm_info_t *info)
 
     return dev_get_nvm_info(nvm->dev, type, info);
 }
+
+/*
+    NVM get the serial number of the chip, nvm_get_device_info() in Unlocked Mode reads it
+    @nvm_ptr: NVM object pointer, acquired from updi_nvm_init()
+    @data: output buffer
+    @len: buffer size
+    @return bytes of the serial number, negative value if failed
+*/
+int nvm_get_serial(void *nvm_ptr, u8 *data, int len)
+{
+    upd_nvm_t *nvm = (upd_nvm_t *)nvm_ptr;
+
+    if (!VALID_NVM(nvm))
+        return ERROR_PTR;
+
+    return app_get_serial(APP(nvm), data, len);
+}
+
+/*
+    NVM get performance counters of the UPDI stack
+    @nvm_ptr: NVM object pointer, acquired from updi_nvm_init()
+    @return counters, NULL if failed
+*/
+upd_stats_t *nvm_get_stats(void *nvm_ptr)
+{
+    upd_nvm_t *nvm = (upd_nvm_t *)nvm_ptr;
+
+    if (!VALID_NVM(nvm))
+        return NULL;
+
+    return nvm->stats;
+}
+
+/*
+    NVM apply link timing settings(guard time and inter-byte delays)
+    @nvm_ptr: NVM object pointer, acquired from updi_nvm_init()
+    @tm: timing settings
+    @return 0 successful, other value failed
+*/
+int nvm_set_timing(void *nvm_ptr, const link_timing_t *tm)
+{
+    upd_nvm_t *nvm = (upd_nvm_t *)nvm_ptr;
+
+    if (!VALID_NVM(nvm))
+        return ERROR_PTR;
+
+    return app_set_timing(APP(nvm), tm);
+}
+
+/*
+    NVM get link timing settings
+    @nvm_ptr: NVM object pointer, acquired from updi_nvm_init()
+    @tm: output timing settings
+    @return 0 successful, other value failed
+*/
+int nvm_get_timing(void *nvm_ptr, link_timing_t *tm)
+{
+    upd_nvm_t *nvm = (upd_nvm_t *)nvm_ptr;
+
+    if (!VALID_NVM(nvm))
+        return ERROR_PTR;
+
+    return app_get_timing(APP(nvm), tm);
+}
+
+/*
+    NVM calibrate link timing, the shortest reliable guard time is applied
+    @nvm_ptr: NVM object pointer, acquired from updi_nvm_init()
+    @tm: output timing settings applied
+    @return 0 successful, other value failed
+*/
+int nvm_calibrate(void *nvm_ptr, link_timing_t *tm)
+{
+    upd_nvm_t *nvm = (upd_nvm_t *)nvm_ptr;
+
+    if (!VALID_NVM(nvm))
+        return ERROR_PTR;
+
+    return app_calibrate(APP(nvm), tm);
+}
@@ -1,7 +1,7 @@
 #ifndef __UD_NVM_H
 #define __UD_NVM_H
 
-void *updi_nvm_init(const char *port, int baud, void *dev);
+void *updi_nvm_init(const char *port, int baud, void *dev, bool fast);
 void updi_nvm_deinit(void *nvm_ptr);
 int nvm_get_device_info(void *nvm_ptr);
 int nvm_enter_progmode(void *nvm_ptr);
@@ -9,22 +9,31 @@ int nvm_leave_progmode(void *nvm_ptr);
 int nvm_disable(void *nvm_ptr);
 int nvm_unlock_device(void *nvm_ptr);
 int nvm_chip_erase(void *nvm_ptr);
-int nvm_read_flash(void *nvm_ptr, u16 address, u8 *data, int len);
-int nvm_write_flash(void *nvm_ptr, u16 address, const u8 *data, int len);
-int nvm_read_eeprom(void *nvm_ptr, u16 address, u8 *data, int len);
-int nvm_write_eeprom(void *nvm_ptr, u16 address, const u8 *data, int len);
-int nvm_read_userrow(void *nvm_ptr, u16 address, u8 *data, int len);
-int nvm_write_userrow(void *nvm_ptr, u16 address, const u8 *data, int len);
-int nvm_read_fuse(void *nvm_ptr, u16 address, u8 *data, int len);
-int nvm_write_fuse(void *nvm_ptr, u16 address, const u8 *data, int len);
-int nvm_read_mem(void *nvm_ptr, u16 address, u8 *data, int len);
-int nvm_write_mem(void *nvm_ptr, u16 address, const u8 *data, int len);
-int nvm_write_auto(void *nvm_ptr, u16 address, const u8 *data, int len);
+int nvm_wait_ready(void *nvm_ptr);
+int nvm_erase_flash(void *nvm_ptr, u32 address, int len);
+int nvm_crc_check(void *nvm_ptr);
+int nvm_read_flash(void *nvm_ptr, u32 address, u8 *data, int len);
+int nvm_write_flash(void *nvm_ptr, u32 address, const u8 *data, int len);
+int nvm_erase_write_flash(void *nvm_ptr, u32 address, const u8 *data, int len);
+int nvm_read_eeprom(void *nvm_ptr, u32 address, u8 *data, int len);
+int nvm_write_eeprom(void *nvm_ptr, u32 address, const u8 *data, int len);
+int nvm_read_userrow(void *nvm_ptr, u32 address, u8 *data, int len);
+int nvm_write_userrow(void *nvm_ptr, u32 address, const u8 *data, int len);
+int nvm_read_fuse(void *nvm_ptr, u32 address, u8 *data, int len);
+int nvm_write_fuse(void *nvm_ptr, u32 address, const u8 *data, int len);
+int nvm_read_mem(void *nvm_ptr, u32 address, u8 *data, int len);
+int nvm_write_mem(void *nvm_ptr, u32 address, const u8 *data, int len);
+int nvm_write_auto(void *nvm_ptr, u32 address, const u8 *data, int len);
 int nvm_reset(void *nvm_ptr, int delay_ms);
 
 int nvm_get_block_info(void *nvm_ptr, /*NVM_TYPE_T*/int type, nvm_info_t *info);
+int nvm_get_serial(void *nvm_ptr, u8 *data, int len);
+upd_stats_t *nvm_get_stats(void *nvm_ptr);
+int nvm_set_timing(void *nvm_ptr, const link_timing_t *tm);
+int nvm_get_timing(void *nvm_ptr, link_timing_t *tm);
+int nvm_calibrate(void *nvm_ptr, link_timing_t *tm);
 
-typedef int(*nvm_op)(void *nvm_ptr, u16 address, const u8 *data, int len);
+typedef int(*nvm_op)(void *nvm_ptr, u32 address, const u8 *data, int len);
 
 /*
 Max waiting time for chip reset
@@ -16,61 +16,161 @@ limitations under the License.
 */
 
 #include "os/platform.h"
+#include "stats.h"
 #include "physical.h"
 #include "constants.h"
+#include "transport.h"
+#include "trace.h"
+
+/*
+    Scratch buffer size of echo and response, max transfer is a 256 words block read with its command
+*/
+#define PHY_XFER_BUFFER_SIZE 1024
 
 /*
     PHY level memory struct
     @mgwd: magicword
-    @ser: pointer to sercom object
+    @tp: transport backend
+    @ser: pointer to the port handle of the transport
     @stat: store sercom parameter
     @ibdly: interval between each transfer action
+    @stats: performance counters of the whole stack
+    @xbuf: scratch buffer for echo and response, no allocation after init
 */
 typedef struct _upd_physical{
 #define UPD_PHYSICAL_MAGIC_WORD 0xE1E1 //'uphy'
     unsigned int mgwd;  //magic word
+    const upd_transport_t *tp;
     void *ser;
     SER_PORT_STATE_T stat;
     int ibdly;  //delay ms for updi bus transfer switch
+    upd_stats_t stats;
+    u8 xbuf[PHY_XFER_BUFFER_SIZE];
 }upd_physical_t;
 
 #define VALID_PHY(_phy) ((_phy) && ((_phy)->mgwd == UPD_PHYSICAL_MAGIC_WORD))
 #define SER(_phy) ((HANDLE)_phy->ser)
+#define TP(_phy) ((_phy)->tp)
+
+/*
+    Transport calls, recorded to the wire trace and counted
+*/
+static int _phy_tp_send(upd_physical_t *phy, const u8 *data, int len)
+{
+    phy->stats.phy.transfers++;
+    phy->stats.phy.tx_bytes += len;
+    trace_record(TRACE_TX, data, len);
+    return TP(phy)->send(SER(phy), data, len);
+}
+
+static int _phy_tp_receive(upd_physical_t *phy, u8 *data, int len)
+{
+    int result;
+
+    result = TP(phy)->receive(SER(phy), data, len);
+    trace_record(TRACE_RX, data, result > 0 ? result : 0);
+
+    if (result > 0)
+        phy->stats.phy.rx_bytes += result;
+    if (result < len)
+        phy->stats.phy.timeouts++;
+
+    return result;
+}
+
+static int _phy_tp_set_state(upd_physical_t *phy, const SER_PORT_STATE_T *st)
+{
+    u32 baud = (u32)st->baudRate;
+
+    trace_record(TRACE_STATE, &baud, sizeof(baud));
+    return TP(phy)->set_state(SER(phy), st);
+}
+
+static int _phy_tp_measure_echo(upd_physical_t *phy, u8 val)
+{
+    int result;
+
+    trace_record(TRACE_TX, &val, 1);
+    result = TP(phy)->measure_echo(SER(phy), val);
+    if (result >= 0)
+        trace_record(TRACE_RX, &val, 1);
+
+    return result;
+}
+
+static int _phy_tp_send_break(upd_physical_t *phy, int count)
+{
+    u8 val = (u8)count;
+    int result;
+
+    result = TP(phy)->send_break(SER(phy), count);
+    if (!result) {
+        phy->stats.phy.breaks += count;
+        trace_record(TRACE_BREAK, &val, sizeof(val));
+    }
+
+    return result;
+}
 
 /*
     PHY object init
-    @port: serial port name of Window or Linux
+    @port: serial port name of Window or Linux, or '<prefix><name>' of other transport backend(see transport.h)
     @baud: baudrate
+    @handshake: send the initial double break, false to attach to an already enabled UPDI
     @return LINK ptr, NULL if failed
 */
-void *updi_physical_init(const char *port, int baud)
+void *updi_physical_init(const char *port, int baud, bool handshake)
 {
     void *ser;
     upd_physical_t *phy = NULL;
+    const upd_transport_t *tp;
+    const char *name;
     SER_PORT_STATE_T stat;
+    u32 rate;
     int result;
 
-    DBG_INFO(PHY_DEBUG, "<PHY> Opening port %s, baudrate %d", port, baud);
+    tp = transport_select(port, &name);
+
+    DBG_INFO(PHY_DEBUG, "<PHY> Opening port %s(%s), baudrate %d", name, tp->name, baud);
 
     stat.baudRate = baud;
     stat.byteSize = 8;
     stat.stopBits = TWOSTOPBITS;
     stat.parity = EVENPARITY;
-    ser = (void *)OpenPort(port, &stat);
+    ser = tp->open(name, &stat);
     if (ser) {
         phy = (upd_physical_t *)malloc(sizeof(*phy));
+        if (!phy) {
+            DBG_INFO(PHY_DEBUG, "<PHY> Init: malloc phy failed");
+            tp->close(ser);
+            return NULL;
+        }
+
         phy->mgwd = UPD_PHYSICAL_MAGIC_WORD;
+        phy->tp = tp;
         phy->ser = ser;
         phy->ibdly = 0;
+        memset(&phy->stats, 0, sizeof(phy->stats));
         stat.baudRate = baud;
         memcpy(&phy->stat, &stat, sizeof(stat));
-        
+        rate = (u32)baud;
+        trace_record(TRACE_STATE, &rate, sizeof(rate));
+
         // Send an initial break as handshake
         // Use double break whatever
-        result = phy_send_double_break(phy);
-        if (result) {
-            DBG_INFO(PHY_DEBUG, "<PHY> Init: send break failed %d", result);
-            return NULL;
+        if (handshake) {
+            // Echo round trip of the adapter, measured only before the double break, which resets the UPDI
+            // from whatever state the byte left it in. Never on a live UPDI attached without handshake
+            if (tp->measure_echo) {
+                result = _phy_tp_measure_echo(phy, 0xFF);
+                DBG_INFO(PHY_DEBUG, "<PHY> Init: echo round trip %d us", result);
+            }
+
+            result = phy_send_double_break(phy);
+            if (result) {
+                DBG_INFO(PHY_DEBUG, "<PHY> Init: send break failed %d", result);
+                return NULL;
+            }
         }
     }
     else {
@@ -95,7 +195,7 @@ void updi_physical_deinit(void *ptr_phy)
     DBG_INFO(PHY_DEBUG, "<PHY> Deinit");
 
     if (phy->ser) {
-        ClosePort(SER(phy));
+        TP(phy)->close(SER(phy));
     }
     free(phy);
 }
@@ -119,14 +219,16 @@ int phy_set_baudrate(void *ptr_phy, int baud)
     memcpy(&stat, &phy->stat, sizeof(stat));
 
     stat.baudRate = baud;
-    result = SetPortState(SER(phy), &stat);
+    result = _phy_tp_set_state(phy, &stat);
     if (result) {
         DBG_INFO(PHY_DEBUG, "<PHY> set Baud %d failed %d", baud, result);
         return -2;
     }
 
     memcpy(&phy->stat, &stat, sizeof(stat));
-    
+
+    DBG_INFO(PHY_DEBUG, "<PHY> Baudrate applied %lu", (TP(phy)->get_baudrate ? TP(phy)->get_baudrate(SER(phy)) : (DWORD)baud));
+
     return 0;
 }
 
@@ -150,7 +252,20 @@ int _phy_send_break(void *ptr_phy, int count)
     if (!VALID_PHY(phy))
         return ERROR_PTR;
 
+    trace_link_op(TRACE_LINK_BREAK);
+
+    if (count == 2)
+        phy->stats.phy.double_breaks++;
+
     DBG_INFO(PHY_DEBUG, "<PHY> D-Break: Sending double break");
+
+    /* Hardware BREAK at the working baudrate */
+    result = _phy_tp_send_break(phy, count);
+    if (result == 0)
+        return 0;
+
+    DBG_INFO(PHY_DEBUG, "<PHY> D-Break: SendBreak not available(%d), fall back to zero frame", result);
+
     /*
         # Re - init at a lower baud
         # At 300 bauds, the break character will pull the line low for 30ms
@@ -160,7 +275,7 @@ int _phy_send_break(void *ptr_phy, int count)
     stat.byteSize = 8;
     stat.stopBits = ONESTOPBIT;
     stat.parity = EVENPARITY;
-    result = SetPortState(SER(phy), &stat);
+    result = _phy_tp_set_state(phy, &stat);
     if (result) {
         DBG_INFO(PHY_DEBUG, "<PHY> D-Break: SetPortState failed %d", result);
         return -2;
@@ -174,10 +289,11 @@ int _phy_send_break(void *ptr_phy, int count)
           DBG_INFO(PHY_DEBUG, "<PHY> D-Break: phy_send failed %d", result);
           break;
       }
+      phy->stats.phy.breaks++;
     }
 
     /*Re - init at the real baud*/
-    result = SetPortState(SER(phy), &phy->stat);
+    result = _phy_tp_set_state(phy, &phy->stat);
     if (result) {
         DBG_INFO(PHY_DEBUG, "<PHY> D-Break: re-SetPortState failed %d", result);
         return -7;
@@ -231,14 +347,14 @@ int phy_send_each(void *ptr_phy, const u8 *data, int len)
     for (int i = 0; i < len; i++) {
         /* Send */
         val = data[i];
-        result = SendData(SER(phy), (const LPVOID)&val, 1);   //Todo: should check whether we could send all data once
+        result = _phy_tp_send(phy, &val, 1);   //Todo: should check whether we could send all data once
         if (result) {
             DBG_INFO(PHY_DEBUG, "<PHY> Send: SendData failed %d", result);
             return -2;
         }
         
         /* Echo */
-        result = ReadData(SER(phy), &val, 1);
+        result = _phy_tp_receive(phy, &val, 1);
         if (result != 1) {
             DBG_INFO(PHY_DEBUG, "<PHY> Send: ReadData failed %d", result);
             return -3;
@@ -246,6 +362,7 @@ int phy_send_each(void *ptr_phy, const u8 *data, int len)
 
         if (data[i] != val) {
             DBG_INFO(PHY_DEBUG, "<PHY> Send: ReadData mismatch %02x(%02x) located = %d", val, data[i], i);
+            phy->stats.phy.echo_mismatches++;
             return -4;
         }
 
@@ -278,14 +395,14 @@ int phy_send(void *ptr_phy, const u8 *data, int len)
 
     DBG(PHY_DEBUG, "<PHY> Send:", data, len, "0x%02x ");
 
-    rbuf = malloc(len);
-    if (!rbuf) {
-        DBG_INFO(PHY_DEBUG, "<PHY> Send: malloc rbuf(%d) failed", len);
+    if (len > sizeof(phy->xbuf)) {
+        DBG_INFO(PHY_DEBUG, "<PHY> Send: len(%d) over buffer size", len);
         return -2;
     }
+    rbuf = phy->xbuf;
 
     /* Send */
-    result = SendData(SER(phy), (const LPVOID)data, len); 
+    result = _phy_tp_send(phy, data, len); 
     if (result) {
         DBG_INFO(PHY_DEBUG, "<PHY> Send: SendData (%d) failed %d", len, result);
         result = -3;
@@ -293,7 +410,7 @@ int phy_send(void *ptr_phy, const u8 *data, int len)
 
     /* Echo */
     if (result == 0) {
-        result = ReadData(SER(phy), rbuf, len);
+        result = _phy_tp_receive(phy, rbuf, len);
         if (result != len) {
             DBG_INFO(PHY_DEBUG, "<PHY> Send: ReadData (%d) failed %d", len, result);
             result = -4;
@@ -304,6 +421,7 @@ int phy_send(void *ptr_phy, const u8 *data, int len)
         for (i = 0; i < len; i++) {
             if (data[i] != rbuf[i]) {
                 DBG_INFO(PHY_DEBUG, "<PHY> Send: ReadData mismatch %02x(%02x) located = %d", rbuf[i], data[i], i);
+                phy->stats.phy.echo_mismatches++;
                 result = -5;
                 break;
             }
@@ -313,8 +431,6 @@ int phy_send(void *ptr_phy, const u8 *data, int len)
     if (phy->ibdly)
         msleep(phy->ibdly);
 
-    free(rbuf);
-
     if (result == len)
         return 0;
     else
@@ -356,7 +472,7 @@ int phy_receive_each(void *ptr_phy, u8 *data, int len)
     /* For each byte */
     while(i < len) {
         /* Read */
-        result = ReadData(SER(phy), &data[i], 1);   //Todo: should check whether we could read all data once
+        result = _phy_tp_receive(phy, &data[i], 1);   //Todo: should check whether we could read all data once
         if (result == 1) {
             i++;
         }else {
@@ -395,7 +511,7 @@ int phy_receive(void *ptr_phy, u8 *data, int len)
         return ERROR_PTR;
 
     /* Read */
-    result = ReadData(SER(phy), data, len);
+    result = _phy_tp_receive(phy, data, len);
     if (result != len) {
         DBG(PHY_DEBUG, "<PHY> Recv: Received(%d/%d) failed: ", data, result, "0x%02x ", result, len);
     }
@@ -425,47 +541,85 @@ u8 phy_receive_byte(void *ptr_phy)
 
 /*
     PHY transfer data
+    The echo and the response are read back in one go, the echo is checked in the buffer,
+    the port is only flushed when a desync is detected
     @ptr_phy: APP object pointer, acquired from updi_physical_init()
     @wdata: data buffer to send
     @wlen: send length
     @rdata: data buffer to receive
     @len: receiving lenght
-    @return 0 successful, other value if failed
+    @return received length if successful, negative value if failed
 */
 int phy_transfer(void *ptr_phy, const u8 *wdata, int wlen, u8 *rdata, int rlen)
 {
     upd_physical_t * phy = (upd_physical_t *)ptr_phy;
-    int result;
-    int retry = 0;  //determine retries in higher level by protocol used
+    ULONGLONG start;
+    int i, result;
+    u8 *rbuf;
+
+    if (!VALID_PHY(phy))
+        return ERROR_PTR;
+
+    start = clock_us();
 
     DBG_INFO(PHY_DEBUG, "<PHY> Transfer: Write %d bytes, Read %d bytes", wlen, rlen);
+    DBG(PHY_DEBUG, "<PHY> Send:", wdata, wlen, (const unsigned char *)"0x%02x ");
 
-    result = FlushPort(SER(phy));
+    if (wlen + rlen > sizeof(phy->xbuf)) {
+        DBG_INFO(PHY_DEBUG, "<PHY> Transfer: len(%d) over buffer size", wlen + rlen);
+        return -2;
+    }
+    rbuf = phy->xbuf;
+
+    /* Send */
+    result = _phy_tp_send(phy, wdata, wlen);
     if (result) {
-        DBG_INFO(PHY_DEBUG, "<PHY> Send: FlushPort failed %d", result);
+        DBG_INFO(PHY_DEBUG, "<PHY> Transfer: SendData (%d) failed %d", wlen, result);
+        result = -3;
+        goto out;
     }
 
-    do {
-        result = phy_send(phy, wdata, wlen);
-        if (result) {
-            DBG_INFO(PHY_DEBUG, "<PHY> Transfer: phy_send failed %d", result);
-            result = -2;
-        }
-        else {
-            result = phy_receive(phy, rdata, rlen);
-            if (result != rlen) {
-                DBG_INFO(PHY_DEBUG, "<PHY> Transfer: phy_receive failed, Got %d bytes", result);
-                result = -3;
-            }
-            else {
-                break;
-            }
+    /* Echo and response */
+    result = _phy_tp_receive(phy, rbuf, wlen + rlen);
+    if (result < wlen) {
+        DBG_INFO(PHY_DEBUG, "<PHY> Transfer: echo (%d) failed %d", wlen, result);
+        result = -4;
+        goto desync;
+    }
+
+    for (i = 0; i < wlen; i++) {
+        if (wdata[i] != rbuf[i]) {
+            DBG_INFO(PHY_DEBUG, "<PHY> Transfer: echo mismatch %02x(%02x) located = %d", rbuf[i], wdata[i], i);
+            phy->stats.phy.echo_mismatches++;
+            result = -5;
+            goto desync;
         }
+    }
 
-        if (result < 0)
-            retry--;
+    result -= wlen;
+    memcpy(rdata, rbuf + wlen, result);
+    if (result != rlen) {
+        DBG(PHY_DEBUG, "<PHY> Recv: Received(%d/%d) failed: ", rdata, result, (const unsigned char *)"0x%02x ", result, rlen);
+        result = -6;
+        goto desync;
+    }
+
+    DBG(PHY_DEBUG, "<PHY> Recv: Received(%d/%d): ", rdata, result, (const unsigned char *)"0x%02x ", result, rlen);
+
+out:
+    if (phy->ibdly)
+        msleep(phy->ibdly);
 
-    } while (retry >= 0);
+    stats_hist_add(&phy->stats.transfer, clock_us() - start);
+
+    return result;
+
+desync:
+    /* Drop the late or unexpected bytes, so the next transfer starts aligned */
+    TP(phy)->flush(SER(phy));
+    phy->stats.phy.flushes++;
+
+    stats_hist_add(&phy->stats.transfer, clock_us() - start);
 
     return result;
 }
@@ -503,4 +657,53 @@ int phy_sib(void *ptr_phy, u8 *data, int len)
     }
 
     return 0;
-}
\ No newline at end of file
+}
+/*
+    PHY get performance counters
+    @ptr_phy: PHY object pointer, acquired from updi_physical_init()
+    @return counters of the stack, NULL if failed
+*/
+upd_stats_t *phy_get_stats(void *ptr_phy)
+{
+    upd_physical_t * phy = (upd_physical_t *)ptr_phy;
+
+    if (!VALID_PHY(phy))
+        return NULL;
+
+    return &phy->stats;
+}
+
+/*
+    PHY set the delay after each transfer
+    @ptr_phy: PHY object pointer, acquired from updi_physical_init()
+    @ms: delay in ms, 0 for no delay
+    @return 0 successful, other value if failed
+*/
+int phy_set_ibdly(void *ptr_phy, int ms)
+{
+    upd_physical_t * phy = (upd_physical_t *)ptr_phy;
+
+    if (!VALID_PHY(phy) || ms < 0)
+        return ERROR_PTR;
+
+    DBG_INFO(PHY_DEBUG, "<PHY> Set transfer delay %d ms", ms);
+
+    phy->ibdly = ms;
+
+    return 0;
+}
+
+/*
+    PHY get the delay after each transfer
+    @ptr_phy: PHY object pointer, acquired from updi_physical_init()
+    @return delay in ms, negative if failed
+*/
+int phy_get_ibdly(void *ptr_phy)
+{
+    upd_physical_t * phy = (upd_physical_t *)ptr_phy;
+
+    if (!VALID_PHY(phy))
+        return ERROR_PTR;
+
+    return phy->ibdly;
+}
@@ -1,7 +1,7 @@
 #ifndef __UD_PHYSICAL_H
 #define __UD_PHYSICAL_H
 
-void *updi_physical_init(const char *port, int baud);
+void *updi_physical_init(const char *port, int baud, bool handshake);
 void updi_physical_deinit(void *ptr_phy);
 int phy_set_baudrate(void *ptr_phy, int baud);
 int phy_send_break(void *ptr_phy);
@@ -12,5 +12,8 @@ int phy_receive(void *ptr_phy, u8 *data, int len);
 u8 phy_receive_byte(void *ptr_phy);
 int phy_transfer(void *ptr_phy, const u8 *wdata, int wlen, u8 *rdata, int rlen);
 int phy_sib(void *ptr_phy, u8 *data, int len);
+upd_stats_t *phy_get_stats(void *ptr_phy);
+int phy_set_ibdly(void *ptr_phy, int ms);
+int phy_get_ibdly(void *ptr_phy);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,308 @@
+/*
+    Trace replay transport backend
+
+    The target side of a trace file is played back: the data sent by the host is checked
+    against the recorded TX data, and the recorded RX data following it is returned to the
+    host. It runs at memory speed, so the host side cost of the UPDI stack could be profiled.
+    The trace is loaded at open, no file access while replaying.
+*/
+
+#include "os/platform.h"
+#include "transport.h"
+#include "trace.h"
+
+#define REPLAY_QUEUE_SIZE 4096
+
+/*
+    Replay object
+    @mgwd: magicword
+    @trace/size/pos: trace content, size and current record position
+    @offset: data consumed in the current TX record
+    @queue/head/tail: RX data waiting to be received by the host
+    @baudrate: current baudrate set by the host
+    @mismatch: count of the TX bytes mismatched with the trace
+*/
+typedef struct _upd_replay {
+#define UPD_REPLAY_MAGIC_WORD 0x9696 //'urpl'
+    unsigned int mgwd;
+    u8 *trace;
+    int size;
+    int pos;
+    int offset;
+    u8 queue[REPLAY_QUEUE_SIZE];
+    int head;
+    int tail;
+    DWORD baudrate;
+    int mismatch;
+}upd_replay_t;
+
+#define VALID_REPLAY(_rp) ((_rp) && ((_rp)->mgwd == UPD_REPLAY_MAGIC_WORD))
+
+/*
+    Get current record
+    @data: output pointer of the record data
+    @return record header, NULL if end of trace
+*/
+static const upd_trace_record_t *replay_peek(upd_replay_t *rp, const u8 **data)
+{
+    const upd_trace_record_t *rec;
+
+    if (rp->pos + (int)sizeof(*rec) > rp->size)
+        return NULL;
+
+    rec = (const upd_trace_record_t *)(rp->trace + rp->pos);
+    if (rp->pos + (int)sizeof(*rec) + rec->len > rp->size)
+        return NULL;
+
+    *data = rp->trace + rp->pos + sizeof(*rec);
+
+    return rec;
+}
+
+/*
+    Move to next record
+*/
+static void replay_next(upd_replay_t *rp)
+{
+    const upd_trace_record_t *rec;
+    const u8 *data;
+
+    rec = replay_peek(rp, &data);
+    if (rec)
+        rp->pos += sizeof(*rec) + rec->len;
+    rp->offset = 0;
+}
+
+/*
+    Queue the RX records at current position
+*/
+static void replay_queue_rx(upd_replay_t *rp)
+{
+    const upd_trace_record_t *rec;
+    const u8 *data;
+    int i;
+
+    while ((rec = replay_peek(rp, &data)) && rec->type == TRACE_RX) {
+        for (i = 0; i < rec->len && rp->tail < REPLAY_QUEUE_SIZE; i++)
+            rp->queue[rp->tail++] = data[i];
+        replay_next(rp);
+    }
+}
+
+static void *replay_open(const char *port, const SER_PORT_STATE_T *st)
+{
+    upd_replay_t *rp;
+    FILE *fp;
+    long size;
+
+    fp = fopen(port, "rb");
+    if (!fp) {
+        DBG_INFO(PHY_DEBUG, "<TP> Open trace %s failed", port);
+        return NULL;
+    }
+
+    rp = (upd_replay_t *)malloc(sizeof(*rp));
+    if (!rp) {
+        fclose(fp);
+        return NULL;
+    }
+    memset(rp, 0, sizeof(*rp));
+
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    rp->trace = malloc(size > 0 ? size : 1);
+    if (!rp->trace || fread(rp->trace, 1, size, fp) != (size_t)size ||
+        size < UPD_TRACE_MAGIC_SIZE || memcmp(rp->trace, UPD_TRACE_MAGIC, UPD_TRACE_MAGIC_SIZE)) {
+        DBG_INFO(PHY_DEBUG, "<TP> Invalid trace file %s", port);
+        fclose(fp);
+        if (rp->trace)
+            free(rp->trace);
+        free(rp);
+        return NULL;
+    }
+    fclose(fp);
+
+    rp->mgwd = UPD_REPLAY_MAGIC_WORD;
+    rp->size = (int)size;
+    rp->pos = UPD_TRACE_MAGIC_SIZE;
+    rp->baudrate = st->baudRate;
+
+    return rp;
+}
+
+static int replay_set_state(void *handle, const SER_PORT_STATE_T *st)
+{
+    upd_replay_t *rp = (upd_replay_t *)handle;
+
+    if (!VALID_REPLAY(rp))
+        return ERROR_PTR;
+
+    rp->baudrate = st->baudRate;
+
+    return 0;
+}
+
+static int replay_flush(void *handle)
+{
+    upd_replay_t *rp = (upd_replay_t *)handle;
+
+    if (!VALID_REPLAY(rp))
+        return ERROR_PTR;
+
+    rp->head = rp->tail = 0;
+
+    return 0;
+}
+
+static int replay_send(void *handle, const u8 *data, int len)
+{
+    upd_replay_t *rp = (upd_replay_t *)handle;
+    const upd_trace_record_t *rec;
+    const u8 *rdata;
+    int i = 0;
+
+    if (!VALID_REPLAY(rp))
+        return ERROR_PTR;
+
+    //Compact the queue
+    if (rp->head == rp->tail)
+        rp->head = rp->tail = 0;
+
+    while (i < len) {
+        rec = replay_peek(rp, &rdata);
+        if (!rec) {
+            DBG_INFO(PHY_DEBUG, "<TP> Replay: end of trace");
+            return -2;
+        }
+
+        if (rec->type == TRACE_TX) {
+            for (; i < len && rp->offset < rec->len; i++, rp->offset++) {
+                if (data[i] != rdata[rp->offset]) {
+                    DBG_INFO(PHY_DEBUG, "<TP> Replay: TX mismatch %02x(%02x) at record %d", data[i], rdata[rp->offset], rp->pos);
+                    rp->mismatch++;
+                }
+            }
+
+            if (rp->offset >= rec->len)
+                replay_next(rp);
+        }
+        else if (rec->type == TRACE_RX) {
+            //Data the host didn't read yet
+            replay_queue_rx(rp);
+        }
+        else {
+            replay_next(rp);
+        }
+    }
+
+    replay_queue_rx(rp);
+
+    return 0;
+}
+
+static int replay_receive(void *handle, u8 *data, int len)
+{
+    upd_replay_t *rp = (upd_replay_t *)handle;
+    int n;
+
+    if (!VALID_REPLAY(rp))
+        return ERROR_PTR;
+
+    n = min(len, rp->tail - rp->head);
+    memcpy(data, rp->queue + rp->head, n);
+    rp->head += n;
+
+    return n;
+}
+
+static int replay_send_break(void *handle, int count)
+{
+    upd_replay_t *rp = (upd_replay_t *)handle;
+    const upd_trace_record_t *rec;
+    const u8 *rdata;
+
+    if (!VALID_REPLAY(rp))
+        return ERROR_PTR;
+
+    while ((rec = replay_peek(rp, &rdata)) && rec->type == TRACE_STATE)
+        replay_next(rp);
+
+    //The trace recorded a zero frame BREAK, let the PHY send it the same way
+    if (!rec || rec->type != TRACE_BREAK)
+        return -2;
+
+    replay_next(rp);
+    rp->head = rp->tail = 0;
+
+    return 0;
+}
+
+static int replay_measure_echo(void *handle, u8 val)
+{
+    upd_replay_t *rp = (upd_replay_t *)handle;
+    const upd_trace_record_t *rec;
+    const u8 *rdata;
+    u32 start;
+
+    if (!VALID_REPLAY(rp))
+        return ERROR_PTR;
+
+    while ((rec = replay_peek(rp, &rdata)) && rec->type == TRACE_STATE)
+        replay_next(rp);
+
+    //The trace recorded no echo probe
+    if (!rec || rec->type != TRACE_TX || rec->len != 1 || rdata[0] != val)
+        return -2;
+
+    start = rec->time_us;
+    replay_next(rp);
+
+    rec = replay_peek(rp, &rdata);
+    if (!rec || rec->type != TRACE_RX)
+        return -3;
+
+    replay_next(rp);
+
+    return (int)(rec->time_us - start);
+}
+
+static DWORD replay_get_baudrate(void *handle)
+{
+    upd_replay_t *rp = (upd_replay_t *)handle;
+
+    if (!VALID_REPLAY(rp))
+        return 0;
+
+    return rp->baudrate;
+}
+
+static void replay_close(void *handle)
+{
+    upd_replay_t *rp = (upd_replay_t *)handle;
+
+    if (!VALID_REPLAY(rp))
+        return;
+
+    if (rp->mismatch)
+        DBG_INFO(PHY_DEBUG, "<TP> Replay: %d bytes mismatched with the trace", rp->mismatch);
+
+    free(rp->trace);
+    rp->mgwd = 0;
+    free(rp);
+}
+
+const upd_transport_t transport_replay = {
+    "replay",
+    "replay:",
+    replay_open,
+    replay_set_state,
+    replay_flush,
+    replay_send,
+    replay_receive,
+    replay_send_break,
+    replay_get_baudrate,
+    replay_measure_echo,
+    replay_close,
+};
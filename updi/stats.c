@@ -0,0 +1,119 @@
+/*
+    Performance counters and latency histograms of the UPDI stack
+*/
+
+#include "os/platform.h"
+#include "stats.h"
+
+static const char *const phase_names[NUM_STATS_PHASES] = {
+    "attach", "unlock", "erase", "program", "verify"
+};
+
+const char *stats_phase_name(int phase)
+{
+    return (phase >= 0 && phase < NUM_STATS_PHASES) ? phase_names[phase] : "unknown";
+}
+
+/*
+    Add a sample to histogram
+    @hist: histogram
+    @us: sample value
+*/
+void stats_hist_add(upd_stats_hist_t *hist, ULONGLONG us)
+{
+    int i = 0;
+
+    while (i < STATS_HIST_BUCKETS - 1 && us >= (1ULL << i))
+        i++;
+
+    hist->count++;
+    hist->total_us += us;
+    if (us > hist->max_us)
+        hist->max_us = (u32)us;
+    hist->bucket[i]++;
+}
+
+/*
+    Print histogram
+    @name: histogram name
+    @hist: histogram
+    @json: print as a JSON object member
+*/
+static void stats_print_hist(const char *name, const upd_stats_hist_t *hist, bool json)
+{
+    int i, n;
+
+    if (json) {
+        printf("  \"%s\": {\"count\": %u, \"total_us\": %llu, \"max_us\": %u, \"log2_us\": [",
+            name, hist->count, hist->total_us, hist->max_us);
+        for (i = 0; i < STATS_HIST_BUCKETS; i++)
+            printf("%s%u", i ? ", " : "", hist->bucket[i]);
+        printf("]},\n");
+        return;
+    }
+
+    printf("%-12s count %u, avg %llu us, max %u us\n", name, hist->count,
+        hist->count ? hist->total_us / hist->count : 0, hist->max_us);
+    for (i = 0; i < STATS_HIST_BUCKETS; i++) {
+        n = hist->bucket[i];
+        if (!n)
+            continue;
+
+        if (i == 0)
+            printf("    %10s < 1 us: %u\n", "", n);
+        else if (i == 1)
+            printf("    %10u us: %u\n", 1U, n);
+        else if (i == STATS_HIST_BUCKETS - 1)
+            printf("    %10u+ us: %u\n", 1U << (i - 1), n);
+        else
+            printf("    %10u~%u us: %u\n", 1U << (i - 1), (1U << i) - 1, n);
+    }
+}
+
+/*
+    Print the counters to stdout
+    @stats: counters
+    @json: print as a JSON object, otherwise as text
+*/
+void stats_print(const upd_stats_t *stats, bool json)
+{
+    int i;
+
+    if (!stats)
+        return;
+
+    if (json) {
+        printf("{\n");
+        printf("  \"phy\": {\"transfers\": %u, \"tx_bytes\": %u, \"rx_bytes\": %u, \"echo_mismatches\": %u, \"timeouts\": %u, \"flushes\": %u, \"breaks\": %u, \"double_breaks\": %u},\n",
+            stats->phy.transfers, stats->phy.tx_bytes, stats->phy.rx_bytes, stats->phy.echo_mismatches,
+            stats->phy.timeouts, stats->phy.flushes, stats->phy.breaks, stats->phy.double_breaks);
+        printf("  \"link\": {\"instructions\": %u, \"retries\": %u, \"cs_hits\": %u},\n",
+            stats->link.instructions, stats->link.retries, stats->link.cs_hits);
+        printf("  \"app\": {\"nvm_commands\": %u, \"busy_polls\": %u, \"page_writes\": %u},\n",
+            stats->app.nvm_commands, stats->app.busy_polls, stats->app.page_writes);
+        printf("  \"nvm\": {\"bytes_read\": %u, \"bytes_written\": %u},\n",
+            stats->nvm.bytes_read, stats->nvm.bytes_written);
+        stats_print_hist("transfer", &stats->transfer, true);
+        stats_print_hist("flash_ready", &stats->flash_ready, true);
+        stats_print_hist("page_write", &stats->page_write, true);
+        printf("  \"phase_us\": {");
+        for (i = 0; i < NUM_STATS_PHASES; i++)
+            printf("%s\"%s\": %llu", i ? ", " : "", stats_phase_name(i), stats->phase_us[i]);
+        printf("}\n}\n");
+        return;
+    }
+
+    printf("PHY:  transfers %u, tx %u bytes, rx %u bytes, echo mismatches %u, timeouts %u, flushes %u, breaks %u, double breaks %u\n",
+        stats->phy.transfers, stats->phy.tx_bytes, stats->phy.rx_bytes, stats->phy.echo_mismatches,
+        stats->phy.timeouts, stats->phy.flushes, stats->phy.breaks, stats->phy.double_breaks);
+    printf("LINK: instructions %u, retries %u, cs hits %u\n", stats->link.instructions, stats->link.retries, stats->link.cs_hits);
+    printf("APP:  nvm commands %u, busy polls %u, page writes %u\n",
+        stats->app.nvm_commands, stats->app.busy_polls, stats->app.page_writes);
+    printf("NVM:  read %u bytes, written %u bytes\n", stats->nvm.bytes_read, stats->nvm.bytes_written);
+    stats_print_hist("transfer", &stats->transfer, false);
+    stats_print_hist("flash_ready", &stats->flash_ready, false);
+    stats_print_hist("page_write", &stats->page_write, false);
+    printf("Phases:");
+    for (i = 0; i < NUM_STATS_PHASES; i++)
+        printf(" %s %llu.%03llu ms%s", stats_phase_name(i), stats->phase_us[i] / 1000, stats->phase_us[i] % 1000, i < NUM_STATS_PHASES - 1 ? "," : "\n");
+}
@@ -0,0 +1,71 @@
+#ifndef __UD_STATS_H
+#define __UD_STATS_H
+
+/*
+    Latency histogram in log2 scale
+    Bucket 0 counts the samples under 1us, bucket i the samples in [2^(i-1), 2^i) us,
+    the last bucket all the samples above
+*/
+#define STATS_HIST_BUCKETS 24
+
+typedef struct _upd_stats_hist {
+    u32 count;
+    ULONGLONG total_us;
+    u32 max_us;
+    u32 bucket[STATS_HIST_BUCKETS];
+}upd_stats_hist_t;
+
+/*
+    Wall-clock phases of a cupdi session
+*/
+typedef enum { STATS_PHASE_ATTACH, STATS_PHASE_UNLOCK, STATS_PHASE_ERASE, STATS_PHASE_PROGRAM, STATS_PHASE_VERIFY, NUM_STATS_PHASES } STATS_PHASE_T;
+
+/*
+    Performance counters of the UPDI stack, one instance kept by the PHY object,
+    acquired with phy_get_stats()/link_get_stats()/app_get_stats()/nvm_get_stats()
+    @phy: transfers(each send/receive/transfer call), bytes on the wire, echo mismatches, short reads,
+          flushes at desync, BREAK conditions sent and double breaks
+    @link: instructions issued, init retries and CS registers served from the shadow
+    @app: NVM commands, busy polls of the NVM controller and pages written
+    @nvm: bytes read and written by the NVM level
+    @transfer: latency of phy_transfer()
+    @flash_ready: latency of app_wait_flash_ready()
+    @page_write: latency of a page write (buffer clear, load and commit)
+    @phase_us: wall-clock time of each STATS_PHASE_T, filled by the caller
+*/
+typedef struct _upd_stats {
+    struct {
+        u32 transfers;
+        u32 tx_bytes;
+        u32 rx_bytes;
+        u32 echo_mismatches;
+        u32 timeouts;
+        u32 flushes;
+        u32 breaks;
+        u32 double_breaks;
+    }phy;
+    struct {
+        u32 instructions;
+        u32 retries;
+        u32 cs_hits;
+    }link;
+    struct {
+        u32 nvm_commands;
+        u32 busy_polls;
+        u32 page_writes;
+    }app;
+    struct {
+        u32 bytes_read;
+        u32 bytes_written;
+    }nvm;
+    upd_stats_hist_t transfer;
+    upd_stats_hist_t flash_ready;
+    upd_stats_hist_t page_write;
+    ULONGLONG phase_us[NUM_STATS_PHASES];
+}upd_stats_t;
+
+const char *stats_phase_name(int phase);
+void stats_hist_add(upd_stats_hist_t *hist, ULONGLONG us);
+void stats_print(const upd_stats_t *stats, bool json);
+
+#endif
@@ -0,0 +1,159 @@
+/*
+    Wire trace recorder
+
+    The records are kept in a buffer and written to the file when the buffer is full and at
+    the end of the recording, so the file I/O doesn't perturb the timing of the transfers.
+*/
+
+#include "os/platform.h"
+#include "trace.h"
+
+#define TRACE_BUFFER_SIZE 0x10000
+
+/*
+    Trace recorder object
+    @fp: trace file
+    @start: time of trace start(us)
+    @tag: current operation tag
+    @len: data length in buffer
+    @buf: record buffer
+*/
+typedef struct _upd_trace {
+    FILE *fp;
+    ULONGLONG start;
+    u8 tag;
+    int len;
+    u8 buf[TRACE_BUFFER_SIZE];
+}upd_trace_t;
+
+static upd_trace_t *g_trace = NULL;
+
+static const char *const nvm_op_names[NUM_TRACE_NVM_OPS] = {
+    "none", "attach", "info", "progmode", "unlock", "erase", "read",
+    "write_flash", "write_eeprom", "write_fuse", "write_mem", "reset", "crc"
+};
+
+static const char *const link_op_names[NUM_TRACE_LINK_OPS] = {
+    "none", "ldcs", "stcs", "lds", "sts", "ld_ptr", "st_ptr",
+    "repeat", "key", "sib", "break"
+};
+
+const char *trace_nvm_op_name(int op)
+{
+    return (op >= 0 && op < NUM_TRACE_NVM_OPS) ? nvm_op_names[op] : "unknown";
+}
+
+const char *trace_link_op_name(int op)
+{
+    return (op >= 0 && op < NUM_TRACE_LINK_OPS) ? link_op_names[op] : "unknown";
+}
+
+/*
+    Write the buffer to file
+*/
+static void trace_flush(upd_trace_t *tr)
+{
+    if (tr->len) {
+        fwrite(tr->buf, 1, tr->len, tr->fp);
+        tr->len = 0;
+    }
+}
+
+/*
+    Start recording
+    @file: trace file name
+    @return 0 successful, other value if failed
+*/
+int trace_start(const char *file)
+{
+    upd_trace_t *tr;
+
+    if (g_trace)
+        return -1;
+
+    tr = (upd_trace_t *)malloc(sizeof(*tr));
+    if (!tr)
+        return -2;
+
+    memset(tr, 0, sizeof(*tr));
+    tr->fp = fopen(file, "wb");
+    if (!tr->fp) {
+        DBG_INFO(UPDI_DEBUG, "Open trace file %s failed", file);
+        free(tr);
+        return -3;
+    }
+
+    memcpy(tr->buf, UPD_TRACE_MAGIC, UPD_TRACE_MAGIC_SIZE);
+    tr->len = UPD_TRACE_MAGIC_SIZE;
+    tr->start = clock_us();
+    g_trace = tr;
+
+    return 0;
+}
+
+/*
+    Stop recording, the buffer is written to file
+*/
+void trace_stop(void)
+{
+    upd_trace_t *tr = g_trace;
+
+    if (!tr)
+        return;
+
+    g_trace = NULL;
+    trace_flush(tr);
+    fclose(tr->fp);
+    free(tr);
+}
+
+/*
+    Record a wire event
+    @type: TRACE_TYPE_T
+    @data: data of the event
+    @len: data length
+*/
+void trace_record(TRACE_TYPE_T type, const void *data, int len)
+{
+    upd_trace_t *tr = g_trace;
+    upd_trace_record_t rec;
+
+    if (!tr || len < 0)
+        return;
+
+    if (len > TRACE_BUFFER_SIZE - (int)sizeof(rec))
+        len = TRACE_BUFFER_SIZE - sizeof(rec);
+
+    if (tr->len + (int)sizeof(rec) + len > TRACE_BUFFER_SIZE)
+        trace_flush(tr);
+
+    rec.time_us = (u32)(clock_us() - tr->start);
+    rec.type = (u8)type;
+    rec.tag = tr->tag;
+    rec.len = (u16)len;
+
+    memcpy(tr->buf + tr->len, &rec, sizeof(rec));
+    tr->len += sizeof(rec);
+    if (len) {
+        memcpy(tr->buf + tr->len, data, len);
+        tr->len += len;
+    }
+}
+
+/*
+    Set current NVM operation, the LINK instruction is cleared
+*/
+void trace_nvm_op(TRACE_NVM_OP_T op)
+{
+    if (g_trace)
+        g_trace->tag = TRACE_TAG(op, TRACE_LINK_NONE);
+}
+
+/*
+    Set current LINK instruction
+*/
+void trace_link_op(TRACE_LINK_OP_T op)
+{
+    if (g_trace)
+        g_trace->tag = TRACE_TAG(TRACE_TAG_NVM(g_trace->tag), op);
+}
@@ -0,0 +1,58 @@
+#ifndef __UD_TRACE_H
+#define __UD_TRACE_H
+
+/*
+    Binary trace file of the wire traffic
+    The file starts with UPD_TRACE_MAGIC, then the records, each record is a
+    upd_trace_record_t header followed by 'len' bytes of data(little endian).
+    TRACE_TX: data sent by the host
+    TRACE_RX: data received by the host(echo and response)
+    TRACE_BREAK: BREAK conditions, data is the count(u8)
+    TRACE_STATE: line settings changed, data is the baudrate(u32)
+*/
+#define UPD_TRACE_MAGIC "UPDITRC1"
+#define UPD_TRACE_MAGIC_SIZE 8
+
+typedef enum { TRACE_TX = 'T', TRACE_RX = 'R', TRACE_BREAK = 'B', TRACE_STATE = 'S' } TRACE_TYPE_T;
+
+/*
+    Trace record header
+    @time_us: time since the trace started
+    @type: TRACE_TYPE_T
+    @tag: operation tag of the layer above, 0 if unknown
+    @len: data length following the header
+*/
+PACK(
+    typedef struct _upd_trace_record {
+    u32 time_us;
+    u8 type;
+    u8 tag;
+    u16 len;
+}) upd_trace_record_t;
+
+/*
+    Operation tag of the record: NVM operation in the high nibble, LINK instruction in the low nibble
+*/
+typedef enum { TRACE_LINK_NONE, TRACE_LINK_LDCS, TRACE_LINK_STCS, TRACE_LINK_LDS, TRACE_LINK_STS, TRACE_LINK_LD_PTR, TRACE_LINK_ST_PTR,
+    TRACE_LINK_REPEAT, TRACE_LINK_KEY, TRACE_LINK_SIB, TRACE_LINK_BREAK, NUM_TRACE_LINK_OPS } TRACE_LINK_OP_T;
+
+typedef enum { TRACE_NVM_NONE, TRACE_NVM_ATTACH, TRACE_NVM_INFO, TRACE_NVM_PROGMODE, TRACE_NVM_UNLOCK, TRACE_NVM_ERASE, TRACE_NVM_READ,
+    TRACE_NVM_WRITE_FLASH, TRACE_NVM_WRITE_EEPROM, TRACE_NVM_WRITE_FUSE, TRACE_NVM_WRITE_MEM, TRACE_NVM_RESET, TRACE_NVM_CRC, NUM_TRACE_NVM_OPS } TRACE_NVM_OP_T;
+
+#define TRACE_TAG(_nvm, _link) ((u8)(((_nvm) << 4) | ((_link) & 0xF)))
+#define TRACE_TAG_NVM(_tag) (((_tag) >> 4) & 0xF)
+#define TRACE_TAG_LINK(_tag) ((_tag) & 0xF)
+
+const char *trace_nvm_op_name(int op);
+const char *trace_link_op_name(int op);
+
+/*
+    Trace recorder, one recording per process, all the calls are no-op if not started
+*/
+int trace_start(const char *file);
+void trace_stop(void);
+void trace_record(TRACE_TYPE_T type, const void *data, int len);
+void trace_nvm_op(TRACE_NVM_OP_T op);
+void trace_link_op(TRACE_LINK_OP_T op);
+
+#endif
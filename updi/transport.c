@@ -0,0 +1,140 @@
+/*
+    Transport backends of the PHY layer
+
+    The PHY layer talks to the wire through a upd_transport_t, the backend is selected by
+    the prefix of the port string, a port without prefix is the termios serial port.
+*/
+
+#include <stdlib.h>
+#include "os/platform.h"
+#include "transport.h"
+
+/*
+    Serial port handle functions adapted to the transport interface, shared by the tty and
+    fd backends
+*/
+static int ser_send(void *handle, const u8 *data, int len)
+{
+    return SendData(handle, (const LPVOID)data, len);
+}
+
+static int ser_receive(void *handle, u8 *data, int len)
+{
+    return ReadData(handle, data, len);
+}
+
+static int ser_measure_echo(void *handle, u8 val)
+{
+    return MeasureEchoLatency(handle, val);
+}
+
+static void *tty_open(const char *port, const SER_PORT_STATE_T *st)
+{
+    return OpenPort(port, st);
+}
+
+static void *fd_open(const char *port, const SER_PORT_STATE_T *st)
+{
+    char *end;
+    long fd;
+
+    fd = strtol(port, &end, 0);
+    if (end == port || *end != '\0' || fd <= 0) {
+        DBG_INFO(PHY_DEBUG, "<TP> Invalid fd '%s'", port);
+        return NULL;
+    }
+
+    return OpenPortFd((int)fd, st);
+}
+
+const upd_transport_t transport_tty = {
+    "tty",
+    NULL,
+    tty_open,
+    SetPortState,
+    FlushPort,
+    ser_send,
+    ser_receive,
+    SendBreak,
+    GetPortBaudRate,
+    ser_measure_echo,
+    ClosePort,
+};
+
+const upd_transport_t transport_fd = {
+    "fd",
+    "fd:",
+    fd_open,
+    SetPortState,
+    FlushPort,
+    ser_send,
+    ser_receive,
+    SendBreak,
+    GetPortBaudRate,
+    NULL,
+    ClosePort,
+};
+
+/*
+    Backends added by transport_register()
+*/
+static const upd_transport_t *registered[TRANSPORT_MAX_REGISTERED];
+
+/*
+    Register a transport backend, selected by its prefix
+    @tp: backend, kept by the caller for the whole session
+    @return 0 successful, other value failed
+*/
+int transport_register(const upd_transport_t *tp)
+{
+    int i;
+
+    if (!tp || !tp->prefix)
+        return ERROR_PTR;
+
+    for (i = 0; i < ARRAY_SIZE(registered); i++) {
+        if (registered[i] == tp)
+            return 0;
+
+        if (!registered[i]) {
+            registered[i] = tp;
+            return 0;
+        }
+    }
+
+    DBG_INFO(PHY_DEBUG, "<TP> No room to register '%s'", tp->name);
+
+    return -2;
+}
+
+/*
+    Select the transport backend by the port string
+    @port: port string, '<prefix><name>' or a tty path
+    @name: output port name with the prefix removed
+    @return transport backend
+*/
+const upd_transport_t *transport_select(const char *port, const char **name)
+{
+    const upd_transport_t *backends[] = { &transport_fd, &transport_replay };
+    size_t len;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(backends); i++) {
+        len = strlen(backends[i]->prefix);
+        if (!strncmp(port, backends[i]->prefix, len)) {
+            *name = port + len;
+            return backends[i];
+        }
+    }
+
+    for (i = 0; i < ARRAY_SIZE(registered) && registered[i]; i++) {
+        len = strlen(registered[i]->prefix);
+        if (!strncmp(port, registered[i]->prefix, len)) {
+            *name = port + len;
+            return registered[i];
+        }
+    }
+
+    *name = port;
+    return &transport_tty;
+}
@@ -0,0 +1,52 @@
+#ifndef __UD_TRANSPORT_H
+#define __UD_TRANSPORT_H
+
+/*
+    Transport backend under the PHY layer
+    @name: backend name
+    @prefix: port string prefix to select the backend, NULL for the default tty
+    @open: open the port(the prefix is removed), return handle or NULL
+    @set_state: apply line settings
+    @flush: drop pending data
+    @send: send data, return 0 if successful
+    @receive: receive data, return bytes received or negative error code
+    @send_break: send BREAK conditions, negative if not supported(PHY falls back to a slow zero frame)
+    @get_baudrate: effective baudrate, optional
+    @measure_echo: echo round trip in us, optional
+    @close: close the port
+*/
+typedef struct _upd_transport {
+    const char *name;
+    const char *prefix;
+    void *(*open)(const char *port, const SER_PORT_STATE_T *st);
+    int (*set_state)(void *handle, const SER_PORT_STATE_T *st);
+    int (*flush)(void *handle);
+    int (*send)(void *handle, const u8 *data, int len);
+    int (*receive)(void *handle, u8 *data, int len);
+    int (*send_break)(void *handle, int count);
+    DWORD (*get_baudrate)(void *handle);
+    int (*measure_echo)(void *handle, u8 val);
+    void (*close)(void *handle);
+}upd_transport_t;
+
+/*
+    Transport backends
+    tty: '/dev/ttyX', the termios serial port
+    fd: 'fd:<n>', a file descriptor of the embedding application
+    replay: 'replay:<file>', replay the target side of a trace file
+    The backends out of the UPDI stack, such as the loopback of the simulator(sim/loopback.h),
+        are added by the application with transport_register()
+*/
+extern const upd_transport_t transport_tty;
+extern const upd_transport_t transport_fd;
+extern const upd_transport_t transport_replay;
+
+/*
+    Max number of the backends added by transport_register()
+*/
+#define TRANSPORT_MAX_REGISTERED 4
+
+int transport_register(const upd_transport_t *tp);
+const upd_transport_t *transport_select(const char *port, const char **name);
+
+#endif